@@ -0,0 +1,292 @@
+/* Native benchmark of the stages of the auditory-periphery model (model_IHC.c and
+ * model_Synapse_v2025a.c), without MATLAB.
+ *
+ * Every stage is timed on its own and end to end:
+ *
+ *   ihc        IHCAN, the middle ear, chirp filters and IHC transduction
+ *   synapse    Synapse with implnt 0, 1 or 2: exponential adaptation, decimation, fGn,
+ *              power-law adaptation and interpolation
+ *   resample   resample_poly decimating the IHC output from 100 kHz to 10 kHz
+ *   ffgn       ffGn, the fractional Gaussian noise of the synapse
+ *   spikes     SpikeGenerator on a synapse output
+ *   an         IHCAN followed by SingleAN (synapse, rates and one spike train)
+ *
+ * over stimulus durations from 0.1 s to 100 s, and at 1 s over CFs, fiber types and nrep.
+ * The stimulus is a 60-dB tone at the CF sampled at 100 kHz.  Each case runs --reps times
+ * (once if the first run takes more than 5 s) and reports the best and the first run; the
+ * first includes filling the caches of filter designs, FFT plans and noise spectra.
+ * samples counts stimulus samples (duration*100e3*nrep) for every stage, so the ns_per_sample
+ * of the stages of one case add up to roughly that of the whole model.
+ *
+ * Build from src/c (drop -mavx2 -mfma if your CPU predates AVX2, as in compile.m):
+ *
+ *   cc -O2 -mavx2 -mfma -ffp-contract=off -DAN_NO_MEXFUNCTION -o bench_an bench_an.c
+ *      model_IHC.c model_Synapse_v2025a.c resample.c ffgn.c fft.c rng.c pla_conv.c
+ *      pla_params.c thread_pool.c complex.c timer.c profile.c -lm -lpthread
+ *
+ * Usage:
+ *
+ *   bench_an [--maxdur s] [--reps n] [--stage name] [--out file]
+ *
+ * --maxdur drops the longer durations (default 100), --reps sets the runs per case
+ * (default 3), --stage runs one stage only and --out writes the results to a file instead
+ * of standard output, as JSON:
+ *
+ *   {"benchmark": "bench_an", "lanes": 4, "reps": 3, "results": [
+ *     {"stage": "synapse", "implnt": 2, "dur": 1, "cf": 1000, "fibertype": 3, "nrep": 1,
+ *      "samples": 100000, "seconds": 0.0123, "first_seconds": 0.0150,
+ *      "samples_per_second": 8.1e6, "ns_per_sample": 123.0}, ...]}
+ *
+ * implnt is null for the stages that do not depend on it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "model_IHC.hpp"
+#include "model_Synapse_v2025a.hpp"
+#include "resample.hpp"
+#include "ffgn.hpp"
+#include "thread_pool.hpp"
+#include "fft.hpp"
+#include "simd.hpp"
+#include "timer.hpp"
+
+#define TDRES      1e-5
+#define LEVEL_DB   60.0
+#define MAX_CASES  256
+
+typedef enum { ST_IHC, ST_SYNAPSE, ST_RESAMPLE, ST_FFGN, ST_SPIKES, ST_AN } STAGE;
+static const char *stage_name[] = {"ihc", "synapse", "resample", "ffgn", "spikes", "an"};
+
+typedef struct {
+    STAGE  stage;
+    int    implnt;     /* -1 if the stage does not depend on it */
+    double dur, cf;
+    int    fibertype, nrep;
+} CASE;
+
+/* Inputs and outputs of one case, allocated outside the timed region */
+typedef struct {
+    int     totalstim, n;                   /* samples of one repetition and of all of them */
+    double  *px, *ihcout, *synout, *work;   /* n samples each */
+    double  *meanrate, *varrate, *psth;     /* totalstim samples each */
+    double  *sptime;
+    SYNOPTS opts;
+} DATA;
+
+static const double spont_of[4] = {0, 0.1, 4.0, 100.0};
+
+static void fail(const char *what, const char *errmsg)
+{
+    fprintf(stderr, "bench_an: %s failed: %s\n", what, errmsg ? errmsg : "out of memory");
+    exit(1);
+}
+
+/* Add a case unless it is already in the list */
+static void add_case(CASE *cases, int *ncase, STAGE stage, int implnt, double dur, double cf,
+                     int fibertype, int nrep)
+{
+    CASE c;
+    int  i;
+
+    c.stage = stage; c.implnt = implnt; c.dur = dur; c.cf = cf;
+    c.fibertype = fibertype; c.nrep = nrep;
+    for (i=0; i<*ncase; i++)
+        if (memcmp(&cases[i], &c, sizeof(CASE)) == 0) return;
+    if (*ncase < MAX_CASES)
+        cases[(*ncase)++] = c;
+}
+
+static int make_cases(CASE *cases, double maxdur)
+{
+    static const double durs[] = {0.1, 1, 10, 100};
+    static const double cfs[]  = {250, 1000, 4000, 16000};
+    int ncase = 0, i, k;
+
+    memset(cases, 0, MAX_CASES*sizeof(CASE));   /* so that memcmp sees no stray padding */
+    /* Every stage over durations, at 1 kHz for a high-spontaneous-rate fiber */
+    for (i=0; i<4 && durs[i]<=maxdur; i++)
+    {
+        add_case(cases, &ncase, ST_IHC, -1, durs[i], 1000, 3, 1);
+        for (k=0; k<3; k++)
+            add_case(cases, &ncase, ST_SYNAPSE, k, durs[i], 1000, 3, 1);
+        add_case(cases, &ncase, ST_RESAMPLE, -1, durs[i], 1000, 3, 1);
+        add_case(cases, &ncase, ST_FFGN, -1, durs[i], 1000, 3, 1);
+        add_case(cases, &ncase, ST_SPIKES, -1, durs[i], 1000, 3, 1);
+        for (k=0; k<3; k++)
+            add_case(cases, &ncase, ST_AN, k, durs[i], 1000, 3, 1);
+    }
+    if (maxdur < 1) return ncase;
+    /* CFs, fiber types and repetitions at 1 s */
+    for (i=0; i<4; i++)
+    {
+        add_case(cases, &ncase, ST_IHC, -1, 1, cfs[i], 3, 1);
+        add_case(cases, &ncase, ST_AN, 2, 1, cfs[i], 3, 1);
+    }
+    for (i=1; i<=3; i++)
+    {
+        add_case(cases, &ncase, ST_SYNAPSE, 2, 1, 1000, i, 1);
+        add_case(cases, &ncase, ST_SPIKES, -1, 1, 1000, i, 1);
+        add_case(cases, &ncase, ST_AN, 2, 1, 1000, i, 1);
+    }
+    add_case(cases, &ncase, ST_IHC, -1, 1, 1000, 3, 10);
+    add_case(cases, &ncase, ST_SYNAPSE, 2, 1, 1000, 3, 10);
+    add_case(cases, &ncase, ST_SPIKES, -1, 1, 1000, 3, 10);
+    add_case(cases, &ncase, ST_AN, 2, 1, 1000, 3, 10);
+    return ncase;
+}
+
+static void prepare(const CASE *c, DATA *d)
+{
+    IHCSTATE state;
+    const char *errmsg;
+    int i;
+
+    d->totalstim = (int) floor(c->dur/TDRES + 0.5);
+    d->n         = d->totalstim*c->nrep;
+    d->px        = (double*)calloc(d->totalstim,sizeof(double));
+    d->ihcout    = (double*)calloc(d->n,sizeof(double));
+    d->synout    = (double*)calloc(d->n,sizeof(double));
+    d->work      = (double*)calloc(d->n,sizeof(double));
+    d->meanrate  = (double*)calloc(3*(size_t)d->totalstim,sizeof(double));
+    d->sptime    = (double*)calloc((size_t) ceil(d->n*TDRES/0.00075)+1,sizeof(double));
+    if (!d->px || !d->ihcout || !d->synout || !d->work || !d->meanrate || !d->sptime)
+        fail("allocation", NULL);
+    d->varrate = d->meanrate + d->totalstim;
+    d->psth    = d->varrate + d->totalstim;
+    for (i=0; i<d->totalstim; i++)
+        d->px[i] = sqrt(2.0)*20e-6*pow(10, LEVEL_DB/20)*sin(6.28318530717959*c->cf*i*TDRES);
+
+    Synapse_default_options(&d->opts);
+    d->opts.seed = 1;
+    d->opts.nthreads = 1;
+
+    /* The inputs of the later stages */
+    if (c->stage != ST_IHC && c->stage != ST_AN && c->stage != ST_FFGN)
+        if (IHCAN(d->px, c->cf, c->nrep, TDRES, d->totalstim, 1.0, 1.0, 1, &state, d->ihcout, NULL))
+            fail("IHCAN", state.errmsg);
+    if (c->stage == ST_SPIKES)
+        if (Synapse(d->ihcout, TDRES, c->cf, d->totalstim, c->nrep, spont_of[c->fibertype], 1, 2,
+                    &d->opts, d->synout, &errmsg) < 0)
+            fail("Synapse", errmsg);
+}
+
+static void release(DATA *d)
+{
+    free(d->px); free(d->ihcout); free(d->synout); free(d->work);
+    free(d->meanrate); free(d->sptime);
+}
+
+/* One timed run of a case */
+static double run(const CASE *c, DATA *d)
+{
+    IHCSTATE state;
+    const char *errmsg;
+    RNG    rng;
+    double t;
+
+    memset(d->meanrate, 0, 3*(size_t)d->totalstim*sizeof(double));
+    rng_init(&rng, 1, RNG_STREAM_SPIKES, 0, 0);
+    t = timer_now();
+    switch (c->stage)
+    {
+    case ST_IHC:
+        if (IHCAN(d->px, c->cf, c->nrep, TDRES, d->totalstim, 1.0, 1.0, 1, &state, d->ihcout, NULL))
+            fail("IHCAN", state.errmsg);
+        break;
+    case ST_SYNAPSE:
+        if (Synapse(d->ihcout, TDRES, c->cf, d->totalstim, c->nrep, spont_of[c->fibertype], 1,
+                    c->implnt, &d->opts, d->synout, &errmsg) < 0)
+            fail("Synapse", errmsg);
+        break;
+    case ST_RESAMPLE:
+        if (resample_poly(d->ihcout, d->n, 1, 10, RESAMPLE_N_MATLAB, d->work))
+            fail("resample_poly", NULL);
+        break;
+    case ST_FFGN:
+        if (ffGn((int) ceil(d->n*TDRES*10e3), 1/10e3, 0.9, spont_of[c->fibertype], 2014,
+                 RESAMPLE_N_MATLAB, &rng, d->work, &errmsg))
+            fail("ffGn", errmsg);
+        break;
+    case ST_SPIKES:
+        SpikeGenerator(d->synout, TDRES, d->totalstim, c->nrep, &rng, d->sptime);
+        break;
+    case ST_AN:
+        if (IHCAN(d->px, c->cf, c->nrep, TDRES, d->totalstim, 1.0, 1.0, 1, &state, d->ihcout, NULL))
+            fail("IHCAN", state.errmsg);
+        if (SingleAN(d->ihcout, c->cf, c->nrep, TDRES, d->totalstim, c->fibertype, 1, c->implnt,
+                     &d->opts, d->meanrate, d->varrate, d->psth, NULL, &errmsg))
+            fail("SingleAN", errmsg);
+        break;
+    }
+    return timer_now() - t;
+}
+
+int main(int argc, char *argv[])
+{
+    CASE   cases[MAX_CASES];
+    DATA   d;
+    FILE   *out = stdout;
+    const char *only = NULL;
+    double maxdur = 100, best, first, t;
+    int    reps = 3, ncase, i, r, nout = 0;
+
+    for (i=1; i<argc; i++)
+    {
+        if (strcmp(argv[i], "--maxdur") == 0 && i+1 < argc)
+            maxdur = atof(argv[++i]);
+        else if (strcmp(argv[i], "--reps") == 0 && i+1 < argc)
+            reps = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--stage") == 0 && i+1 < argc)
+            only = argv[++i];
+        else if (strcmp(argv[i], "--out") == 0 && i+1 < argc)
+        {
+            if ((out = fopen(argv[++i], "w")) == NULL)
+            {
+                fprintf(stderr, "bench_an: cannot write %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else
+        {
+            fprintf(stderr, "usage: bench_an [--maxdur s] [--reps n] [--stage name] [--out file]\n");
+            return 1;
+        }
+    }
+    if (reps < 1) reps = 1;
+
+    ncase = make_cases(cases, maxdur);
+    fprintf(out, "{\"benchmark\": \"bench_an\", \"lanes\": %d, \"reps\": %d, \"results\": [", AN_LANES, reps);
+    for (i=0; i<ncase; i++)
+    {
+        const CASE *c = &cases[i];
+
+        if (only && strcmp(only, stage_name[c->stage]) != 0)
+            continue;
+        prepare(c, &d);
+        best = first = run(c, &d);
+        for (r=1; r<reps && first<5; r++)
+            if ((t = run(c, &d)) < best) best = t;
+        release(&d);
+
+        fprintf(out, "%s\n  {\"stage\": \"%s\", \"implnt\": ", nout++ ? "," : "", stage_name[c->stage]);
+        if (c->implnt < 0) fprintf(out, "null"); else fprintf(out, "%d", c->implnt);
+        fprintf(out, ", \"dur\": %g, \"cf\": %g, \"fibertype\": %d, \"nrep\": %d, \"samples\": %d, "
+                "\"seconds\": %.6g, \"first_seconds\": %.6g, \"samples_per_second\": %.6g, "
+                "\"ns_per_sample\": %.6g}",
+                c->dur, c->cf, c->fibertype, c->nrep, d.n, best, first, d.n/best, 1e9*best/d.n);
+        fflush(out);
+    }
+    fprintf(out, "\n]}\n");
+    if (out != stdout) fclose(out);
+
+    resample_clear_cache();
+    ffGn_clear_cache();
+    fft_clear_cache();
+    pla_params_clear_cache();
+    tpool_shutdown();
+    return 0;
+}
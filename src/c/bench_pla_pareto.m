@@ -0,0 +1,172 @@
+function results = bench_pla_pareto(args)
+% BENCH_PLA_PARETO(...) Measures the speed and the accuracy of the power-law adaptation
+% (PLA) implementations of model_Synapse_v2025a on the same stimuli, so that the cheapest
+% one that meets a given error tolerance can be picked.
+%
+% Every configuration (implnt 0, and implnt 2 with each of args.pla) runs on every
+% stimulus (a CBC roving SAM tone from cbc_roving_samt.m, a SAM tone, a tone burst and a
+% noise burst, each followed by args.dur_post s of silence), CF and fiber type, with frozen
+% fGn so that the runs differ only in their PLA.  Its mean rate is compared with that of exact
+% PLA (implnt 1) on the same IHC output:
+% - rmse: rms error over the whole response (sp/s)
+% - onset: rms error in the first args.onset_window s after the stimulus onset
+% - offset: rms error in the first args.offset_window s after the stimulus offset, where
+%	the slow recovery of the adaptation shows
+% - seconds: best of args.reps wall times of model_Synapse_v2025a, and pla_seconds the time
+%	of its PLA stage alone (from the profile output)
+%
+% results = BENCH_PLA_PARETO(...) returns a table with one row per configuration and
+% stimulus (implnt 1 included, with zero error), and prints for each configuration its total time and its errors averaged
+% (rms) over the stimuli, marking those on the Pareto front: no other configuration is
+% both faster and more accurate.  With no output argument it also plots error against
+% time.  args.tolerance (sp/s of rmse) names the cheapest configuration within it.
+%
+% Arguments:
+% - args.pla: PLA parameter sets for implnt 2, a cell array of names of built-in sets or
+%		parameter files, or of structs (see sim_an_zbc2025.m and pla_params.hpp)
+% - args.cfs: CFs (Hz); every stimulus is centred on each of them
+% - args.fibertypes: spontaneous-rate types, 1 (LSR), 2 (MSR) or 3 (HSR)
+% - args.dur: stimulus duration (s)
+% - args.dur_post: silence simulated after the stimulus (s)
+% - args.level: level of the SAM tone, tone and noise (dB SPL); the CBC stimulus roves
+%		over 20-70 dB SPL
+% - args.onset_window, args.offset_window: lengths of the error windows (s)
+% - args.reps: runs per configuration; the fastest is reported
+% - args.seed: seed of the random stimuli (the model's own noise is frozen)
+% - args.tolerance: largest acceptable rmse (sp/s), or [] for none
+	arguments
+		args.pla cell = {'gc2024', 'heuristic6', 'heuristic10', 'heuristic14', 'heuristic20'}
+		args.cfs (1, :) double = [1e3, 4e3]
+		args.fibertypes (1, :) double = 3
+		args.dur (1,1) double = 2.0
+		args.dur_post (1,1) double = 0.5
+		args.level (1,1) double = 50.0
+		args.onset_window (1,1) double = 0.05
+		args.offset_window (1,1) double = 0.2
+		args.reps (1,1) double = 3
+		args.seed (1,1) double = 1
+		args.tolerance double {mustBeScalarOrEmpty} = []
+	end
+	addpath(fullfile(fileparts(mfilename('fullpath')), '..', 'matlab'));
+	fs = 100e3;
+
+	% Configurations: implnt 0, then implnt 2 with each parameter set
+	configs = struct('name', {'implnt 0'}, 'implnt', {0}, 'pla', {'gc2024'});
+	for k = 1:length(args.pla)
+		if ischar(args.pla{k}) || isstring(args.pla{k})
+			name = sprintf('implnt 2, %s', args.pla{k});
+		else
+			name = sprintf('implnt 2, set %d', k);
+		end
+		configs(end+1) = struct('name', name, 'implnt', 2, 'pla', args.pla(k)); %#ok<AGROW>
+	end
+
+	stimuli = {'cbc_roving_samt', 'sam_tone', 'tone', 'noise'};
+	n_onset = round(args.onset_window*fs);
+	n_offset = min(round(args.offset_window*fs), round(args.dur_post*fs));
+	n_stim = round(args.dur*fs);
+	rows = {};
+	for stimname = stimuli
+		for cf = args.cfs
+			x = make_stimulus(stimname{1}, cf, args, fs);
+			x = [x, zeros(1, round(args.dur_post*fs))]; %#ok<AGROW>
+			% reptime a quarter sample longer than the stimulus, so that rounding cannot make
+			% it shorter
+			ihc = model_IHC(x, cf, 1, 1/fs, (length(x)+0.25)/fs, 1, 1, 1);
+			for fibertype = args.fibertypes
+				[exact, seconds, pla_seconds] = run_synapse(ihc, cf, fibertype, 1, 'gc2024', fs, args.reps);
+				rows(end+1, :) = {'implnt 1 (exact)', stimname{1}, cf, fibertype, seconds, ...
+					pla_seconds, 0, 0, 0}; %#ok<AGROW>
+				for c = configs
+					[rate, seconds, pla_seconds] = run_synapse(ihc, cf, fibertype, c.implnt, ...
+						c.pla, fs, args.reps);
+					err = rate - exact;
+					rows(end+1, :) = {c.name, stimname{1}, cf, fibertype, seconds, pla_seconds, ...
+						rms(err), rms(err(1:n_onset)), rms(err(n_stim+(1:n_offset)))}; %#ok<AGROW>
+				end
+			end
+		end
+	end
+	results = cell2table(rows, 'VariableNames', {'config', 'stimulus', 'cf', 'fibertype', ...
+		'seconds', 'pla_seconds', 'rmse', 'onset', 'offset'});
+
+	% Per configuration: total time and rms of the errors over all stimuli
+	names = unique(results.config, 'stable');
+	summary = zeros(length(names), 5);
+	for k = 1:length(names)
+		r = results(strcmp(results.config, names{k}), :);
+		summary(k, :) = [sum(r.seconds), sum(r.pla_seconds), rms(r.rmse), rms(r.onset), rms(r.offset)];
+	end
+	front = pareto_front(summary(:, 1), summary(:, 3));
+
+	fprintf('%-24s %10s %10s %12s %12s %12s  %s\n', 'configuration', 'time (s)', 'PLA (s)', ...
+		'rmse (sp/s)', 'onset', 'offset', 'Pareto');
+	[~, order] = sort(summary(:, 1));
+	for k = order'
+		fprintf('%-24s %10.3f %10.3f %12.3e %12.3e %12.3e  %s\n', names{k}, summary(k, :), ...
+			repmat('*', 1, front(k)));
+	end
+	if ~isempty(args.tolerance)
+		ok = find(summary(:, 3) <= args.tolerance);
+		if isempty(ok)
+			fprintf('No configuration has an rmse within %g sp/s\n', args.tolerance);
+		else
+			[~, best] = min(summary(ok, 1));
+			fprintf('Cheapest within %g sp/s: %s\n', args.tolerance, names{ok(best)});
+		end
+	end
+
+	if nargout == 0
+		figure;
+		loglog(summary(:, 1), max(summary(:, 3), eps), 'o'); hold on;
+		[~, order] = sort(summary(front, 1));
+		f = find(front);
+		loglog(summary(f(order), 1), max(summary(f(order), 3), eps), '-');
+		text(summary(:, 1), max(summary(:, 3), eps), names, 'VerticalAlignment', 'bottom');
+		grid on;
+		xlabel('Synapse time, all stimuli (s)');
+		ylabel('RMS error of mean rate vs. exact PLA (sp/s)');
+		clear results
+	end
+end
+
+function x = make_stimulus(name, cf, args, fs)
+	rng(args.seed);
+	t = (0:round(args.dur*fs)-1)/fs;
+	switch name
+		case 'cbc_roving_samt'
+			x = cbc_roving_samt(f=cf, dur=args.dur, fs=fs);
+		case 'sam_tone'
+			x = (1 + sin(2*pi*10*t - pi/2)) .* sin(2*pi*cf*t);
+			x = raised_cosine_ramp(x, 0.01, fs);
+			x = 20e-6 * 10^(args.level/20) * x/rms(x);
+		case 'tone'
+			x = quicktone(cf, args.dur, 0.01, args.level, fs);
+		case 'noise'
+			x = raised_cosine_ramp(randn(size(t)), 0.01, fs);
+			x = 20e-6 * 10^(args.level/20) * x/rms(x);
+	end
+end
+
+% Mean rate of one configuration and its best wall time and PLA time over reps runs
+function [rate, seconds, pla_seconds] = run_synapse(ihc, cf, fibertype, implnt, pla, fs, reps)
+	opts = struct('seed', 1, 'pla', pla);
+	seconds = Inf;
+	pla_seconds = Inf;
+	for r = 1:reps
+		tic;
+		[rate, ~, ~, ~, prof] = model_Synapse_v2025a(ihc, cf, 1, 1/fs, fibertype, 0, implnt, opts);
+		seconds = min(seconds, toc);
+		pla_seconds = min(pla_seconds, prof.pla.seconds);
+	end
+	rate = rate';
+end
+
+% front(k) is true if no other point is at least as fast and as accurate and better in one
+function front = pareto_front(time, err)
+	front = true(size(time));
+	for k = 1:length(time)
+		dominated = time <= time(k) & err <= err(k) & (time < time(k) | err < err(k));
+		front(k) = ~any(dominated);
+	end
+end
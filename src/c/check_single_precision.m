@@ -0,0 +1,28 @@
+% Compare the single-precision IHC filters of model_AN_population (opts.precision =
+% 'single') against the double path: mean rate of each CF for tones at several levels,
+% with frozen fGn and a fixed seed so that the two runs differ only in the arithmetic.
+% The error is rmse.m of the rate waveforms, in spikes/s and in % of the rms rate.
+addpath(fullfile(fileparts(mfilename('fullpath')), '..', 'matlab'));
+cfs = 125 * 2 .^ (0:0.5:7)';
+freqs = [250, 1e3, 4e3];
+levels = [20, 50, 80];
+args = {'noisetype', 0, 'seed', 1, 'implnt', 2};
+
+fprintf('%8s %8s %6s %12s %10s\n', 'f (Hz)', 'CF (Hz)', 'dB', 'rmse (sp/s)', 'rmse (%)');
+worst = 0;
+t_double = 0; t_single = 0;
+for freq = freqs
+	for level = levels
+		x = [quicktone(freq, 0.1, 0.01, level), zeros(1, 5e3)]';
+		tic; rd = sim_an_population_zbc2025(x, cfs, args{:}); t_double = t_double + toc;
+		tic; rs = sim_an_population_zbc2025(x, cfs, args{:}, precision='single'); t_single = t_single + toc;
+		for k = 1:length(cfs)
+			err = rmse(rd(k, :), rs(k, :));
+			rel = 100 * err / rms(rd(k, :));
+			worst = max(worst, rel);
+			fprintf('%8.0f %8.0f %6.0f %12.2e %10.2e\n', freq, cfs(k), level, err, rel);
+		end
+	end
+end
+fprintf('Largest difference %.2e%% of the rms rate; %.2f s double, %.2f s single\n', ...
+	worst, t_double, t_single);
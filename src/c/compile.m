@@ -1,5 +1,15 @@
 % Compile source code into MEX functions.  Requires C compiler.
 % Run "mex -setup" first.
-mex model_IHC.c complex.c
-mex model_Synapse_2023.c complex.c 
-mex model_Synapse_v2025a.c complex.c 
\ No newline at end of file
+% Vector kernels run AN_LANES values per instruction (see simd.hpp); AVX2 gives 4 lanes,
+% the default SSE2 gives 2.  Drop simdflags if your CPU predates AVX2.  -ffp-contract=off
+% keeps FMA to the kernels that ask for it, so scalar code rounds as before.
+if isunix, threadlib = {'-lpthread'}; else, threadlib = {}; end
+if ispc, simdflags = {'COMPFLAGS=$COMPFLAGS /arch:AVX2'}; else, simdflags = {'CFLAGS=$CFLAGS -mavx2 -mfma -ffp-contract=off'}; end
+mex model_IHC.c complex.c profile.c timer.c mex_profile.c ihc_cache.c threadlib{:}
+mex model_Synapse_2023.c complex.c
+mex model_Synapse_v2025a.c resample.c ffgn.c fft.c rng.c pla_conv.c pla_params.c mex_options.c mex_profile.c profile.c timer.c thread_pool.c complex.c threadlib{:} simdflags{:}
+% The population, bundle, rate-level and streaming models link the IHC and synapse code without their own MEX gateways
+mex -DAN_NO_MEXFUNCTION model_AN_population.c ihc_filterbank.c ihc_filterbank_single.c model_IHC.c model_Synapse_v2025a.c resample.c ffgn.c fft.c rng.c pla_conv.c pla_params.c mex_options.c neurogram.c profile.c timer.c thread_pool.c complex.c threadlib{:} simdflags{:}
+mex -DAN_NO_MEXFUNCTION model_AN_bundle.c model_Synapse_v2025a.c resample.c ffgn.c fft.c rng.c pla_conv.c pla_params.c mex_options.c profile.c timer.c thread_pool.c complex.c threadlib{:} simdflags{:}
+mex -DAN_NO_MEXFUNCTION model_AN_ratelevel.c model_IHC.c model_Synapse_v2025a.c resample.c ffgn.c fft.c rng.c pla_conv.c pla_params.c mex_options.c profile.c timer.c thread_pool.c complex.c threadlib{:} simdflags{:}
+mex -DAN_NO_MEXFUNCTION model_AN_stream.c model_IHC.c model_Synapse_v2025a.c resample.c ffgn.c fft.c rng.c pla_conv.c pla_params.c mex_options.c profile.c timer.c thread_pool.c complex.c threadlib{:} simdflags{:}
@@ -0,0 +1,204 @@
+/*
+ffgn.c implements the fractional Gaussian noise generator declared in ffgn.hpp, following
+ffGn_rochester.m (Copyright 2003-2005 by B. Scott Jackson, with revisions by M. S. A.
+Zilany, D. Schwarz and D. Guest) step by step
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "fft.hpp"
+#include "resample.hpp"
+#include "ffgn.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+static SRWLOCK cache_lock = SRWLOCK_INIT;
+#define CACHE_LOCK()   AcquireSRWLockExclusive(&cache_lock)
+#define CACHE_UNLOCK() ReleaseSRWLockExclusive(&cache_lock)
+#else
+#include <pthread.h>
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#define CACHE_LOCK()   pthread_mutex_lock(&cache_lock)
+#define CACHE_UNLOCK() pthread_mutex_unlock(&cache_lock)
+#endif
+
+/* sqrt of the spectrum of the circulant embedding for N samples at Hurst index H */
+typedef struct {
+    int N, Nfft;
+    double H;
+    double *Zmag;
+} ZMAG;
+
+static ZMAG cache[FFGN_CACHE_SIZE];
+static int ncache = 0;
+
+static const char *make_zmag(ZMAG *z, int N, double H)
+{
+    const FFTPLAN *plan;
+    double *im;
+    int Nfft = 1, NfftHalf, j, k;
+
+    while (Nfft < 2*(N-1)) Nfft *= 2;   /* 2.^nextpow2(2*(N-1)) */
+    NfftHalf = Nfft/2;
+    z->N = N; z->H = H; z->Nfft = Nfft;
+    z->Zmag = (double*)malloc(Nfft*sizeof(double));
+    im = (double*)calloc(Nfft,sizeof(double));
+    plan = fft_plan(Nfft);
+    if (!z->Zmag || !im || !plan)
+    {
+        free(z->Zmag); free(im); z->Zmag = NULL;
+        return "ffGn: out of memory.\n";
+    }
+
+    /* k = [0:NfftHalf, (NfftHalf-1):-1:1] */
+    for (j=0; j<Nfft; j++)
+    {
+        k = (j <= NfftHalf) ? j : Nfft-j;
+        z->Zmag[j] = 0.5*(pow(k+1,2*H) - 2*pow(k,2*H) + pow(abs(k-1),2*H));
+    }
+    fft_run(plan, z->Zmag, im, 0);
+    free(im);
+    for (j=0; j<Nfft; j++)
+    {
+        if (z->Zmag[j] < 0)
+        {
+            free(z->Zmag); z->Zmag = NULL;
+            return "The FFT of the circulant covariance had negative values.\n";
+        }
+        z->Zmag[j] = sqrt(z->Zmag[j]);
+    }
+    return NULL;
+}
+
+/* Cached Zmag for (N,H); one that does not fit in the cache is returned in *tmp */
+static const ZMAG *get_zmag(int N, double H, ZMAG *tmp, const char **errmsg)
+{
+    const ZMAG *z = NULL;
+    int i;
+
+    *errmsg = NULL;
+    CACHE_LOCK();
+    for (i=0; i<ncache; i++)
+        if (cache[i].N == N && cache[i].H == H)
+        {
+            z = &cache[i];
+            break;
+        }
+    if (z == NULL)
+    {
+        if (ncache < FFGN_CACHE_SIZE)
+        {
+            if ((*errmsg = make_zmag(&cache[ncache], N, H)) == NULL) z = &cache[ncache++];
+        }
+        else if ((*errmsg = make_zmag(tmp, N, H)) == NULL) z = tmp;
+    }
+    CACHE_UNLOCK();
+    return z;
+}
+
+double ffGn_sigma(double spont, int model_version)
+{
+    if (model_version == 2014)
+        return (spont < 0.5) ? 3 : (spont < 18) ? 30 : 200;
+    else
+        return (spont < 0.2) ? 1 : (spont < 20) ? 10 : spont/2;
+}
+
+int ffGn(int N, double tdres, double Hinput, double spont, int model_version, int resampleN,
+         RNG *rng, double *y, const char **errmsg)
+{
+    double sigma;
+    int    i;
+
+    *errmsg = NULL;
+    if (!(spont > 0))                  { *errmsg = "The spontaneous rate must be positive.\n"; return 1; }
+    if (model_version != 2014 && model_version != 2018) { *errmsg = "Model version must be 2014 or 2018.\n"; return 1; }
+    if (ffGn_unit(N, tdres, Hinput, resampleN, rng, y, errmsg))
+        return 1;
+
+    /* Set the standard deviation, sigma */
+    sigma = ffGn_sigma(spont, model_version);
+    for (i=0; i<N; i++)
+        y[i] = sigma*y[i];
+    return 0;
+}
+
+int ffGn_unit(int N, double tdres, double Hinput, int resampleN, RNG *rng, double *y,
+              const char **errmsg)
+{
+    ZMAG tmp;
+    const ZMAG *z;
+    const FFTPLAN *plan;
+    double *y10 = NULL, *re = NULL, *im = NULL, *up = NULL, H, Tj = 0.1;
+    int nop = N, resamp, i, is_fBn;
+
+    *errmsg = NULL;
+    tmp.Zmag = NULL;
+    if (N <= 0)                        { *errmsg = "Length of the return vector must be positive.\n"; return 1; }
+    if (tdres > 1)                     { *errmsg = "Original sampling rate should be checked.\n"; return 1; }
+    if (!(Hinput > 0 && Hinput <= 2))  { *errmsg = "The Hurst parameter must be in the interval (0,2].\n"; return 1; }
+
+    /* Downsampling number of points to match those of Scott Jackson (Tj = 0.1s) */
+    resamp = (int) ceil(Tj/tdres);
+    N = (int) ceil((double) nop/resamp) + 1;
+    if (N < 10) N = 10;
+
+    /* Determine whether fGn or fBn should be produced */
+    is_fBn = (Hinput > 1);
+    H = is_fBn ? Hinput - 1 : Hinput;
+
+    y10 = (double*)malloc(N*sizeof(double));
+    up  = (double*)malloc((size_t)resample_length(N, resamp, 1)*sizeof(double));
+    if (!y10 || !up) { *errmsg = "ffGn: out of memory.\n"; goto cleanup; }
+
+    if (H == 0.5)
+        rng_normal(rng, y10, N);  /* fGn with H = 0.5 is white Gaussian noise */
+    else
+    {
+        if ((z = get_zmag(N, H, &tmp, errmsg)) == NULL) goto cleanup;
+        re = (double*)malloc(z->Nfft*sizeof(double));
+        im = (double*)malloc(z->Nfft*sizeof(double));
+        plan = fft_plan(z->Nfft);
+        if (!re || !im || !plan) { *errmsg = "ffGn: out of memory.\n"; goto cleanup; }
+
+        /* Z = Zmag.*complex(randn(1,Nfft),randn(1,Nfft)); y = sqrt(Nfft)*real(ifft(Z)) */
+        rng_normal(rng, re, z->Nfft);
+        rng_normal(rng, im, z->Nfft);
+        for (i=0; i<z->Nfft; i++)
+        {
+            re[i] *= z->Zmag[i];
+            im[i] *= z->Zmag[i];
+        }
+        fft_run(plan, re, im, 1);
+        for (i=0; i<N; i++)
+            y10[i] = sqrt((double) z->Nfft)*(re[i]/z->Nfft);
+    }
+
+    /* Convert the fGn to fBn, if necessary */
+    if (is_fBn)
+        for (i=1; i<N; i++)
+            y10[i] += y10[i-1];
+
+    /* Resampling back to original (1/tdres) to match with the AN model */
+    if (resample_poly(y10, N, resamp, 1, resampleN, up)) { *errmsg = "ffGn: out of memory.\n"; goto cleanup; }
+
+    /* Clip unneeded samples */
+    memcpy(y, up, (size_t)nop*sizeof(double));
+
+cleanup:
+    free(y10); free(up); free(re); free(im); free(tmp.Zmag);
+    return (*errmsg != NULL);
+}
+
+void ffGn_clear_cache(void)
+{
+    int i;
+
+    CACHE_LOCK();
+    for (i=0; i<ncache; i++)
+        free(cache[i].Zmag);
+    ncache = 0;
+    CACHE_UNLOCK();
+}
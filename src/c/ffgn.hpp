@@ -0,0 +1,42 @@
+#ifndef _FFGN_HPP
+#define _FFGN_HPP
+
+/* FFGN.HPP header file
+ * Native version of ffGn_rochester.m (src/matlab): fractional Gaussian noise (or Brownian
+ * motion, for 1 < Hinput <= 2) generated at 10 Hz by circulant embedding (Davies & Harte,
+ * 1987), upsampled to 1/tdres with resample_poly and scaled by the spontaneous-rate
+ * dependent sigma of the 2014 or 2018 model.
+ *
+ * The square-root spectrum Zmag of the embedding depends only on the 10-Hz length and on
+ * H.  ffGn_rochester kept it for the last (N,H) only; here every (N,H) seen so far is kept
+ * (up to FFGN_CACHE_SIZE of them), together with the FFT plans of fft.c, so sweeps that
+ * mix stimulus durations do not recompute it.
+ *
+ * The Gaussian deviates come from the caller's RNG stream (rng.hpp) instead of MATLAB's
+ * RandStreams, so a given seed does not reproduce ffGn_rochester's noise sample for
+ * sample; given the same deviates the two agree to rounding error.
+ */
+
+#include "rng.hpp"
+
+#define FFGN_CACHE_SIZE 32
+
+/* Fill y[0..N-1] with noise sampled at 1/tdres.  resampleN is the quality setting of the
+ * 10 Hz -> 1/tdres upsampling (see resample.hpp; RESAMPLE_N_MATLAB matches MATLAB).
+ * Returns 0 on success, non-zero with *errmsg set on bad arguments or lack of memory. */
+int ffGn(int N, double tdres, double Hinput, double spont, int model_version, int resampleN,
+         RNG *rng, double *y, const char **errmsg);
+
+/* ffGn with unit sigma: ffGn(..., spont, model_version, ...) is exactly ffGn_sigma(spont,
+ * model_version) times the output of ffGn_unit with the same rng, so fibers that share a
+ * noise sample but not a spontaneous rate can draw it once (see BundleAN) */
+int ffGn_unit(int N, double tdres, double Hinput, int resampleN, RNG *rng, double *y,
+              const char **errmsg);
+
+/* The standard deviation of ffGn's noise for a spontaneous rate (/s) */
+double ffGn_sigma(double spont, int model_version);
+
+/* Free all cached spectra (e.g. from a mexAtExit handler) */
+void ffGn_clear_cache(void);
+
+#endif
@@ -0,0 +1,123 @@
+/*
+fft.c implements the radix-2 FFT and plan cache declared in fft.hpp
+*/
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "fft.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+static SRWLOCK cache_lock = SRWLOCK_INIT;
+#define CACHE_LOCK()   AcquireSRWLockExclusive(&cache_lock)
+#define CACHE_UNLOCK() ReleaseSRWLockExclusive(&cache_lock)
+#else
+#include <pthread.h>
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#define CACHE_LOCK()   pthread_mutex_lock(&cache_lock)
+#define CACHE_UNLOCK() pthread_mutex_unlock(&cache_lock)
+#endif
+
+/* TWOPI of the model files is only good to 14 digits, too coarse for twiddle factors */
+#define FFT_TWOPI 6.283185307179586476925
+
+/* One plan per power of 2 up to 2^30 */
+#define MAXLOG2 31
+
+static FFTPLAN *cache[MAXLOG2];
+
+static FFTPLAN *make_plan(int n, int log2n)
+{
+    FFTPLAN *p = (FFTPLAN*)calloc(1,sizeof(FFTPLAN));
+    int k, b;
+
+    if (!p) return NULL;
+    p->n = n;
+    p->cosw   = (double*)malloc((n/2+1)*sizeof(double));
+    p->sinw   = (double*)malloc((n/2+1)*sizeof(double));
+    p->bitrev = (int*)malloc(n*sizeof(int));
+    if (!p->cosw || !p->sinw || !p->bitrev)
+    {
+        free(p->cosw); free(p->sinw); free(p->bitrev); free(p);
+        return NULL;
+    }
+    for (k=0; k<n/2; k++)
+    {
+        p->cosw[k] = cos(FFT_TWOPI*k/n);
+        p->sinw[k] = sin(FFT_TWOPI*k/n);
+    }
+    for (k=0; k<n; k++)
+    {
+        int r = 0;
+        for (b=0; b<log2n; b++)
+            if (k & (1<<b)) r |= 1<<(log2n-1-b);
+        p->bitrev[k] = r;
+    }
+    return p;
+}
+
+const FFTPLAN *fft_plan(int n)
+{
+    FFTPLAN *p;
+    int log2n = 0;
+
+    if (n < 1 || (n & (n-1))) return NULL;
+    while ((1<<log2n) < n) log2n++;
+
+    CACHE_LOCK();
+    if (cache[log2n] == NULL)
+        cache[log2n] = make_plan(n, log2n);
+    p = cache[log2n];
+    CACHE_UNLOCK();
+    return p;
+}
+
+void fft_run(const FFTPLAN *plan, double *re, double *im, int inverse)
+{
+    int n = plan->n, len, half, step, i, j, k;
+    double sgn = inverse ? 1.0 : -1.0, tr, ti, wr, wi;
+
+    for (i=0; i<n; i++)
+    {
+        j = plan->bitrev[i];
+        if (j > i)
+        {
+            tr = re[i]; re[i] = re[j]; re[j] = tr;
+            ti = im[i]; im[i] = im[j]; im[j] = ti;
+        }
+    }
+    for (len=2; len<=n; len<<=1)
+    {
+        half = len/2;
+        step = n/len;
+        for (i=0; i<n; i+=len)
+            for (k=0; k<half; k++)
+            {
+                wr = plan->cosw[k*step];
+                wi = sgn*plan->sinw[k*step];
+                j  = i+k+half;
+                tr = re[j]*wr - im[j]*wi;
+                ti = re[j]*wi + im[j]*wr;
+                re[j] = re[i+k] - tr;
+                im[j] = im[i+k] - ti;
+                re[i+k] += tr;
+                im[i+k] += ti;
+            }
+    }
+}
+
+void fft_clear_cache(void)
+{
+    int k;
+
+    CACHE_LOCK();
+    for (k=0; k<MAXLOG2; k++)
+        if (cache[k])
+        {
+            free(cache[k]->cosw); free(cache[k]->sinw); free(cache[k]->bitrev);
+            free(cache[k]);
+            cache[k] = NULL;
+        }
+    CACHE_UNLOCK();
+}
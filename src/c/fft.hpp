@@ -0,0 +1,30 @@
+#ifndef _FFT_HPP
+#define _FFT_HPP
+
+/* FFT.HPP header file
+ * A small radix-2 complex FFT for the model's native noise generator (ffgn.c).  Plans
+ * (twiddle factors and bit-reversal table) are built once per transform length and kept
+ * in a process-wide cache, so repeated transforms of the same length only pay for the
+ * butterflies.  All functions are thread safe.
+ */
+
+typedef struct {
+    int n;            /* transform length, a power of 2 */
+    double *cosw;     /* cos(2*pi*k/n), k = 0..n/2-1 */
+    double *sinw;     /* sin(2*pi*k/n), k = 0..n/2-1 */
+    int *bitrev;      /* bit-reversal permutation of 0..n-1 */
+} FFTPLAN;
+
+/* Cached plan for length n (a power of 2), or NULL if n is not one or memory ran out.
+ * Plans stay valid until fft_clear_cache. */
+const FFTPLAN *fft_plan(int n);
+
+/* In-place transform of re[0..n-1] + i*im[0..n-1]:
+ * forward  X(k) = sum_j x(j)*exp(-2*pi*i*j*k/n)      (as MATLAB's fft)
+ * inverse  x(j) = sum_k X(k)*exp(+2*pi*i*j*k/n)      (MATLAB's ifft times n) */
+void fft_run(const FFTPLAN *plan, double *re, double *im, int inverse);
+
+/* Free all cached plans (e.g. from a mexAtExit handler) */
+void fft_clear_cache(void);
+
+#endif
@@ -0,0 +1,242 @@
+/*
+ihc_cache.c implements the on-disk cache of IHC outputs declared in ihc_cache.hpp
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ihc_cache.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>
+#define getpid _getpid
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/* File header; its size keeps the samples 8-byte aligned */
+typedef struct {
+    char     magic[8];
+    uint64_t key[2];
+    int64_t  n;
+} IHCHEADER;
+
+static const char magic[8] = {'A','N','I','H','C','\0','\0','\1'};
+
+/* MurmurHash3 (x64, 128-bit) over a stream of 64-bit words */
+typedef struct {
+    uint64_t h1, h2, pending;
+    int64_t  nwords;
+} HASHER;
+
+static uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t fmix64(uint64_t k)
+{
+    k ^= k >> 33; k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33; k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+#define HASH_C1 0x87c37b91114253d5ULL
+#define HASH_C2 0x4cf5ad432745937fULL
+
+static void hash_word(HASHER *h, uint64_t w)
+{
+    uint64_t k1, k2;
+
+    if ((h->nwords++ & 1) == 0)
+    {
+        h->pending = w;
+        return;
+    }
+    k1 = h->pending; k2 = w;
+    k1 *= HASH_C1; k1 = rotl64(k1, 31); k1 *= HASH_C2; h->h1 ^= k1;
+    h->h1 = rotl64(h->h1, 27); h->h1 += h->h2; h->h1 = h->h1*5 + 0x52dce729;
+    k2 *= HASH_C2; k2 = rotl64(k2, 33); k2 *= HASH_C1; h->h2 ^= k2;
+    h->h2 = rotl64(h->h2, 31); h->h2 += h->h1; h->h2 = h->h2*5 + 0x38495ab5;
+}
+
+static void hash_double(HASHER *h, double x)
+{
+    uint64_t w;
+
+    memcpy(&w, &x, sizeof(w));
+    hash_word(h, w);
+}
+
+static void hash_final(HASHER *h, IHCKEY *key)
+{
+    uint64_t k1, h1 = h->h1, h2 = h->h2, len = (uint64_t) h->nwords * 8;
+
+    if (h->nwords & 1)
+    {
+        k1 = h->pending;
+        k1 *= HASH_C1; k1 = rotl64(k1, 31); k1 *= HASH_C2; h1 ^= k1;
+    }
+    h1 ^= len; h2 ^= len;
+    h1 += h2; h2 += h1;
+    h1 = fmix64(h1); h2 = fmix64(h2);
+    h1 += h2; h2 += h1;
+    key->h[0] = h1; key->h[1] = h2;
+}
+
+void ihc_cache_key(const double *px, double cf, int nrep, double tdres, int totalstim,
+                   double cohc, double cihc, int species, IHCKEY *key)
+{
+    HASHER h = {0, 0, 0, 0};
+    int    i;
+
+    hash_word(&h, IHC_CACHE_VERSION);
+    hash_double(&h, cf);   hash_word(&h, (uint64_t) nrep);
+    hash_double(&h, tdres); hash_word(&h, (uint64_t) totalstim);
+    hash_double(&h, cohc); hash_double(&h, cihc); hash_word(&h, (uint64_t) species);
+    for (i = 0; i < totalstim; i++)
+        hash_double(&h, px[i]);
+    hash_final(&h, key);
+}
+
+/* <dir>/<key>.ihc, plus room for a suffix; free the result */
+static char *entry_path(const char *dir, const IHCKEY *key, size_t extra)
+{
+    size_t len = strlen(dir);
+    char   *path = (char*)malloc(len + 40 + extra);
+
+    if (path)
+        sprintf(path, "%s/%016llx%016llx.ihc", dir,
+                (unsigned long long) key->h[0], (unsigned long long) key->h[1]);
+    return path;
+}
+
+/* The samples of a mapped file, or NULL if it is not a complete entry of key with n samples */
+static const double *check_entry(const void *base, size_t size, const IHCKEY *key, long long n)
+{
+    IHCHEADER hd;
+
+    if (size < sizeof(IHCHEADER)) return NULL;
+    memcpy(&hd, base, sizeof(IHCHEADER));
+    if (memcmp(hd.magic, magic, sizeof(magic)) != 0 || hd.key[0] != key->h[0] || hd.key[1] != key->h[1]
+        || hd.n != n || size != sizeof(IHCHEADER) + (size_t) n*sizeof(double))
+        return NULL;
+    return (const double*) ((const char*) base + sizeof(IHCHEADER));
+}
+
+#ifdef _WIN32
+
+const double *ihc_cache_map(const char *dir, const IHCKEY *key, long long n, IHCMAP *map)
+{
+    char          *path = entry_path(dir, key, 0);
+    LARGE_INTEGER size;
+    const double  *y = NULL;
+
+    memset(map, 0, sizeof(IHCMAP));
+    if (path == NULL) return NULL;
+    map->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    free(path);
+    if (map->file == INVALID_HANDLE_VALUE)
+    {
+        map->file = NULL;
+        return NULL;
+    }
+    if (GetFileSizeEx(map->file, &size) && size.QuadPart > 0
+        && (map->mapping = CreateFileMappingA(map->file, NULL, PAGE_READONLY, 0, 0, NULL)) != NULL
+        && (map->base = MapViewOfFile(map->mapping, FILE_MAP_READ, 0, 0, 0)) != NULL)
+    {
+        map->size = (size_t) size.QuadPart;
+        y = check_entry(map->base, map->size, key, n);
+    }
+    if (y == NULL)
+        ihc_cache_unmap(map);
+    return y;
+}
+
+void ihc_cache_unmap(IHCMAP *map)
+{
+    if (map->base)    UnmapViewOfFile(map->base);
+    if (map->mapping) CloseHandle(map->mapping);
+    if (map->file)    CloseHandle(map->file);
+    memset(map, 0, sizeof(IHCMAP));
+}
+
+static int rename_entry(const char *from, const char *to)
+{
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) ? 0 : 1;
+}
+
+#else
+
+const double *ihc_cache_map(const char *dir, const IHCKEY *key, long long n, IHCMAP *map)
+{
+    char         *path = entry_path(dir, key, 0);
+    struct stat  st;
+    const double *y = NULL;
+    void         *base;
+    int          fd;
+
+    memset(map, 0, sizeof(IHCMAP));
+    if (path == NULL) return NULL;
+    fd = open(path, O_RDONLY);
+    free(path);
+    if (fd < 0) return NULL;
+    if (fstat(fd, &st) == 0 && st.st_size > 0
+        && (base = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0)) != MAP_FAILED)
+    {
+        map->base = base; map->size = (size_t) st.st_size;
+        y = check_entry(map->base, map->size, key, n);
+    }
+    close(fd);  /* the mapping stays valid */
+    if (y == NULL)
+        ihc_cache_unmap(map);
+    return y;
+}
+
+void ihc_cache_unmap(IHCMAP *map)
+{
+    if (map->base) munmap(map->base, map->size);
+    memset(map, 0, sizeof(IHCMAP));
+}
+
+static int rename_entry(const char *from, const char *to)
+{
+    return rename(from, to) ? 1 : 0;
+}
+
+#endif
+
+int ihc_cache_store(const char *dir, const IHCKEY *key, const double *ihcout, long long n)
+{
+    char      *path = entry_path(dir, key, 0), *tmp = entry_path(dir, key, 32);
+    IHCHEADER hd;
+    FILE      *f = NULL;
+    int       err = 1;
+
+    if (path == NULL || tmp == NULL) goto cleanup;
+    /* A name no other writer uses: the process id and an address on this thread's stack */
+    sprintf(tmp + strlen(tmp), ".%d.%llx.tmp", (int) getpid(), (unsigned long long) (uintptr_t) &hd);
+    if ((f = fopen(tmp, "wb")) == NULL) goto cleanup;
+
+    memset(&hd, 0, sizeof(hd));
+    memcpy(hd.magic, magic, sizeof(magic));
+    hd.key[0] = key->h[0]; hd.key[1] = key->h[1];
+    hd.n = n;
+    err = fwrite(&hd, sizeof(hd), 1, f) != 1 || fwrite(ihcout, sizeof(double), (size_t) n, f) != (size_t) n;
+    err = (fclose(f) != 0) || err;
+    if (!err)
+        err = rename_entry(tmp, path);
+    if (err)
+        remove(tmp);
+
+cleanup:
+    free(tmp); free(path);
+    return err;
+}
@@ -0,0 +1,50 @@
+#ifndef _IHC_CACHE_HPP
+#define _IHC_CACHE_HPP
+
+/* IHC_CACHE.HPP header file
+ * Content-addressed on-disk cache of IHC outputs.  IHCAN is a pure function of (stimulus,
+ * cf, nrep, tdres, totalstim, cohc, cihc, species), so its output can be stored under a
+ * hash of those inputs and reused by any later call with the same inputs, in the same or
+ * another session.  Each entry is one file <dir>/<32 hex digits>.ihc: a small header
+ * followed by the totalstim*nrep output samples as native doubles.  Entries are written to
+ * a temporary file and renamed into place, so concurrent writers and readers only ever see
+ * complete files.  Nothing is ever evicted; delete the files to clear the cache.
+ *
+ * A hit is mapped read-only into memory, so native callers use the samples where they lie,
+ * without reading or copying the file.  IHC_CACHE_VERSION is part of every key: change it
+ * whenever a change to model_IHC.c changes its output, so that old entries are not found.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define IHC_CACHE_VERSION 1
+
+typedef struct {
+    uint64_t h[2];
+} IHCKEY;
+
+/* The key of IHCAN(px, cf, nrep, tdres, totalstim, cohc, cihc, species), a 128-bit hash
+ * of the totalstim samples of px and of the parameters */
+void ihc_cache_key(const double *px, double cf, int nrep, double tdres, int totalstim,
+                   double cohc, double cihc, int species, IHCKEY *key);
+
+/* A mapped entry */
+typedef struct {
+    void   *base;
+    size_t size;
+#ifdef _WIN32
+    void   *file, *mapping;
+#endif
+} IHCMAP;
+
+/* Map the entry of key in dir.  Returns its n samples, valid until ihc_cache_unmap, or NULL
+ * if there is no complete entry of n samples. */
+const double *ihc_cache_map(const char *dir, const IHCKEY *key, long long n, IHCMAP *map);
+
+void ihc_cache_unmap(IHCMAP *map);
+
+/* Store the n samples of ihcout as the entry of key in dir.  Returns 0 on success. */
+int ihc_cache_store(const char *dir, const IHCKEY *key, const double *ihcout, long long n);
+
+#endif
@@ -0,0 +1,381 @@
+/*
+ihc_filterbank.c runs the IHC model of model_IHC.c for AN_LANES CFs per vector instruction.
+
+Every quantity of the per-channel model is stored as an array of AN_LANES doubles (one per
+channel), so that a filter recurrence can be advanced for all channels of a group with a
+single vector operation.  The per-sample arithmetic follows IHCAN and its filter functions
+operation for operation; see those functions for the meaning of the individual terms.
+
+Compiled with IHC_BANK_SINGLE defined (ihc_filterbank_single.c), the same code becomes
+IHCAN_bank_single, which runs groups of AN_SLANES channels and keeps the IHC lowpass in
+single precision.  The rest stays double, as W/AN_LANES vectors per
+group: the chirp filters, whose poles lie close to z = 1 at low CFs, and the control path,
+a feedback loop (its output sets its own time constant) that amplifies rounding errors so
+much at high levels that rounding its signal to float changes some rates by 10%.  The
+whole call, double stages included, runs with subnormals flushed to zero (see
+FLUSH_DENORMALS below).
+
+A group keeps only its filter states and the control-path gains scheduled up to the group
+delay ahead, in a ring as in IHCAN, and writes each sample of the lowpass output straight
+into every repetition of ihcout: its memory does not grow with the stimulus.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "model_IHC.hpp"
+#include "ihc_filterbank.hpp"
+
+#ifndef TWOPI
+#define TWOPI 6.28318530717959
+#endif
+
+#ifndef __max
+#define __max(a,b) (((a) > (b))? (a): (b))
+#endif
+
+#ifdef IHC_BANK_SINGLE
+typedef float bank_t;
+#define W AN_SLANES
+#define IHCAN_BANK IHCAN_bank_single
+#define BANK_NAME "IHCAN_bank_single"
+/* Decaying filter states reach the float subnormals within a fraction of a second of
+   silence, and subnormal arithmetic is many times slower; they are flushed to zero, which
+   changes the output by less than the smallest normal float.  FTZ and DAZ are set in MXCSR
+   for the whole call, so they also apply to the double chirp filters and control path,
+   whose states reach the double subnormals in longer silences: that is where most of the
+   speed-up comes from (flushing the float lowpass alone halves it) */
+#if AN_SLANES > 1
+#define FLUSH_DENORMALS(save) ((save) = _mm_getcsr(), _mm_setcsr((save) | 0x8040))
+#define RESTORE_DENORMALS(save) _mm_setcsr(save)
+#endif
+#else
+typedef double bank_t;
+#define W AN_LANES
+#define IHCAN_BANK IHCAN_bank
+#define BANK_NAME "IHCAN_bank"
+#endif
+#ifndef FLUSH_DENORMALS
+#define FLUSH_DENORMALS(save) ((save) = 0)
+#define RESTORE_DENORMALS(save) ((void) (save))
+#endif
+
+/* Pole pair i (1..5) of the chirp filters uses pole set POLESET[i-1]: p[1], p[3], p[5], p[7]=p[1], p[9]=p[5] */
+static const int POLESET[5] = {0, 1, 2, 0, 2};
+
+/* Coefficients of one chirp filter (C1 or C2) for all lanes of a group */
+typedef struct {
+    CHIRPPLAN plan[W];                   /* the fixed part of each lane's filter */
+    double normgain[W];
+    double A[W], B[W], Cc[W];            /* zero terms: fs-rzero, 2*rzero, fs+rzero */
+    double D[3][W], E[3][W], T[3][W];    /* pole terms of the three distinct pole sets */
+    double hist[6][3][W];                /* hist[0] = input taps, hist[i] = output taps of pair i */
+} CHIRPBANK;
+
+/* Load the fixed part of a chirp filter for lane j from the channel's plan */
+static void chirp_init(CHIRPBANK *cb, int j, const CHIRPPLAN *cp)
+{
+    cb->plan[j]     = *cp;
+    cb->normgain[j] = cp->normgain;
+}
+
+/* Load the coefficients of lane j for one pole position */
+static void chirp_load(CHIRPBANK *cb, int j, const CHIRPCOEFS *k)
+{
+    int s;
+
+    cb->A[j]  = k->A;
+    cb->B[j]  = k->B;
+    cb->Cc[j] = k->Cc;
+    for (s=0; s<3; s++)
+    {
+        cb->D[s][j] = k->D[s];
+        cb->E[s][j] = k->E[s];
+        cb->T[s][j] = k->T[s];
+    }
+}
+
+/* Why IHCAN_chirp_coefs failed, from its return value */
+static const char *chirp_error(int status)
+{
+    return (status == 1) ? "The system becomes unstable.\n" : "The zeros are in the right-half plane.\n";
+}
+
+/* Advance all lanes of a chirp filter by one sample and store the (gain-corrected) outputs
+   in y; x is the input of every lane */
+static void chirp_step(CHIRPBANK *cb, double x, double *y)
+{
+    const vreal two = vset1(2.0);
+    vreal A, B, Cc, in1, in2, in3, out1, out2, dy;
+    int i, s, o;
+
+    for (o=0; o<W; o+=AN_LANES)
+    {
+        A = vload(cb->A+o); B = vload(cb->B+o); Cc = vload(cb->Cc+o);
+        vstore(cb->hist[0][2]+o, vload(cb->hist[0][1]+o));
+        vstore(cb->hist[0][1]+o, vload(cb->hist[0][0]+o));
+        vstore(cb->hist[0][0]+o, vset1(x));
+
+        for (i=1; i<=5; i++)
+        {
+            s    = POLESET[i-1];
+            in1  = vload(cb->hist[i-1][0]+o);
+            in2  = vload(cb->hist[i-1][1]+o);
+            in3  = vload(cb->hist[i-1][2]+o);
+            out1 = vload(cb->hist[i][0]+o);
+            out2 = vload(cb->hist[i][1]+o);
+
+            dy = vsub(vsub(vmul(in1,A), vmul(B,in2)), vmul(Cc,in3));
+            dy = vsub(vadd(dy, vmul(vmul(two,out1), vload(cb->D[s]+o))), vmul(out2, vload(cb->E[s]+o)));
+            dy = vdiv(dy, vload(cb->T[s]+o));
+
+            vstore(cb->hist[i][2]+o, out2);
+            vstore(cb->hist[i][1]+o, out1);
+            vstore(cb->hist[i][0]+o, dy);
+        }
+        vstore(y+o, vdiv(vmul(vload(cb->hist[5][0]+o), vload(cb->normgain+o)), vset1(4.0)));
+    }
+}
+
+/* Advance lanes o ... o+AN_LANES-1 of an order-th order lowpass cascade (OhcLowPass /
+   IhcLowPass, gain 1) by one sample */
+static vreal lowpass_step(double (*yl)[W], int o, int order, vreal x, vreal c1LP, vreal c2LP)
+{
+    vreal y[8];
+    int i;
+
+    y[0] = x;
+    for (i=0; i<order; i++)
+        y[i+1] = vadd(vmul(c1LP, vload(yl[i+1]+o)), vmul(c2LP, vadd(y[i], vload(yl[i]+o))));
+    for (i=0; i<=order; i++)
+        vstore(yl[i]+o, y[i]);
+    return y[order];
+}
+
+#ifdef IHC_BANK_SINGLE
+/* The same for all lanes of the IHC lowpass in single precision */
+static vsingle lowpass_step_single(float (*yl)[W], int order, vsingle x, vsingle c1LP, vsingle c2LP)
+{
+    vsingle y[8];
+    int i;
+
+    y[0] = x;
+    for (i=0; i<order; i++)
+        y[i+1] = vsadd(vsmul(c1LP, vsload(yl[i+1])), vsmul(c2LP, vsadd(y[i], vsload(yl[i]))));
+    for (i=0; i<=order; i++)
+        vsstore(yl[i], y[i]);
+    return y[order];
+}
+#endif
+
+/* Grow the ring of control-path gains scheduled for samples n ... n+grd of every lane
+   (gain[(m % ngain)*W+j] for sample m of lane j), as ihcan_c1_path does for one channel */
+static int gain_grow(double **gain, int *ngain, int n, int grd)
+{
+    int m, j, size = *ngain;
+    double *g;
+
+    while (size <= grd) size *= 2;
+    if ((g = (double*)calloc((size_t)size*W,sizeof(double))) == NULL)
+        return 1;
+    for (m=n; m<n+*ngain; m++)
+        for (j=0; j<W; j++)
+            g[(size_t)(m % size)*W+j] = (*gain)[(size_t)(m % *ngain)*W+j];
+    free(*gain);
+    *gain = g; *ngain = size;
+    return 0;
+}
+
+/* Run one group of up to W channels (lanes beyond nch repeat the last channel) */
+static const char *ihc_group(const double *meout, const double *cfs, int nch, int nrep, double tdres,
+                             int totalstim, double cohc, double cihc, int species, double **ihcout)
+{
+    CHIRPBANK *c1 = NULL, *c2 = NULL;
+    double *gain = NULL;
+    double cf[W], centerfreq[W], TauWBMax[W], TauWBMin[W], bmTaumax[W], bmTaumin[W], tauwb[W];
+    double wbgain[W], lasttmpgain[W], wbphase[W], dphase[W];
+    double wbre[4][W], wbim[4][W], ohcl[3][W];
+    double cs[W], sn[W], c1LP[W], c2LPg[W], buf[W], c1out[W], c2out[W];
+    bank_t ihcl[8][W], ihcin[W], ihcy[W];
+    double c, ohc_c1LP, ohc_c2LP, ihc_c1LP, ihc_c2LP;
+    const char *errmsg = NULL;
+    int grdelay[1], j, n, i, o, ngain = 64, delaypoint[W];
+    size_t m, len = (size_t)totalstim*nrep;
+    vreal x, gre[4], gim[4], cl, cg;
+    IHCPLAN plan;
+
+    c1 = (CHIRPBANK*)calloc(1,sizeof(CHIRPBANK));
+    c2 = (CHIRPBANK*)calloc(1,sizeof(CHIRPBANK));
+    gain = (double*)calloc((size_t)ngain*W,sizeof(double));  /* grown as needed (gain_grow) */
+    if (!c1 || !c2 || !gain)
+    {
+        errmsg = BANK_NAME ": out of memory.\n";
+        goto cleanup;
+    }
+    memset(wbre, 0, sizeof(wbre)); memset(wbim, 0, sizeof(wbim));
+    memset(ohcl, 0, sizeof(ohcl)); memset(ihcl, 0, sizeof(ihcl));
+
+    /*====== Per-channel parameters (as at the top of IHCAN) ======*/
+    for (j=0; j<W; j++)
+    {
+        cf[j] = cfs[(j<nch) ? j : nch-1];
+        IHCAN_plan(cf[j], tdres, cohc, species, &plan);
+        centerfreq[j] = plan.centerfreq;
+        bmTaumax[j] = plan.bmTaumax;
+        bmTaumin[j] = plan.bmTaumin;
+        TauWBMax[j] = plan.TauWBMax;
+        TauWBMin[j] = plan.TauWBMin;
+        tauwb[j]    = plan.tauwb;
+        wbgain[j]   = plan.wbgain;
+        gain[j]        = wbgain[j];
+        lasttmpgain[j] = wbgain[j];
+        delaypoint[j]  = IHCAN_delaypoint(cf[j], tdres);
+        wbphase[j] = 0;
+        dphase[j]  = -TWOPI*centerfreq[j]*tdres;
+
+        chirp_init(c1, j, &plan.c1);
+        chirp_init(c2, j, &plan.c2);
+        /* The C2 filter is time invariant: its poles never move from -sigma0/ratiobm */
+        if (plan.c2status)
+        {
+            errmsg = chirp_error(plan.c2status);
+            goto cleanup;
+        }
+        chirp_load(c2, j, &plan.c2coefs);
+    }
+
+    c = 2.0/tdres;
+    ohc_c1LP = ( c - TWOPI*600 ) / ( c + TWOPI*600 );
+    ohc_c2LP = TWOPI*600 / (TWOPI*600 + c);
+    ihc_c1LP = ( c - TWOPI*3000 ) / ( c + TWOPI*3000 );
+    ihc_c2LP = TWOPI*3000 / (TWOPI*3000 + c);
+
+    for (n=0; n<totalstim; n++)
+    {
+        x = vset1(meout[n]);
+
+        /*====== Control-path filter (WbGammaTone) ======*/
+        for (j=0; j<W; j++)
+        {
+            double dtmp = tauwb[j]*2.0/tdres;
+            wbphase[j] += dphase[j];
+            cs[j] = cos(wbphase[j]);
+            sn[j] = sin(wbphase[j]);
+            c1LP[j]  = (dtmp-1)/(dtmp+1);
+            c2LPg[j] = 1.0/(dtmp+1)*wbgain[j];
+        }
+        for (o=0; o<W; o+=AN_LANES)
+        {
+            cl = vload(c1LP+o); cg = vload(c2LPg+o);
+            gre[0] = vmul(x, vload(cs+o));
+            gim[0] = vmul(x, vload(sn+o));
+            for (i=1; i<=3; i++)
+            {
+                gre[i] = vadd(vmul(cg, vadd(gre[i-1], vload(wbre[i-1]+o))), vmul(cl, vload(wbre[i]+o)));
+                gim[i] = vadd(vmul(cg, vadd(gim[i-1], vload(wbim[i-1]+o))), vmul(cl, vload(wbim[i]+o)));
+            }
+            for (i=0; i<=3; i++)
+            {
+                vstore(wbre[i]+o, gre[i]);
+                vstore(wbim[i]+o, gim[i]);
+            }
+            /* shift back up: Re(exp(-i*phase)*g) = cos(phase)*g.x + sin(phase)*g.y */
+            vstore(buf+o, vadd(vmul(vload(cs+o), gre[3]), vmul(vload(sn+o), gim[3])));
+        }
+
+        /*====== OHC nonlinearity and lowpass ======*/
+        for (j=0; j<W; j++)
+        {
+            double wbout = pow((tauwb[j]/TauWBMax[j]),3)*buf[j]*10e3*__max(1,cf[j]/5e3);
+            buf[j] = Boltzman(wbout,7.0,12.0,5.0,5.0);
+        }
+        for (o=0; o<W; o+=AN_LANES)
+            vstore(buf+o, lowpass_step(ohcl, o, 2, vload(buf+o), vset1(ohc_c1LP), vset1(ohc_c2LP)));
+
+        /*====== Control signal: C1 pole shift, wideband tau and gain ======*/
+        for (j=0; j<W; j++)
+        {
+            double tmptauc1, tauc1, rsigma, wb_gain, *g;
+            CHIRPCOEFS k;
+            int status, grd;
+
+            tmptauc1 = NLafterohc(buf[j],bmTaumin[j],bmTaumax[j],7.0);
+            tauc1    = cohc*(tmptauc1-bmTaumin[j])+bmTaumin[j];
+            rsigma   = 1/tauc1-1/bmTaumax[j];
+            if (1/tauc1<0.0)
+            {
+                errmsg = "The poles are in the right-half plane; system is unstable.\n";
+                goto cleanup;
+            }
+            tauwb[j] = TauWBMax[j]+(tauc1-bmTaumax[j])*(TauWBMax[j]-TauWBMin[j])/(bmTaumax[j]-bmTaumin[j]);
+            wb_gain  = gain_groupdelay(tdres,centerfreq[j],cf[j],tauwb[j],grdelay);
+            grd      = grdelay[0];
+            if (grd >= ngain && gain_grow(&gain, &ngain, n, grd))
+            {
+                errmsg = BANK_NAME ": out of memory.\n";
+                goto cleanup;
+            }
+            if (grd >= 0)
+                gain[(size_t)((grd+n) % ngain)*W+j] = wb_gain;
+            g = gain + (size_t)(n % ngain)*W + j;
+            if (*g == 0)
+                *g = lasttmpgain[j];
+            wbgain[j]      = *g;
+            lasttmpgain[j] = wbgain[j];
+            *g = 0;
+
+            if ((status = IHCAN_chirp_coefs(&c1->plan[j], -c1->plan[j].sigma0 - rsigma, &k)) != 0)
+            {
+                errmsg = chirp_error(status);
+                goto cleanup;
+            }
+            chirp_load(c1, j, &k);
+        }
+
+        /*====== Signal-path C1 and parallel-path C2 filters ======*/
+        chirp_step(c1, meout[n], c1out);
+        chirp_step(c2, meout[n], c2out);
+
+        /*====== IHC transduction and lowpass, into every repetition of ihcout ======*/
+        for (j=0; j<W; j++)
+        {
+            double c1vihc =  NLogarithm(cihc*c1out[j],0.1,3.0,cf[j]);
+            double c2vihc = -NLogarithm(c2out[j]*fabs(c2out[j])*cf[j]/10*cf[j]/2e3,0.2,1.0,cf[j]);
+            ihcin[j] = (bank_t) (c1vihc+c2vihc);
+        }
+#ifdef IHC_BANK_SINGLE
+        vsstore(ihcy, lowpass_step_single(ihcl, 7, vsload(ihcin), vsset1((float) ihc_c1LP), vsset1((float) ihc_c2LP)));
+#else
+        for (o=0; o<W; o+=AN_LANES)
+            vstore(ihcy+o, lowpass_step(ihcl, o, 7, vload(ihcin+o), vset1(ihc_c1LP), vset1(ihc_c2LP)));
+#endif
+        /* Sample n of the period goes to every repetition after the total path delay, as
+           in IHCAN, or only to sample n with nrep = 0 (the undelayed period) */
+        for (j=0; j<nch; j++)
+            if (nrep == 0)
+                ihcout[j][n] = ihcy[j];
+            else
+                for (m=(size_t)delaypoint[j]+n; m<len; m+=totalstim)
+                    ihcout[j][m] = ihcy[j];
+    }
+
+cleanup:
+    free(c1); free(c2); free(gain);
+    return errmsg;
+}
+
+int IHCAN_BANK(const double *meout, const double *cfs, int nch, int nrep, double tdres, int totalstim,
+               double cohc, double cihc, int species, double **ihcout, const char **errmsg)
+{
+    unsigned int csr;
+    int first;
+
+    *errmsg = NULL;
+    FLUSH_DENORMALS(csr);
+    for (first=0; first<nch && *errmsg==NULL; first+=W)
+        *errmsg = ihc_group(meout, cfs+first, (nch-first < W) ? nch-first : W, nrep, tdres,
+                            totalstim, cohc, cihc, species, ihcout+first);
+    RESTORE_DENORMALS(csr);
+    return (*errmsg != NULL);
+}
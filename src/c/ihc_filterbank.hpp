@@ -0,0 +1,35 @@
+#ifndef _IHC_FILTERBANK_HPP
+#define _IHC_FILTERBANK_HPP
+
+/* IHC_FILTERBANK.HPP header file
+ * Struct-of-arrays version of the IHC model (model_IHC.c) that advances AN_LANES CFs per
+ * vector instruction (see simd.hpp): lane j of every filter register holds channel j.
+ * The recurrences of the C1 and C2 chirp filters, the control-path gammatone and the OHC
+ * and IHC lowpass filters are vectorized; the per-channel coefficient updates that need
+ * transcendental functions (pole phase, rzero, gammatone phase, nonlinearities) are still
+ * computed lane by lane.  Results equal IHCAN's up to floating-point rounding (they are
+ * identical when neither file is compiled with FMA contraction).
+ */
+
+#include "simd.hpp"
+
+/* Run the IHC model for nch CFs that share one stimulus, nrep, tdres, cohc, cihc and
+ * species; channels are processed AN_LANES at a time.  The input is the middle-ear output
+ * meout of the stimulus (IHCAN_middle_ear in model_IHC.hpp, totalstim samples), which does
+ * not depend on CF: compute it once and pass it to every call that shares the stimulus.
+ * ihcout[c] receives totalstim*nrep samples for channel c and must be zeroed by the caller;
+ * with nrep = 0 it receives the undelayed period only (totalstim samples), as IHCAN_period.
+ * Returns 0 on success, or non-zero with *errmsg set.  Safe to call from several threads
+ * at once. */
+int IHCAN_bank(const double *meout, const double *cfs, int nch, int nrep, double tdres, int totalstim,
+               double cohc, double cihc, int species, double **ihcout, const char **errmsg);
+
+/* The same with single precision where it is safe (ihc_filterbank_single.c): channels are
+ * processed AN_SLANES at a time and the IHC lowpass is float.  The chirp filters and the
+ * control path stay double (see ihc_filterbank.c), and so does ihcout, but the whole call,
+ * double stages included, runs with subnormals flushed to zero (FTZ/DAZ).  See
+ * check_single_precision.m for the difference it makes. */
+int IHCAN_bank_single(const double *meout, const double *cfs, int nch, int nrep, double tdres, int totalstim,
+                      double cohc, double cihc, int species, double **ihcout, const char **errmsg);
+
+#endif
@@ -0,0 +1,7 @@
+/*
+ihc_filterbank_single.c compiles ihc_filterbank.c in single precision as IHCAN_bank_single
+(see ihc_filterbank.hpp)
+*/
+
+#define IHC_BANK_SINGLE
+#include "ihc_filterbank.c"
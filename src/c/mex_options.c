@@ -0,0 +1,167 @@
+/*
+mex_options.c parses the opts struct of the MEX gateways, see mex_options.hpp
+*/
+
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <mex.h>
+
+#include "mex_options.hpp"
+
+/* Value of a real scalar option */
+static double option_scalar(const char *name, const mxArray *v)
+{
+    if (!mxIsDouble(v) || mxGetNumberOfElements(v) != 1)
+    {
+        mexPrintf("opts.%s must be a real scalar\n", name);
+        mexErrMsgTxt("\n");
+    }
+    return mxGetPr(v)[0];
+}
+
+/* Value of an integer option between lo and hi, checked before the cast; msg otherwise */
+static int option_int(const char *name, const mxArray *v, double lo, double hi, const char *msg)
+{
+    double x = option_scalar(name, v);
+
+    if (!isfinite(x) || x != floor(x) || x < lo || x > hi)
+        mexErrMsgTxt(msg);
+    return (int) x;
+}
+
+/* Real vector field f of the struct v of opts.pla; all four vectors must have n elements */
+static const double *pla_vector(const mxArray *v, const char *f, int *n)
+{
+    const mxArray *a = mxGetField(v, 0, f);
+
+    if (a == NULL || !mxIsDouble(a) || mxIsEmpty(a))
+    {
+        mexPrintf("opts.pla.%s must be a real vector\n", f);
+        mexErrMsgTxt("\n");
+    }
+    if (*n >= 0 && (int) mxGetNumberOfElements(a) != *n)
+        mexErrMsgTxt("opts.pla.tau_slow, w_slow, tau_fast and w_fast must have the same length.\n");
+    *n = (int) mxGetNumberOfElements(a);
+    return mxGetPr(a);
+}
+
+/* opts.pla: the name of a registered set or of a parameter file, or a struct with fields
+   tau_slow, w_slow, tau_fast, w_fast and optionally fs_synapse */
+static void get_pla_params(const mxArray *v, PLAPARAMS *pla)
+{
+    const double *tau_slow, *w_slow, *tau_fast, *w_fast;
+    const mxArray *fs;
+    const char *errmsg;
+    char *spec;
+    int  n = -1, i, err;
+
+    if (mxIsChar(v))
+    {
+        spec = mxArrayToString(v);
+        err  = pla_params_get(spec, pla, &errmsg);
+        if (err)
+            mexPrintf("opts.pla = '%s': ", spec);
+        mxFree(spec);
+        if (err)
+            mexErrMsgTxt(errmsg);
+        return;
+    }
+    if (!mxIsStruct(v) || mxGetNumberOfElements(v) != 1)
+        mexErrMsgTxt("opts.pla must be a parameter set name, a file name or a scalar struct.\n");
+    for (i=0; i<mxGetNumberOfFields(v); i++)
+    {
+        const char *f = mxGetFieldNameByNumber(v, i);
+        if (strcmp(f, "tau_slow") && strcmp(f, "w_slow") && strcmp(f, "tau_fast")
+            && strcmp(f, "w_fast") && strcmp(f, "fs_synapse"))
+        {
+            mexPrintf("Unknown field opts.pla.%s\n", f);
+            mexErrMsgTxt("\n");
+        }
+    }
+    tau_slow = pla_vector(v, "tau_slow", &n);
+    w_slow   = pla_vector(v, "w_slow", &n);
+    tau_fast = pla_vector(v, "tau_fast", &n);
+    w_fast   = pla_vector(v, "w_fast", &n);
+    fs       = mxGetField(v, 0, "fs_synapse");
+    if (pla_params_set(pla, n, fs ? option_scalar("pla.fs_synapse", fs) : 10e3,
+                       tau_slow, w_slow, tau_fast, w_fast, &errmsg))
+        mexErrMsgTxt(errmsg);
+}
+
+void get_synapse_options(const mxArray *s, SYNOPTS *opts)
+{
+    const char *name;
+    const mxArray *v;
+    int i, nfields;
+
+    Synapse_default_options(opts);
+    if (s == NULL || mxIsEmpty(s))
+        return;
+    if (!mxIsStruct(s) || mxGetNumberOfElements(s) != 1)
+        mexErrMsgTxt("opts must be a scalar struct.\n");
+
+    nfields = mxGetNumberOfFields(s);
+    for (i=0; i<nfields; i++)
+    {
+        name = mxGetFieldNameByNumber(s, i);
+        v    = mxGetFieldByNumber(s, 0, i);
+        if (strcmp(name, "resample_n") == 0)
+        {
+            opts->resampleN = option_int(name, v, 1, INT_MAX,
+                                         "opts.resample_n must be a positive integer.\n");
+        }
+        else if (strcmp(name, "seed") == 0)
+        {
+            double seed = option_scalar(name, v);
+            if (seed < 0 || seed != floor(seed) || seed > 9007199254740992.0)
+                mexErrMsgTxt("opts.seed must be an integer between 0 and 2^53.\n");
+            opts->seed = (uint64_t) seed;
+        }
+        else if (strcmp(name, "fiber_id") == 0)
+        {
+            double fiber = option_scalar(name, v);
+            if (fiber < 0 || fiber != floor(fiber) || fiber > 4294967295.0)
+                mexErrMsgTxt("opts.fiber_id must be an integer between 0 and 2^32-1.\n");
+            opts->fiber = (uint32_t) fiber;
+        }
+        else if (strcmp(name, "ntrials") == 0)
+        {
+            opts->ntrials = option_int(name, v, 1, INT_MAX,
+                                       "opts.ntrials must be a positive integer.\n");
+        }
+        else if (strcmp(name, "nthreads") == 0)
+        {
+            opts->nthreads = option_int(name, v, 0, INT_MAX,
+                                        "opts.nthreads must be a non-negative integer.\n");
+        }
+        else if (strcmp(name, "independent_reps") == 0)
+        {
+            double indep = option_scalar(name, v);
+            if (indep != 0 && indep != 1)
+                mexErrMsgTxt("opts.independent_reps must be 0 or 1.\n");
+            opts->indepreps = (int) indep;
+        }
+        else if (strcmp(name, "pla") == 0)
+            get_pla_params(v, &opts->pla);
+        else if (strcmp(name, "precision") == 0)
+        {
+            char *prec = mxIsChar(v) ? mxArrayToString(v) : NULL;
+            if (prec == NULL || (strcmp(prec, "double") && strcmp(prec, "single")))
+                mexErrMsgTxt("opts.precision must be 'double' or 'single'.\n");
+            opts->single = (strcmp(prec, "single") == 0);
+            mxFree(prec);
+        }
+        else if (strcmp(name, "neurogram") == 0)
+        {
+            /* left allocated: MATLAB frees it when the MEX function returns */
+            if (!mxIsChar(v) || (opts->neurogram = mxArrayToString(v)) == NULL || !opts->neurogram[0])
+                mexErrMsgTxt("opts.neurogram must be the name of a file.\n");
+        }
+        else
+        {
+            mexPrintf("Unknown option opts.%s\n", name);
+            mexErrMsgTxt("\n");
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef _MEX_OPTIONS_HPP
+#define _MEX_OPTIONS_HPP
+
+/* MEX_OPTIONS.HPP header file
+ * Parsing of the optional trailing `opts` struct accepted by the MEX gateways.  Each field
+ * sets one member of SYNOPTS (model_Synapse_v2025a.hpp); fields that are not given keep
+ * their defaults, and unknown fields are an error so that typos do not go unnoticed.
+ *
+ *   opts.resample_n   filter length N of the synapse stage's resamplers, the 100 kHz ->
+ *                     sampFreq decimator and the upsampler of the fGn (default 10, as
+ *                     MATLAB's resample; see resample.hpp).  Their cost is proportional
+ *                     to N.  The filter reaches N/sampFreq s either side of an
+ *                     abrupt onset, so smaller N mainly changes the rate around onsets: for
+ *                     a 100-ms tone burst the rms change in mean rate was 2% at N=8, 4% at
+ *                     N=6 and 6% at N=4.
+ *   opts.seed         seed of the fiber's random numbers: the fGn (when noiseType is 1) and
+ *                     the spike generator (see rng.hpp).  Runs with the same seed give the
+ *                     same output.  Default: a fresh seed from the clock for every call.
+ *   opts.fiber_id     id of the fiber's random streams (default 0); fibers that share a
+ *                     seed but not an id are statistically independent.  The population
+ *                     model adds the channel index.
+ *   opts.ntrials      number of spike trains drawn from the fiber's one synapse output
+ *                     (default 1).  The synapse and its fGn are computed once; trial k
+ *                     uses the spike stream (seed, fiber_id, k), so trial 0 is the spike
+ *                     train of a single-trial run.  The psth output counts the spikes of
+ *                     all trials, and model_Synapse_v2025a returns those of each trial as
+ *                     an optional fourth output (ntrials x totalstim).
+ *   opts.nthreads     threads the trials are spread over (default 0, one per processor).
+ *                     The output does not depend on it.  The population model runs the
+ *                     trials of each channel on that channel's worker.
+ *   opts.independent_reps  1 to run each of the nrep repetitions from rest (spontaneous
+ *                     adaptation state, PLA memory cleared) with its own spike trains,
+ *                     instead of carrying the synapse's state over; default 0.  With
+ *                     fresh noise each repetition draws its own fGn; frozen noise is the
+ *                     same for all of them.  The repetitions then
+ *                     run concurrently on opts.nthreads threads and are summed in order,
+ *                     so the output does not depend on it.  model_AN_bundle rejects it.
+ *   opts.pla          parameters of the parallel-exponential PLA approximation (implnt 2)
+ *                     and the synapse sampling rate: the name of a built-in set ('gc2024',
+ *                     the default and Table 1 of Guest and Carney (2024), or 'heuristic6',
+ *                     'heuristic10', 'heuristic14' and 'heuristic20'), the name of a
+ *                     parameter file, or a struct with vectors tau_slow, w_slow, tau_fast
+ *                     and w_fast and optionally fs_synapse (default 10e3).  See
+ *                     pla_params.hpp for the file format.  Fewer processes are faster.
+ *                     Only implnt 2 uses the weights; the implnt 0 filters assume a 10 kHz
+ *                     fs_synapse.
+ *   opts.precision    'double' (default) or 'single': the arithmetic of the IHC filters of
+ *                     model_AN_population (see IHCAN_bank_single in ihc_filterbank.hpp).
+ *                     The other gateways ignore it; the synapse is always double.  Run
+ *                     check_single_precision.m to see the difference it makes.
+ *   opts.neurogram    name of a file for model_AN_population to write its outputs to,
+ *                     instead of returning them (see neurogram.hpp and read_neurogram.m).
+ *                     The other gateways ignore it.
+ */
+
+#include <mex.h>
+#include "model_Synapse_v2025a.hpp"
+
+/* Fill *opts from the struct s; s may be NULL or [] for all defaults */
+void get_synapse_options(const mxArray *s, SYNOPTS *opts);
+
+#endif
@@ -0,0 +1,36 @@
+/*
+mex_profile.c makes the profile struct of the MEX gateways, see mex_profile.hpp
+*/
+
+#include <mex.h>
+
+#include "mex_profile.hpp"
+
+mxArray *mex_profile(const ANPROF *p)
+{
+    const char *stage_fields[2] = {"seconds", "calls"};
+    const char *fields[PROF_NSTAGE+3];
+    mxArray *s, *st;
+    double  total = 0;
+    int     i;
+
+    for (i = 0; i < PROF_NSTAGE; i++)
+        fields[i] = prof_stage_name[i];
+    fields[PROF_NSTAGE]   = "total_seconds";
+    fields[PROF_NSTAGE+1] = "bytes_allocated";
+    fields[PROF_NSTAGE+2] = "peak_working_set";
+
+    s = mxCreateStructMatrix(1, 1, PROF_NSTAGE+3, fields);
+    for (i = 0; i < PROF_NSTAGE; i++)
+    {
+        st = mxCreateStructMatrix(1, 1, 2, stage_fields);
+        mxSetField(st, 0, "seconds", mxCreateDoubleScalar(p->seconds[i]));
+        mxSetField(st, 0, "calls",   mxCreateDoubleScalar((double) p->calls[i]));
+        mxSetField(s, 0, prof_stage_name[i], st);
+        total += p->seconds[i];
+    }
+    mxSetField(s, 0, "total_seconds",    mxCreateDoubleScalar(total));
+    mxSetField(s, 0, "bytes_allocated",  mxCreateDoubleScalar(p->bytes));
+    mxSetField(s, 0, "peak_working_set", mxCreateDoubleScalar(prof_peak_working_set()));
+    return s;
+}
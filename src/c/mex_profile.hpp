@@ -0,0 +1,21 @@
+#ifndef _MEX_PROFILE_HPP
+#define _MEX_PROFILE_HPP
+
+/* MEX_PROFILE.HPP header file
+ * The profile output of the MEX gateways: a struct with one field per stage of profile.hpp,
+ * each a struct with fields seconds and calls, and the fields
+ *
+ *   total_seconds      sum of the stage times
+ *   bytes_allocated    working memory allocated by the model during the call
+ *   peak_working_set   peak working-set size of the MATLAB process so far, in bytes
+ *
+ * Stages the call did not run have zero seconds and calls.
+ */
+
+#include <mex.h>
+
+#include "profile.hpp"
+
+mxArray *mex_profile(const ANPROF *p);
+
+#endif
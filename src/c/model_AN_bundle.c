@@ -0,0 +1,145 @@
+/* Fiber-bundle entry point for the synapse / spike-generator stage of:
+ *
+ * Zilany, M. S., Bruce, I. C., & Carney, L. H. (2014). Updated parameters and expanded
+ * simulation options for a model of the auditory periphery. The Journal of the Acoustical
+ * Society of America, 135(1), 283-286.
+ *
+ * with the power-law adaptation approximation of:
+ *
+ * Guest, D. R., & Carney, L. H. (2024). A fast and accurate approximation of power-law
+ * adaptation for auditory computational models. The Journal of the Acoustical Society of
+ * America, 156(6), 3954-3957.
+ *
+ * Models with several fibers per CF used to call model_Synapse_v2025a once per fiber, each
+ * call rerunning the exponential adaptation, the decimator and the fGn on the same IHC
+ * output.  model_AN_bundle takes one IHC output and a list of fibers and runs those stages
+ * once per fiber type (see BundleAN in model_Synapse_v2025a.hpp); with frozen noise the
+ * whole synapse runs once per type, and only the spike generator once per fiber.  Fiber f
+ * (counting from 1) has fiber id opts.fiber_id+f-1, and its outputs are identical to those
+ * of model_Synapse_v2025a with its type and id.
+ *
+ * Usage (all rates in /s, time in s):
+ *
+ *   [meanrate, varrate, psth] = model_AN_bundle(ihcout, cf, nrep, tdres, fibertypes, counts,
+ *       noiseType, implnt[, opts])
+ *
+ * ihcout, cf, nrep, tdres, noiseType, implnt and opts are as for model_Synapse_v2025a.  The
+ * bundle has counts(k) fibers of type fibertypes(k), in that order; counts may be a scalar.
+ * The outputs are nfiber x totalstim, one row per fiber.  The fibers run on opts.nthreads
+ * threads (default: one per processor).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <mex.h>
+
+#include "model_Synapse_v2025a.hpp"
+#include "resample.hpp"
+#include "fft.hpp"
+#include "ffgn.hpp"
+#include "thread_pool.hpp"
+#include "mex_options.hpp"
+
+/* Release the filter designs, FFT plans, noise spectra and PLA parameter files cached by the
+   native code, and stop the parked worker threads */
+static void clear_caches(void)
+{
+    resample_clear_cache();
+    ffGn_clear_cache();
+    fft_clear_cache();
+    pla_params_clear_cache();
+    tpool_shutdown();
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+    double *pxtmp, *px, *types, *counts, *fibertypes, *meanrate, *varrate, *psth;
+    double cf, tdres, noiseType, implnt, count;
+    int    pxbins, nrep, totalstim, ntype, ncount, nfiber, f, i, k;
+    mwSize outsize[2];
+    SYNOPTS opts;
+    const char *errmsg;
+
+    if (nrhs != 8 && nrhs != 9)
+        mexErrMsgTxt("model_AN_bundle requires 8 input arguments (plus an optional opts struct).");
+    if (nlhs != 3)
+        mexErrMsgTxt("model_AN_bundle requires 3 output arguments.");
+
+    /* Assign pointers to the inputs and check them */
+    pxtmp     = mxGetPr(prhs[0]);
+    pxbins    = (int) mxGetN(prhs[0]);
+    cf        = mxGetPr(prhs[1])[0];
+    nrep      = (int) mxGetPr(prhs[2])[0];
+    tdres     = mxGetPr(prhs[3])[0];
+    types     = mxGetPr(prhs[4]);
+    ntype     = (int) mxGetNumberOfElements(prhs[4]);
+    counts    = mxGetPr(prhs[5]);
+    ncount    = (int) mxGetNumberOfElements(prhs[5]);
+    noiseType = mxGetPr(prhs[6])[0];
+    implnt    = mxGetPr(prhs[7])[0];
+    get_synapse_options((nrhs > 8) ? prhs[8] : NULL, &opts);
+    mexAtExit(clear_caches);
+
+    if (pxbins==1)
+        mexErrMsgTxt("ihcout must be a row vector\n");
+    if (nrep<1)
+        mexErrMsgTxt("nrep must be greater that 0.\n");
+    if (ntype < 1)
+        mexErrMsgTxt("fibertypes must contain at least one fiber type.\n");
+    if (ncount != 1 && ncount != ntype)
+        mexErrMsgTxt("counts must be a scalar or have one entry per fiber type.\n");
+    nfiber = 0;
+    for (k=0; k<ntype; k++)
+    {
+        if (types[k]!=1 && types[k]!=2 && types[k]!=3)
+            mexErrMsgTxt("fibertypes must be 1 (LSR), 2 (MSR) or 3 (HSR).\n");
+        count = counts[(ncount==1) ? 0 : k];
+        if (count < 0 || count != floor(count))
+            mexErrMsgTxt("counts must be non-negative integers.\n");
+        nfiber += (int) count;
+    }
+    if (nfiber < 1)
+        mexErrMsgTxt("The bundle must contain at least one fiber.\n");
+    if (implnt!=0 && implnt!=1 && implnt!=2)
+        mexErrMsgTxt("implnt must be 0, 1 or 2.\n");
+    if (opts.indepreps)
+        mexErrMsgTxt("model_AN_bundle does not support opts.independent_reps.\n");
+
+    /* The type of each fiber */
+    fibertypes = (double*)mxCalloc(nfiber,sizeof(double));
+    for (k=0, f=0; k<ntype; k++)
+        for (i=0; i<(int) counts[(ncount==1) ? 0 : k]; i++)
+            fibertypes[f++] = types[k];
+
+    /* Calculate number of samples for total repetition time and allocate */
+    totalstim = (int)floor(pxbins/nrep);
+    px = (double*)mxCalloc(totalstim*nrep,sizeof(double));
+    for (i=0; i<totalstim*nrep; i++)
+        px[i] = pxtmp[i];
+
+    /* Run the bundle into fiber-major buffers, then copy them to the fiber x time outputs */
+    meanrate = (double*)mxCalloc(3*(size_t)nfiber*totalstim,sizeof(double));
+    varrate  = meanrate + (size_t)nfiber*totalstim;
+    psth     = varrate + (size_t)nfiber*totalstim;
+    if (BundleAN(px, cf, nrep, tdres, totalstim, nfiber, fibertypes, noiseType, implnt, &opts,
+                 meanrate, varrate, psth, &errmsg))
+        mexErrMsgTxt(errmsg);
+
+    outsize[0] = nfiber;
+    outsize[1] = totalstim;
+    for (k=0; k<3; k++)
+    {
+        double *src = meanrate + (size_t)k*nfiber*totalstim, *dst;
+
+        plhs[k] = mxCreateNumericArray(2, outsize, mxDOUBLE_CLASS, mxREAL);
+        dst = mxGetPr(plhs[k]);
+        for (f=0; f<nfiber; f++)
+            for (i=0; i<totalstim; i++)
+                dst[f + (size_t)i*nfiber] = src[(size_t)f*totalstim + i];
+    }
+    mxFree(meanrate);
+    mxFree(fibertypes);
+    mxFree(px);
+}
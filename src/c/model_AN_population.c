@@ -0,0 +1,261 @@
+/* Population (multi-CF) entry point for the auditory-periphery model of:
+ *
+ * Zilany, M. S., Bruce, I. C., & Carney, L. H. (2014). Updated parameters and expanded
+ * simulation options for a model of the auditory periphery. The Journal of the Acoustical
+ * Society of America, 135(1), 283-286.
+ *
+ * with the power-law adaptation approximation of:
+ *
+ * Guest, D. R., & Carney, L. H. (2024). A fast and accurate approximation of power-law
+ * adaptation for auditory computational models. The Journal of the Acoustical Society of
+ * America, 156(6), 3954-3957.
+ *
+ * Computing a neurogram used to mean one call to model_IHC and one to model_Synapse_v2025a
+ * per CF.  model_AN_population takes one stimulus and a vector of CFs (and fiber types) and
+ * returns CF x time matrices of mean rate, rate variance and PSTH.  The middle-ear filter,
+ * which does not depend on CF, runs once, and its output feeds every channel.  Channels
+ * are processed in groups of AN_LANES: the IHC stage of a group runs one channel per vector
+ * lane (see ihc_filterbank.c), followed by the synapse and spike generator of each channel,
+ * and the groups run concurrently on a pool of worker threads (see thread_pool.c).  The random
+ * streams of channel c use fiber id opts.fiber_id+c (see rng.hpp), so with a given
+ * opts.seed the output does not depend on the number of threads.  With opts.precision =
+ * 'single' the IHC filters run in single precision, AN_SLANES channels per group (see
+ * IHCAN_bank_single and check_single_precision.m).
+ *
+ * Usage (all rates in /s, time in s):
+ *
+ *   [meanrate, varrate, psth] = model_AN_population(px, cfs, nrep, tdres, reptime, cohc,
+ *       cihc, species, fibertypes, noiseType, implnt[, nthreads][, opts])
+ *
+ * px, nrep, tdres, reptime, cohc, cihc and species are as for model_IHC; fibertypes,
+ * implnt and opts are as for model_Synapse_v2025a, except that fibertypes can be a vector
+ * with one entry per CF.  nthreads defaults to the number of processors.
+ *
+ * With opts.neurogram the outputs go to that file instead (see neurogram.hpp): each worker
+ * stores its channels straight into the memory-mapped file, so the neurogram need not fit in
+ * memory, and the three outputs are [] (they may be omitted).  Read the file with
+ * read_neurogram.m.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <mex.h>
+
+#include "model_IHC.hpp"
+#include "ihc_filterbank.hpp"
+#include "model_Synapse_v2025a.hpp"
+#include "thread_pool.hpp"
+#include "resample.hpp"
+#include "fft.hpp"
+#include "ffgn.hpp"
+#include "mex_options.hpp"
+#include "neurogram.hpp"
+
+/* Everything a worker needs to run a group of channels */
+typedef struct {
+    double *meout, *cfs, *fibertypes, tdres, cohc, cihc, noiseType, implnt;  /* meout: middle-ear output */
+    int nrep, totalstim, species, ncf, nfib;
+    int lanes;                          /* channels per group: AN_LANES, or AN_SLANES if single */
+    const SYNOPTS *opts;
+    double *meanrate, *varrate, *psth;  /* ncf x totalstim outputs */
+    NEUROGRAM *ng;                      /* or, if not NULL, the file they go to */
+    const char **errmsg;                /* one error message (or NULL) per group */
+} POPJOB;
+
+/* Task g runs channels g*lanes ... g*lanes+lanes-1 from IHC to spikes */
+static void population_task(void *arg, int task)
+{
+    POPJOB *job = (POPJOB *) arg;
+    double *ihcout[AN_SLANES], *chmean, *chvar, *chpsth;
+    SYNOPTS opts = *job->opts;
+    int first = task*job->lanes, n = job->ncf - first, b, c, t, err;
+
+    if (n > job->lanes) n = job->lanes;
+    opts.nthreads = 1;  /* the channels already keep every thread busy */
+    job->errmsg[task] = NULL;
+    chmean = (double*)calloc(3*(size_t)job->totalstim,sizeof(double));
+    for (b=0; b<n; b++)
+        if ((ihcout[b] = (double*)calloc(job->totalstim,sizeof(double))) == NULL)
+            job->errmsg[task] = "model_AN_population: out of memory.\n";
+    if (!chmean)
+        job->errmsg[task] = "model_AN_population: out of memory.\n";
+    if (job->errmsg[task])
+        goto cleanup;
+    chvar  = chmean + job->totalstim;
+    chpsth = chvar + job->totalstim;
+
+    /*====== IHC stage: one channel per vector lane, one period each ======*/
+    if (job->opts->single)
+        err = IHCAN_bank_single(job->meout, job->cfs+first, n, 0, job->tdres, job->totalstim,
+                                job->cohc, job->cihc, job->species, ihcout, &job->errmsg[task]);
+    else
+        err = IHCAN_bank(job->meout, job->cfs+first, n, 0, job->tdres, job->totalstim,
+                         job->cohc, job->cihc, job->species, ihcout, &job->errmsg[task]);
+    if (err)
+        goto cleanup;
+
+    /*====== Synapse and spike generator stage ======*/
+    for (b=0; b<n; b++)
+    {
+        c = first + b;
+        opts.fiber = job->opts->fiber + (uint32_t) c;
+        memset(chmean, 0, 3*(size_t)job->totalstim*sizeof(double));
+        if (SingleAN_periodic(ihcout[b], IHCAN_delaypoint(job->cfs[c], job->tdres), job->cfs[c],
+                              job->nrep, job->tdres, job->totalstim, job->fibertypes[(job->nfib==1) ? 0 : c],
+                              job->noiseType, job->implnt, &opts, chmean, chvar, chpsth, NULL,
+                              &job->errmsg[task]))
+            goto cleanup;
+        if (job->ng)
+        {
+            neurogram_write(job->ng, NG_MEANRATE, c, chmean);
+            neurogram_write(job->ng, NG_VARRATE, c, chvar);
+            neurogram_write(job->ng, NG_PSTH, c, chpsth);
+        }
+        else for (t=0; t<job->totalstim; t++)
+        {
+            job->meanrate[c + (size_t)t*job->ncf] = chmean[t];
+            job->varrate[c + (size_t)t*job->ncf]  = chvar[t];
+            job->psth[c + (size_t)t*job->ncf]     = chpsth[t];
+        }
+    }
+
+cleanup:
+    for (b=0; b<n; b++)
+        free(ihcout[b]);
+    free(chmean);
+}
+
+/* Release the filter designs, FFT plans, noise spectra and PLA parameter files cached by the
+   native code, and stop the parked worker threads */
+static void clear_caches(void)
+{
+    resample_clear_cache();
+    ffGn_clear_cache();
+    fft_clear_cache();
+    pla_params_clear_cache();
+    tpool_shutdown();
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+    double *pxtmp, *px, *meout, *cfs, *fibertypes;
+    double tdres, reptime, cohc, cihc, noiseType, implnt;
+    int    pxbins, ncf, nfib, nrep, species, totalstim, nthreads, ngroup;
+    int    c, g, i;
+    mwSize outsize[2];
+    POPJOB job;
+    NEUROGRAM ng;
+    SYNOPTS opts;
+    int    nargs;
+
+    /* A trailing struct argument is opts, anything before it is nthreads */
+    nargs = (nrhs > 11 && mxIsStruct(prhs[nrhs-1])) ? nrhs-1 : nrhs;
+    if (nargs != 11 && nargs != 12)
+        mexErrMsgTxt("model_AN_population requires 11 or 12 input arguments (plus an optional opts struct).");
+
+    /* Assign pointers to the inputs and check them */
+    pxtmp      = mxGetPr(prhs[0]);
+    pxbins     = (int) mxGetN(prhs[0]);
+    cfs        = mxGetPr(prhs[1]);
+    ncf        = (int) mxGetNumberOfElements(prhs[1]);
+    nrep       = (int) mxGetPr(prhs[2])[0];
+    tdres      = mxGetPr(prhs[3])[0];
+    reptime    = mxGetPr(prhs[4])[0];
+    cohc       = mxGetPr(prhs[5])[0];
+    cihc       = mxGetPr(prhs[6])[0];
+    species    = (int) mxGetPr(prhs[7])[0];
+    fibertypes = mxGetPr(prhs[8]);
+    nfib       = (int) mxGetNumberOfElements(prhs[8]);
+    noiseType  = mxGetPr(prhs[9])[0];
+    implnt     = mxGetPr(prhs[10])[0];
+    nthreads   = (nargs > 11) ? (int) mxGetPr(prhs[11])[0] : tpool_nthreads_default();
+    get_synapse_options((nargs < nrhs) ? prhs[nrhs-1] : NULL, &opts);
+    mexAtExit(clear_caches);
+    if (opts.neurogram ? nlhs > 3 : nlhs != 3)
+        mexErrMsgTxt("model_AN_population requires 3 output arguments (up to 3 with opts.neurogram).");
+
+    if (pxbins==1)
+        mexErrMsgTxt("px must be a row vector\n");
+    if (ncf < 1)
+        mexErrMsgTxt("cfs must contain at least one CF.\n");
+    if (species<1 || species>3)
+        mexErrMsgTxt("Species must be 1 for cat, or 2 or 3 for human.\n");
+    for (c=0; c<ncf; c++)
+    {
+        if ((cfs[c]<124.9) | (cfs[c]>((species==1) ? 40.1e3 : 20.1e3)))
+        {
+            mexPrintf("cf (= %1.1f Hz) must be between 125 Hz and %s kHz for %s model\n",
+                      cfs[c], (species==1) ? "40" : "20", (species==1) ? "cat" : "human");
+            mexErrMsgTxt("\n");
+        }
+    }
+    if (nrep<1)
+        mexErrMsgTxt("nrep must be greater that 0.\n");
+    if (reptime<pxbins*tdres)
+        mexErrMsgTxt("reptime should be equal to or longer than the stimulus duration.\n");
+    if ((cohc<0)|(cohc>1))
+        mexErrMsgTxt("cohc must be between 0 and 1\n");
+    if ((cihc<0)|(cihc>1))
+        mexErrMsgTxt("cihc must be between 0 and 1\n");
+    if (nfib != 1 && nfib != ncf)
+        mexErrMsgTxt("fibertypes must be a scalar or have one entry per CF.\n");
+    for (i=0; i<nfib; i++)
+        if (fibertypes[i]!=1 && fibertypes[i]!=2 && fibertypes[i]!=3)
+            mexErrMsgTxt("fibertypes must be 1 (LSR), 2 (MSR) or 3 (HSR).\n");
+    if (implnt!=0 && implnt!=1 && implnt!=2)
+        mexErrMsgTxt("implnt must be 0, 1 or 2.\n");
+    if (nthreads < 1) nthreads = 1;
+
+    /* Put stimulus waveform into a pressure waveform of one full repetition period */
+    totalstim = (int)floor(reptime/tdres+0.5);
+    px = (double*)mxCalloc(totalstim,sizeof(double));
+    for (i=0; i<pxbins; i++)
+        px[i] = pxtmp[i];
+
+    /* The middle ear is the same for every CF: filter the stimulus once for all channels */
+    meout = (double*)mxCalloc(totalstim,sizeof(double));
+    IHCAN_middle_ear(px, tdres, totalstim, species, meout);
+
+    /* Create the CF x time return arguments, or the file that takes their place */
+    outsize[0] = opts.neurogram ? 0 : ncf;
+    outsize[1] = opts.neurogram ? 0 : totalstim;
+    for (i=0; i<nlhs; i++)
+        plhs[i] = mxCreateNumericArray(2, outsize, mxDOUBLE_CLASS, mxREAL);
+    if (opts.neurogram && neurogram_create(opts.neurogram, cfs, fibertypes, nfib, ncf, totalstim,
+                                           1/tdres, nrep, species, implnt, &ng))
+    {
+        mexPrintf("Cannot create %s\n", opts.neurogram);
+        mexErrMsgTxt("\n");
+    }
+
+    job.meout = meout; job.cfs = cfs; job.fibertypes = fibertypes; job.tdres = tdres;
+    job.cohc = cohc; job.cihc = cihc; job.noiseType = noiseType; job.implnt = implnt;
+    job.nrep = nrep; job.totalstim = totalstim;
+    job.species = species; job.ncf = ncf; job.nfib = nfib;
+    job.opts = &opts;
+    job.lanes = opts.single ? AN_SLANES : AN_LANES;
+    job.ng       = opts.neurogram ? &ng : NULL;
+    job.meanrate = job.ng ? NULL : mxGetPr(plhs[0]);
+    job.varrate  = job.ng ? NULL : mxGetPr(plhs[1]);
+    job.psth     = job.ng ? NULL : mxGetPr(plhs[2]);
+
+    /* One task per group of channels; each task holds one period of the IHC outputs of
+       its group only, so memory use scales with the number of threads, not of CFs or
+       repetitions */
+    ngroup = (ncf+job.lanes-1)/job.lanes;
+    job.errmsg = (const char**)mxCalloc(ngroup,sizeof(const char*));
+    tpool_run(nthreads, ngroup, population_task, &job);
+    if (job.ng && neurogram_close(job.ng))
+    {
+        mexPrintf("Could not finish writing %s\n", opts.neurogram);
+        mexErrMsgTxt("\n");
+    }
+    for (g=0; g<ngroup; g++)
+        if (job.errmsg[g]) mexErrMsgTxt(job.errmsg[g]);
+
+    mxFree(job.errmsg);
+    mxFree(meout);
+    mxFree(px);
+}
@@ -0,0 +1,236 @@
+/* Rate-level entry point for the auditory-periphery model of:
+ *
+ * Zilany, M. S., Bruce, I. C., & Carney, L. H. (2014). Updated parameters and expanded
+ * simulation options for a model of the auditory periphery. The Journal of the Acoustical
+ * Society of America, 135(1), 283-286.
+ *
+ * with the power-law adaptation approximation of:
+ *
+ * Guest, D. R., & Carney, L. H. (2024). A fast and accurate approximation of power-law
+ * adaptation for auditory computational models. The Journal of the Acoustical Society of
+ * America, 156(6), 3954-3957.
+ *
+ * A rate-level function used to mean rescaling the stimulus to each level and calling
+ * model_IHC and model_Synapse_v2025a once per level.  The middle-ear filter is linear, so
+ * model_AN_ratelevel filters the stimulus once and scales its output to each level; the
+ * nonlinear stages (the rest of the IHC, the synapse and the spike generator) run once per
+ * level, the levels concurrently on a pool of worker threads (see thread_pool.c).  Every
+ * level uses the random streams of opts.fiber_id, as a call of model_Synapse_v2025a with the
+ * same opts would, so with a given opts.seed the output does not depend on the number of
+ * threads.  It equals that of scaling px to the level first up to rounding in the middle ear.
+ *
+ * Usage (all rates in /s, time in s):
+ *
+ *   [rates, meanrate, varrate, psth] = model_AN_ratelevel(px, levels, cf, nrep, tdres,
+ *       reptime, cohc, cihc, species, fibertype, noiseType, implnt[, opts])
+ *
+ * px, cf, nrep, tdres, reptime, cohc, cihc and species are as for model_IHC, and fibertype,
+ * noiseType, implnt and opts as for model_Synapse_v2025a.  px is scaled to each of the
+ * levels (dB SPL, the rms of px re 20 uPa).  rates (nlevel x 1) is the rate-level function:
+ * the mean rate averaged over the stimulus (the first length(px) samples of the response).
+ * The optional meanrate, varrate and psth are nlevel x totalstim, one row per level; if they
+ * are not asked for, only the rates are kept.  The levels run on opts.nthreads threads
+ * (default: one per processor).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <mex.h>
+
+#include "model_IHC.hpp"
+#include "model_Synapse_v2025a.hpp"
+#include "thread_pool.hpp"
+#include "resample.hpp"
+#include "fft.hpp"
+#include "ffgn.hpp"
+#include "mex_options.hpp"
+
+/* Everything a worker needs to run one level */
+typedef struct {
+    double *meout, *gain, cf, tdres, cohc, cihc, fibertype, noiseType, implnt;  /* meout: middle-ear output of px */
+    int nrep, totalstim, pxbins, species, nlevel;
+    const SYNOPTS *opts;
+    double *rates;                      /* nlevel rate-level function */
+    double *meanrate, *varrate, *psth;  /* nlevel x totalstim outputs, or NULL */
+    const char **errmsg;                /* one error message (or NULL) per level */
+} LEVELJOB;
+
+/* Task l runs level l from the scaled middle-ear output to spikes */
+static void level_task(void *arg, int task)
+{
+    LEVELJOB *job = (LEVELJOB *) arg;
+    double *me, *ihcout, *chmean, *chvar, *chpsth, sum;
+    SYNOPTS opts = *job->opts;
+    IHCSTATE state;
+    int t;
+
+    opts.nthreads = 1;  /* the levels already keep every thread busy */
+    job->errmsg[task] = NULL;
+    me     = (double*)calloc(job->totalstim,sizeof(double));
+    ihcout = (double*)calloc(job->totalstim,sizeof(double));
+    chmean = (double*)calloc(3*(size_t)job->totalstim,sizeof(double));
+    if (!me || !ihcout || !chmean)
+    {
+        job->errmsg[task] = "model_AN_ratelevel: out of memory.\n";
+        goto cleanup;
+    }
+    chvar  = chmean + job->totalstim;
+    chpsth = chvar + job->totalstim;
+
+    for (t=0; t<job->totalstim; t++)
+        me[t] = job->gain[task]*job->meout[t];
+    if (IHCAN_period(me, job->cf, job->tdres, job->totalstim, job->cohc, job->cihc, job->species,
+                     &state, ihcout, NULL))
+    {
+        job->errmsg[task] = state.errmsg;
+        goto cleanup;
+    }
+    if (SingleAN_periodic(ihcout, IHCAN_delaypoint(job->cf, job->tdres), job->cf, job->nrep, job->tdres,
+                          job->totalstim, job->fibertype, job->noiseType, job->implnt, &opts,
+                          chmean, chvar, chpsth, NULL, &job->errmsg[task]))
+        goto cleanup;
+
+    for (sum=0, t=0; t<job->pxbins; t++)
+        sum += chmean[t];
+    job->rates[task] = sum/job->pxbins;
+    if (job->meanrate)
+        for (t=0; t<job->totalstim; t++)
+        {
+            job->meanrate[task + (size_t)t*job->nlevel] = chmean[t];
+            job->varrate[task + (size_t)t*job->nlevel]  = chvar[t];
+            job->psth[task + (size_t)t*job->nlevel]     = chpsth[t];
+        }
+
+cleanup:
+    free(me);
+    free(ihcout);
+    free(chmean);
+}
+
+/* Release the filter designs, FFT plans, noise spectra and PLA parameter files cached by the
+   native code, and stop the parked worker threads */
+static void clear_caches(void)
+{
+    resample_clear_cache();
+    ffGn_clear_cache();
+    fft_clear_cache();
+    pla_params_clear_cache();
+    tpool_shutdown();
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+    double *pxtmp, *px, *meout, *levels, *gain;
+    double cf, tdres, reptime, cohc, cihc, fibertype, noiseType, implnt, rms;
+    int    pxbins, nlevel, nrep, species, totalstim, nthreads;
+    int    l, i;
+    mwSize outsize[2];
+    LEVELJOB job;
+    SYNOPTS opts;
+
+    if (nrhs != 12 && nrhs != 13)
+        mexErrMsgTxt("model_AN_ratelevel requires 12 input arguments (plus an optional opts struct).");
+    if (nlhs < 1 || nlhs > 4)
+        mexErrMsgTxt("model_AN_ratelevel requires 1 to 4 output arguments.");
+
+    /* Assign pointers to the inputs and check them */
+    pxtmp     = mxGetPr(prhs[0]);
+    pxbins    = (int) mxGetN(prhs[0]);
+    levels    = mxGetPr(prhs[1]);
+    nlevel    = (int) mxGetNumberOfElements(prhs[1]);
+    cf        = mxGetPr(prhs[2])[0];
+    nrep      = (int) mxGetPr(prhs[3])[0];
+    tdres     = mxGetPr(prhs[4])[0];
+    reptime   = mxGetPr(prhs[5])[0];
+    cohc      = mxGetPr(prhs[6])[0];
+    cihc      = mxGetPr(prhs[7])[0];
+    species   = (int) mxGetPr(prhs[8])[0];
+    fibertype = mxGetPr(prhs[9])[0];
+    noiseType = mxGetPr(prhs[10])[0];
+    implnt    = mxGetPr(prhs[11])[0];
+    get_synapse_options((nrhs > 12) ? prhs[12] : NULL, &opts);
+    mexAtExit(clear_caches);
+
+    if (pxbins==1)
+        mexErrMsgTxt("px must be a row vector\n");
+    if (nlevel < 1)
+        mexErrMsgTxt("levels must contain at least one level.\n");
+    if (species<1 || species>3)
+        mexErrMsgTxt("Species must be 1 for cat, or 2 or 3 for human.\n");
+    if ((cf<124.9) | (cf>((species==1) ? 40.1e3 : 20.1e3)))
+    {
+        mexPrintf("cf (= %1.1f Hz) must be between 125 Hz and %s kHz for %s model\n",
+                  cf, (species==1) ? "40" : "20", (species==1) ? "cat" : "human");
+        mexErrMsgTxt("\n");
+    }
+    if (nrep<1)
+        mexErrMsgTxt("nrep must be greater that 0.\n");
+    if (reptime<pxbins*tdres)
+        mexErrMsgTxt("reptime should be equal to or longer than the stimulus duration.\n");
+    if ((cohc<0)|(cohc>1))
+        mexErrMsgTxt("cohc must be between 0 and 1\n");
+    if ((cihc<0)|(cihc>1))
+        mexErrMsgTxt("cihc must be between 0 and 1\n");
+    if (fibertype!=1 && fibertype!=2 && fibertype!=3)
+        mexErrMsgTxt("fibertype must be 1 (LSR), 2 (MSR) or 3 (HSR).\n");
+    if (implnt!=0 && implnt!=1 && implnt!=2)
+        mexErrMsgTxt("implnt must be 0, 1 or 2.\n");
+
+    /* Put stimulus waveform into a pressure waveform of one full repetition period */
+    totalstim = (int)floor(reptime/tdres+0.5);
+    px = (double*)mxCalloc(totalstim,sizeof(double));
+    for (rms=0, i=0; i<pxbins; i++)
+    {
+        px[i] = pxtmp[i];
+        rms  += px[i]*px[i];
+    }
+    rms = sqrt(rms/pxbins);
+    if (rms == 0)
+        mexErrMsgTxt("px must not be silent.\n");
+
+    /* The middle ear is linear: filter the stimulus once and scale its output to each level */
+    meout = (double*)mxCalloc(totalstim,sizeof(double));
+    IHCAN_middle_ear(px, tdres, totalstim, species, meout);
+    gain = (double*)mxCalloc(nlevel,sizeof(double));
+    for (l=0; l<nlevel; l++)
+        gain[l] = 20e-6*pow(10,levels[l]/20)/rms;
+
+    /* Create the return arguments: the rate-level function, and the level x time outputs if asked for */
+    plhs[0] = mxCreateDoubleMatrix(nlevel, 1, mxREAL);
+    outsize[0] = nlevel;
+    outsize[1] = totalstim;
+    for (i=1; i<4; i++)
+        if (i < nlhs) plhs[i] = mxCreateNumericArray(2, outsize, mxDOUBLE_CLASS, mxREAL);
+
+    job.meout = meout; job.gain = gain; job.cf = cf; job.tdres = tdres;
+    job.cohc = cohc; job.cihc = cihc; job.fibertype = fibertype;
+    job.noiseType = noiseType; job.implnt = implnt;
+    job.nrep = nrep; job.totalstim = totalstim; job.pxbins = pxbins;
+    job.species = species; job.nlevel = nlevel;
+    job.opts = &opts;
+    job.rates = mxGetPr(plhs[0]);
+    /* Rows of outputs that were not asked for go to a scratch array, as long as any are */
+    job.meanrate = job.varrate = job.psth = NULL;
+    if (nlhs > 1)
+    {
+        double *scratch = (nlhs < 4) ? (double*)mxCalloc((size_t)nlevel*totalstim,sizeof(double)) : NULL;
+        job.meanrate = mxGetPr(plhs[1]);
+        job.varrate  = (nlhs > 2) ? mxGetPr(plhs[2]) : scratch;
+        job.psth     = (nlhs > 3) ? mxGetPr(plhs[3]) : scratch;
+    }
+
+    nthreads = (opts.nthreads > 0) ? opts.nthreads : tpool_nthreads_default();
+    job.errmsg = (const char**)mxCalloc(nlevel,sizeof(const char*));
+    tpool_run((nthreads < nlevel) ? nthreads : nlevel, nlevel, level_task, &job);
+    for (l=0; l<nlevel; l++)
+        if (job.errmsg[l]) mexErrMsgTxt(job.errmsg[l]);
+
+    if (nlhs > 1 && nlhs < 4)
+        mxFree((nlhs > 2) ? job.psth : job.varrate);
+    mxFree(job.errmsg);
+    mxFree(gain);
+    mxFree(meout);
+    mxFree(px);
+}
@@ -0,0 +1,387 @@
+/* Streaming (block-by-block) entry point for the auditory-periphery model of:
+ *
+ * Zilany, M. S., Bruce, I. C., & Carney, L. H. (2014). Updated parameters and expanded
+ * simulation options for a model of the auditory periphery. The Journal of the Acoustical
+ * Society of America, 135(1), 283-286.
+ *
+ * with the power-law adaptation approximation of:
+ *
+ * Guest, D. R., & Carney, L. H. (2024). A fast and accurate approximation of power-law
+ * adaptation for auditory computational models. The Journal of the Acoustical Society of
+ * America, 156(6), 3954-3957.
+ *
+ * model_IHC and model_Synapse_v2025a need the whole stimulus at once, and the synapse stage
+ * allocates many buffers of its length, so hour-long stimuli do not fit in memory.
+ * model_AN_stream runs one fiber from sound pressure to spikes on a stimulus that is pushed
+ * through it in blocks of any size, with memory that does not grow with the stimulus
+ * (except for the synapse's fGn, see Synapse_stream_open).  Concatenating the outputs of
+ * all 'process' calls and of 'close' gives exactly the outputs of model_IHC followed by
+ * model_Synapse_v2025a with nrep = 1 and the same seed.
+ *
+ * Usage (all rates in /s, time in s):
+ *
+ *   h = model_AN_stream('open', cf, tdres, reptime, cohc, cihc, species, fibertype,
+ *                       noiseType, implnt[, opts])
+ *   [meanrate, varrate, psth] = model_AN_stream('process', h, px)
+ *   [meanrate, varrate, psth] = model_AN_stream('close', h)
+ *
+ * reptime is the total duration of the stimulus; 'close' pads what has not been pushed
+ * with zeros, as model_IHC does.  The outputs of 'process' are the samples that have become
+ * final, at most as many as px has: they lag the input by a few ms, which 'close' returns.
+ * opts is as for model_Synapse_v2025a; with opts.ntrials > 1, psth counts the spikes of
+ * all trials.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <mex.h>
+
+#include "model_IHC.hpp"
+#include "model_Synapse_v2025a.hpp"
+#include "resample.hpp"
+#include "fft.hpp"
+#include "ffgn.hpp"
+#include "thread_pool.hpp"
+#include "mex_options.hpp"
+
+/* Samples processed per stage at a time, which bounds the scratch buffers */
+#define AN_STREAM_CHUNK 4096
+/* Open streams per MATLAB session */
+#define AN_MAX_STREAMS  1024
+
+typedef struct {
+    IHCSTREAM  ihc;
+    SYNSTREAM  *syn;
+    double     tdres;
+    int        totalstim;
+    int        nin;       /* stimulus samples pushed */
+    int        nsyn;      /* synapse output samples received */
+    int        nout;      /* output samples returned */
+    int        ntrials;
+    SPIKESTATE *spk;      /* one spike generator per trial */
+    RNG        *rng;
+    double     *ihcbuf, *synbuf;
+    /* Outputs not yet returned, rings indexed by sample number.  The PSTH of a sample is
+       final once no spike generator can still place a spike in it. */
+    double     *rate, *var, *psth;
+    int        cap;
+} ANSTREAM;
+
+static ANSTREAM *streams[AN_MAX_STREAMS];
+
+static void stream_free(ANSTREAM *s)
+{
+    if (s == NULL) return;
+    IHCAN_stream_close(&s->ihc);
+    Synapse_stream_close(s->syn);
+    free(s->spk); free(s->rng); free(s->ihcbuf); free(s->synbuf);
+    free(s->rate); free(s->var); free(s->psth);
+    free(s);
+}
+
+/* Release all streams, the caches of the native code and the parked worker threads */
+static void clear_streams(void)
+{
+    int i;
+
+    for (i=0; i<AN_MAX_STREAMS; i++)
+    {
+        stream_free(streams[i]);
+        streams[i] = NULL;
+    }
+    resample_clear_cache();
+    ffGn_clear_cache();
+    fft_clear_cache();
+    pla_params_clear_cache();
+    tpool_shutdown();
+}
+
+/* Make room in the rings for sample number idx.  The rings outlive this MEX call, so they
+   are owned by the C heap; if the larger ones cannot be had, the old ones stay in place,
+   so that the handle is still usable after the error. */
+static void ring_reserve(ANSTREAM *s, int idx)
+{
+    double *r, *v, *p;
+    int    cap = s->cap, m;
+
+    if (idx - s->nout < s->cap) return;
+    while (idx - s->nout >= cap) cap *= 2;
+    r = (double*)calloc(cap,sizeof(double));
+    v = (double*)calloc(cap,sizeof(double));
+    p = (double*)calloc(cap,sizeof(double));
+    if (!r || !v || !p)
+    {
+        free(r); free(v); free(p);
+        mexErrMsgTxt("model_AN_stream: out of memory.\n");
+    }
+    for (m=s->nout; m<s->nout+s->cap; m++)
+    {
+        r[m % cap] = s->rate[m % s->cap];
+        v[m % cap] = s->var[m % s->cap];
+        p[m % cap] = s->psth[m % s->cap];
+    }
+    free(s->rate); free(s->var); free(s->psth);
+    s->rate = r; s->var = v; s->psth = p;
+    s->cap = cap;
+}
+
+/* Rates and spikes of n new synapse output samples */
+static void stream_spikes(ANSTREAM *s, const double *synout, int n)
+{
+    double m;
+    int    i, k, t, ipst;
+
+    for (i=0; i<n; i++)
+    {
+        ring_reserve(s, s->nsyn);  /* before counting the sample, in case it fails */
+        k = s->nsyn++;
+        /* Synapse Output taking into account the Refractory Effects, as in SingleAN */
+        m = synout[i];
+        s->var[k % s->cap]  = m/pow((1+0.75e-3*m),3);
+        s->rate[k % s->cap] = m/(1+0.75e-3*m);
+
+        for (t=0; t<s->ntrials; t++)
+        {
+            if (k == 0)
+                SpikeGenerator_init(&s->spk[t], synout[i], s->tdres, s->totalstim * s->tdres * 1, &s->rng[t]);
+            if (SpikeGenerator_step(&s->spk[t], synout[i]))
+            {
+                ipst = (int) (fmod(s->spk[t].sptime,s->tdres*s->totalstim) / s->tdres);
+                ring_reserve(s, ipst);
+                s->psth[ipst % s->cap] += 1;
+            }
+        }
+    }
+}
+
+/* Number of leading samples whose outputs are final; all of them once the stream is done */
+static int stream_final(const ANSTREAM *s, int done)
+{
+    int t, nfinal = s->nsyn, bin;
+
+    if (done) return s->nsyn;
+    for (t=0; t<s->ntrials && s->nsyn>0; t++)
+        if (!s->spk[t].done)
+        {
+            /* later spikes fall at or after the generator's current time */
+            bin = (int) (s->spk[t].countTime / s->tdres);
+            if (bin < nfinal) nfinal = bin;
+        }
+    return (s->nsyn > 0) ? nfinal : 0;
+}
+
+/* Return the final samples, at most max of them, from the rings */
+static int stream_return(ANSTREAM *s, int done, int max, double *meanrate, double *varrate, double *psth)
+{
+    int nret = 0, slot, nfinal = stream_final(s, done);
+
+    while (s->nout < nfinal && nret < max)
+    {
+        slot = s->nout % s->cap;
+        meanrate[nret] = s->rate[slot];
+        varrate[nret]  = s->var[slot];
+        psth[nret]     = s->psth[slot];
+        s->psth[slot]  = 0;
+        s->nout++; nret++;
+    }
+    return nret;
+}
+
+/* Push n stimulus samples; returns the number of output samples written (at most n) */
+static int stream_process(ANSTREAM *s, const double *px, int n, double *meanrate, double *varrate, double *psth)
+{
+    int i, len, nsyn, nret = 0;
+
+    for (i=0; i<n; i+=len)
+    {
+        len = (n-i < AN_STREAM_CHUNK) ? n-i : AN_STREAM_CHUNK;
+        if (IHCAN_stream_process(&s->ihc, px+i, len, s->ihcbuf))
+            mexErrMsgTxt(s->ihc.st.errmsg);
+        nsyn = Synapse_stream_process(s->syn, s->ihcbuf, len, s->synbuf);
+        stream_spikes(s, s->synbuf, nsyn);
+        s->nin += len;
+        nret += stream_return(s, 0, n-nret, meanrate+nret, varrate+nret, psth+nret);
+    }
+    return nret;
+}
+
+static ANSTREAM *stream_open(int nrhs, const mxArray *prhs[])
+{
+    double cf, tdres, reptime, cohc, cihc, fibertype, noiseType, implnt, spont;
+    int    species, totalstim, t;
+    SYNOPTS opts;
+    ANSTREAM *s;
+    const char *errmsg;
+
+    if (nrhs != 10 && nrhs != 11)
+        mexErrMsgTxt("model_AN_stream('open', ...) requires 9 arguments (plus an optional opts struct).");
+    cf        = mxGetPr(prhs[1])[0];
+    tdres     = mxGetPr(prhs[2])[0];
+    reptime   = mxGetPr(prhs[3])[0];
+    cohc      = mxGetPr(prhs[4])[0];
+    cihc      = mxGetPr(prhs[5])[0];
+    species   = (int) mxGetPr(prhs[6])[0];
+    fibertype = mxGetPr(prhs[7])[0];
+    noiseType = mxGetPr(prhs[8])[0];
+    implnt    = mxGetPr(prhs[9])[0];
+    get_synapse_options((nrhs > 10) ? prhs[10] : NULL, &opts);
+
+    if (species<1 || species>3)
+        mexErrMsgTxt("Species must be 1 for cat, or 2 or 3 for human.\n");
+    if ((cf<124.9) | (cf>((species==1) ? 40.1e3 : 20.1e3)))
+    {
+        mexPrintf("cf (= %1.1f Hz) must be between 125 Hz and %s kHz for %s model\n",
+                  cf, (species==1) ? "40" : "20", (species==1) ? "cat" : "human");
+        mexErrMsgTxt("\n");
+    }
+    if (reptime<=0)
+        mexErrMsgTxt("reptime must be positive.\n");
+    if ((cohc<0)|(cohc>1))
+        mexErrMsgTxt("cohc must be between 0 and 1\n");
+    if ((cihc<0)|(cihc>1))
+        mexErrMsgTxt("cihc must be between 0 and 1\n");
+    if (fibertype!=1 && fibertype!=2 && fibertype!=3)
+        mexErrMsgTxt("fibertype must be 1 (LSR), 2 (MSR) or 3 (HSR).\n");
+    if (implnt!=0 && implnt!=1 && implnt!=2)
+        mexErrMsgTxt("implnt must be 0, 1 or 2.\n");
+
+    totalstim = (int)floor(reptime/tdres+0.5);
+    if (fibertype==1) spont = 0.1;
+    if (fibertype==2) spont = 4.0;
+    if (fibertype==3) spont = 100.0;
+
+    if ((s = (ANSTREAM*)calloc(1,sizeof(ANSTREAM))) == NULL)
+        mexErrMsgTxt("model_AN_stream: out of memory.\n");
+    s->tdres = tdres; s->totalstim = totalstim; s->ntrials = opts.ntrials;
+    s->cap = AN_STREAM_CHUNK;
+    if (IHCAN_stream_open(&s->ihc, cf, tdres, cohc, cihc, species))
+    {
+        stream_free(s);
+        mexErrMsgTxt("model_AN_stream: out of memory.\n");
+    }
+    s->syn    = Synapse_stream_open(tdres, cf, totalstim, spont, noiseType, implnt, &opts, &errmsg);
+    s->spk    = (SPIKESTATE*)calloc(s->ntrials,sizeof(SPIKESTATE));
+    s->rng    = (RNG*)calloc(s->ntrials,sizeof(RNG));
+    s->ihcbuf = (double*)calloc(AN_STREAM_CHUNK,sizeof(double));
+    s->synbuf = (double*)calloc(AN_STREAM_CHUNK,sizeof(double));
+    s->rate   = (double*)calloc(s->cap,sizeof(double));
+    s->var    = (double*)calloc(s->cap,sizeof(double));
+    s->psth   = (double*)calloc(s->cap,sizeof(double));
+    if (!s->syn || !s->spk || !s->rng || !s->ihcbuf || !s->synbuf || !s->rate || !s->var || !s->psth)
+    {
+        stream_free(s);
+        mexErrMsgTxt(errmsg ? errmsg : "model_AN_stream: out of memory.\n");
+    }
+    /* Trial t draws from the same spike stream as trial t of SingleAN */
+    for (t=0; t<s->ntrials; t++)
+        rng_init(&s->rng[t], opts.seed, RNG_STREAM_SPIKES, opts.fiber, (uint32_t) t);
+    return s;
+}
+
+/* Look up the stream of a handle argument */
+static int stream_slot(const mxArray *h)
+{
+    int slot;
+
+    if (!mxIsDouble(h) || mxGetNumberOfElements(h) != 1)
+        mexErrMsgTxt("model_AN_stream: invalid stream handle.\n");
+    slot = (int) mxGetPr(h)[0] - 1;
+    if (slot < 0 || slot >= AN_MAX_STREAMS || streams[slot] == NULL)
+        mexErrMsgTxt("model_AN_stream: invalid stream handle (closed already?).\n");
+    return slot;
+}
+
+static void create_outputs(int n, mxArray *plhs[], double **meanrate, double **varrate, double **psth)
+{
+    mwSize outsize[2];
+
+    outsize[0] = 1;
+    outsize[1] = n;
+    plhs[0] = mxCreateNumericArray(2, outsize, mxDOUBLE_CLASS, mxREAL);
+    plhs[1] = mxCreateNumericArray(2, outsize, mxDOUBLE_CLASS, mxREAL);
+    plhs[2] = mxCreateNumericArray(2, outsize, mxDOUBLE_CLASS, mxREAL);
+    *meanrate = mxGetPr(plhs[0]);
+    *varrate  = mxGetPr(plhs[1]);
+    *psth     = mxGetPr(plhs[2]);
+}
+
+/* Shrink the outputs to the samples actually returned */
+static void trim_outputs(int n, mxArray *plhs[])
+{
+    int k;
+
+    for (k=0; k<3; k++)
+        mxSetN(plhs[k], n);
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+    char     *cmd;
+    double   *meanrate, *varrate, *psth, *zeros, *tail;
+    int      slot, n, nret, nsyn, len;
+    ANSTREAM *s;
+
+    if (nrhs < 1 || !mxIsChar(prhs[0]))
+        mexErrMsgTxt("model_AN_stream: the first argument must be 'open', 'process' or 'close'.");
+    cmd = mxArrayToString(prhs[0]);
+    mexAtExit(clear_streams);
+
+    if (strcmp(cmd, "open") == 0)
+    {
+        mxFree(cmd);
+        for (slot=0; slot<AN_MAX_STREAMS && streams[slot]; slot++) ;
+        if (slot == AN_MAX_STREAMS)
+            mexErrMsgTxt("model_AN_stream: too many open streams.\n");
+        streams[slot] = stream_open(nrhs, prhs);
+        plhs[0] = mxCreateDoubleScalar(slot+1);
+    }
+    else if (strcmp(cmd, "process") == 0)
+    {
+        mxFree(cmd);
+        if (nrhs != 3 || nlhs != 3)
+            mexErrMsgTxt("model_AN_stream('process', h, px) requires 3 outputs.");
+        s = streams[stream_slot(prhs[1])];
+        n = (int) mxGetNumberOfElements(prhs[2]);
+        if (n > s->totalstim - s->nin)
+            mexErrMsgTxt("model_AN_stream: more samples pushed than reptime holds.\n");
+        create_outputs(n, plhs, &meanrate, &varrate, &psth);
+        nret = stream_process(s, mxGetPr(prhs[2]), n, meanrate, varrate, psth);
+        trim_outputs(nret, plhs);
+    }
+    else if (strcmp(cmd, "close") == 0)
+    {
+        mxFree(cmd);
+        if (nrhs != 2 || nlhs != 3)
+            mexErrMsgTxt("model_AN_stream('close', h) requires 3 outputs.");
+        slot = stream_slot(prhs[1]);
+        s = streams[slot];
+        create_outputs(s->totalstim - s->nout, plhs, &meanrate, &varrate, &psth);
+        nret = 0;
+
+        /* Pad the stimulus to reptime with zeros */
+        zeros = (double*)mxCalloc(AN_STREAM_CHUNK,sizeof(double));
+        while (s->nin < s->totalstim)
+        {
+            len = (s->totalstim - s->nin < AN_STREAM_CHUNK) ? s->totalstim - s->nin : AN_STREAM_CHUNK;
+            nret += stream_process(s, zeros, len, meanrate+nret, varrate+nret, psth+nret);
+        }
+        mxFree(zeros);
+
+        /* The synapse returns the samples it still holds, then everything is final */
+        tail = (double*)mxCalloc(s->totalstim - s->nsyn + 1,sizeof(double));
+        nsyn = Synapse_stream_finish(s->syn, tail);
+        stream_spikes(s, tail, nsyn);
+        mxFree(tail);
+        nret += stream_return(s, 1, s->totalstim, meanrate+nret, varrate+nret, psth+nret);
+
+        stream_free(s);
+        streams[slot] = NULL;
+    }
+    else
+    {
+        mxFree(cmd);
+        mexErrMsgTxt("model_AN_stream: the first argument must be 'open', 'process' or 'close'.");
+    }
+}
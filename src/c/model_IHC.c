@@ -35,13 +35,34 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>      /* Added for MS Visual C++ compatability, by Ian Bruce, 1999 */
+#ifndef AN_NO_MEXFUNCTION
 #include <mex.h>
+#endif
 #include <time.h>
 /* #include <iostream.h>  This file may be needed for some C compilers - Not needed for lcc */
 
 #include "complex.hpp"
+#include "model_IHC.hpp"
+#ifndef AN_NO_MEXFUNCTION
+#include "mex_profile.hpp"
+#include "ihc_cache.hpp"
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+static SRWLOCK plan_lock = SRWLOCK_INIT;
+#define PLAN_LOCK()   AcquireSRWLockExclusive(&plan_lock)
+#define PLAN_UNLOCK() ReleaseSRWLockExclusive(&plan_lock)
+#else
+#include <pthread.h>
+static pthread_mutex_t plan_lock = PTHREAD_MUTEX_INITIALIZER;
+#define PLAN_LOCK()   pthread_mutex_lock(&plan_lock)
+#define PLAN_UNLOCK() pthread_mutex_unlock(&plan_lock)
+#endif
 
 #define MAXSPIKES 1000000
+#define IHC_CHUNK 256   /* samples per stage pass of ihcan_block */
+#define PLAN_CACHE 256  /* channel plans kept by IHCAN_plan */
 #ifndef TWOPI
 #define TWOPI 6.28318530717959
 #endif
@@ -54,6 +75,11 @@
 #define __min(a,b) (((a) < (b))? (a): (b))
 #endif
 
+#ifndef AN_NO_MEXFUNCTION
+static void mex_ihcan_sweep(double *px, double cf, int nrep, double tdres, int totalstim, int nimp,
+                            const double *cohc, int ncohc, const double *cihc, int ncihc, int species,
+                            const char *cachedir, double *ihcout, ANPROF *prof);
+
 /* This function is the MEX "wrapper", to pass the input and output variables between the .dll or .mexglx file and Matlab */
 
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
@@ -66,19 +92,24 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 
 	double *pxtmp, *cftmp, *nreptmp, *tdrestmp, *reptimetmp, *cohctmp, *cihctmp, *speciestmp;
     double *ihcout;
-   
-	void   IHCAN(double *, double, int, double, int, double, double, int, double *);
+	IHCSTATE state;
+	ANPROF   prof;
+	char     *cachedir = NULL;
+	IHCKEY   key;
+	IHCMAP   map;
+	const double *cached = NULL;
+	int      k, ncohc, ncihc, nimp;
 	
 	/* Check for proper number of arguments */
 	
-	if (nrhs != 8) 
+	if (nrhs != 8 && nrhs != 9) 
 	{
-		mexErrMsgTxt("model_IHC requires 8 input arguments.");
+		mexErrMsgTxt("model_IHC requires 8 input arguments (plus an optional cache directory).");
 	}; 
 
-	if (nlhs !=1)  
+	if (nlhs !=1 && nlhs !=2)  
 	{
-		mexErrMsgTxt("model_IHC requires 1 output argument.");
+		mexErrMsgTxt("model_IHC requires 1 output argument (or 2, for the profile).");
 	};
 	
 	/* Assign pointers to the inputs */
@@ -135,20 +166,33 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 	if (reptime<pxbins*tdres)  /* duration of stimulus = pxbins*tdres */
 		mexErrMsgTxt("reptime should be equal to or longer than the stimulus duration.\n");
 
-    cohc = cohctmp[0]; /* impairment in the OHC  */
-	if ((cohc<0)|(cohc>1))
+	/* cohc and cihc may be vectors, for a sweep over the impairments (cohc(k), cihc(k)); a
+	   scalar pairs with every entry of the other */
+	ncohc = (int) mxGetNumberOfElements(prhs[5]);
+	ncihc = (int) mxGetNumberOfElements(prhs[6]);
+	nimp  = __max(ncohc,ncihc);
+	if (ncohc<1 || ncihc<1 || (ncohc>1 && ncihc>1 && ncohc!=ncihc))
+		mexErrMsgTxt("cohc and cihc must have the same number of elements, or one of them must be a scalar.\n");
+	for (k=0; k<ncohc; k++)
 	{
-		mexPrintf("cohc (= %1.1f) must be between 0 and 1\n",cohc);
-		mexErrMsgTxt("\n");
+		cohc = cohctmp[k]; /* impairment in the OHC  */
+		if ((cohc<0)|(cohc>1))
+		{
+			mexPrintf("cohc (= %1.1f) must be between 0 and 1\n",cohc);
+			mexErrMsgTxt("\n");
+		}
 	}
-
-	cihc = cihctmp[0]; /* impairment in the IHC  */
-	if ((cihc<0)|(cihc>1))
+	for (k=0; k<ncihc; k++)
 	{
-		mexPrintf("cihc (= %1.1f) must be between 0 and 1\n",cihc);
-		mexErrMsgTxt("\n");
+		cihc = cihctmp[k]; /* impairment in the IHC  */
+		if ((cihc<0)|(cihc>1))
+		{
+			mexPrintf("cihc (= %1.1f) must be between 0 and 1\n",cihc);
+			mexErrMsgTxt("\n");
+		}
 	}
-	
+	cohc = cohctmp[0];
+	cihc = cihctmp[0];
    
 	/* Calculate number of samples for total repetition time */
 
@@ -162,9 +206,9 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 	for (lp=0; lp<pxbins; lp++)
 			px[lp] = pxtmp[lp];
 	
-	/* Create an array for the return argument */
+	/* Create an array for the return argument: one row per impairment */
 	
-    outsize[0] = 1;
+    outsize[0] = nimp;
 	outsize[1] = totalstim*nrep;
     
 	plhs[0] = mxCreateNumericArray(2, outsize, mxDOUBLE_CLASS, mxREAL);
@@ -173,60 +217,211 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 	
 	ihcout  = mxGetPr(plhs[0]);
 		
-	/* run the model */
+	/* Optional ninth input: directory of the IHC output cache (see ihc_cache.hpp); '' for none */
+	if (nrhs > 8 && !mxIsEmpty(prhs[8]))
+	{
+		if (!mxIsChar(prhs[8]))
+			mexErrMsgTxt("The cache directory must be a character vector.\n");
+		cachedir = mxArrayToString(prhs[8]);
+	}
 
-	IHCAN(px,cf,nrep,tdres,totalstim,cohc,cihc,species,ihcout);
+	prof_clear(&prof);
+	if (nimp > 1)
+	{
+		mex_ihcan_sweep(px,cf,nrep,tdres,totalstim,nimp,cohctmp,ncohc,cihctmp,ncihc,species,
+		                cachedir,ihcout,nlhs>1 ? &prof : NULL);
+		mxFree(px);
+		mxFree(cachedir);
+		if (nlhs>1)
+			plhs[1] = mex_profile(&prof);
+		return;
+	}
+
+	/* run the model, unless its output is cached */
+
+	if (cachedir)
+	{
+		ihc_cache_key(px,cf,nrep,tdres,totalstim,cohc,cihc,species,&key);
+		cached = ihc_cache_map(cachedir,&key,(long long) totalstim*nrep,&map);
+	}
+	if (cached)
+	{
+		memcpy(ihcout,cached,(size_t) totalstim*nrep*sizeof(double));
+		ihc_cache_unmap(&map);
+	}
+	else
+	{
+		if (IHCAN(px,cf,nrep,tdres,totalstim,cohc,cihc,species,&state,ihcout,nlhs>1 ? &prof : NULL))
+		{
+			mxFree(px);
+			mexErrMsgTxt(state.errmsg);
+		}
+		if (cachedir && ihc_cache_store(cachedir,&key,ihcout,(long long) totalstim*nrep))
+			mexWarnMsgIdAndTxt("model_IHC:cache", "Could not write to the IHC cache directory %s.", cachedir);
+	}
 
  mxFree(px);
+ mxFree(cachedir);
+
+	/* Optional second output: the stage times (see mex_profile.hpp) */
+	if (nlhs>1)
+		plhs[1] = mex_profile(&prof);
 
 }
 
-void IHCAN(double *px, double cf, int nrep, double tdres, int totalstim,
-                double cohc, double cihc, int species, double *ihcout)
-{	
-    
-    /*variables for middle-ear model */
-	double megainmax;
-    double *mey1, *mey2, *mey3, meout,c1filterouttmp,c2filterouttmp,c1vihctmp,c2vihctmp;
-    double fp,C,m11,m12,m13,m14,m15,m16,m21,m22,m23,m24,m25,m26,m31,m32,m33,m34,m35,m36;
-
-	/*variables for the signal-path, control-path and onward */
-	double *ihcouttmp,*tmpgain;
-	int    grd;
-
-    double bmplace,centerfreq,gain,taubm,ratiowb,bmTaubm,fcohc,TauWBMax,TauWBMin,tauwb;
-    double Taumin[1],Taumax[1],bmTaumin[1],bmTaumax[1],ratiobm[1],lasttmpgain,wbgain,ohcasym,ihcasym,delay;
-	int    i,n,delaypoint,grdelay[1],bmorder,wborder;
-	double wbout1,wbout,ohcnonlinout,ohcout,tmptauc1,tauc1,rsigma,wb_gain;
-            
-    /* Declarations of the functions used in the program */
-	double C1ChirpFilt(double, double,double, int, double, double);
-	double C2ChirpFilt(double, double,double, int, double, double);
-    double WbGammaTone(double, double, double, int, double, double, int);
-
-    double Get_tauwb(double, int, int, double *, double *);
-	double Get_taubm(double, int, double, double *, double *, double *);
-    double gain_groupdelay(double, double, double, double, int *);
-    double delay_cat(double cf);
-    double delay_human(double cf);
-
-    double OhcLowPass(double, double, double, int, double, int);
-    double IhcLowPass(double, double, double, int, double, int);
-	double Boltzman(double, double, double, double, double);
-    double NLafterohc(double, double, double, double);
-	double ControlSignal(double, double, double, double, double);
-
-    double NLogarithm(double, double, double, double);
-    
-    /* Allocate dynamic memory for the temporary variables */
-	ihcouttmp  = (double*)mxCalloc(totalstim*nrep,sizeof(double));
-	    
-	mey1 = (double*)mxCalloc(totalstim,sizeof(double));
-	mey2 = (double*)mxCalloc(totalstim,sizeof(double));
-	mey3 = (double*)mxCalloc(totalstim,sizeof(double));
+/* The sweep of the MEX function: impairment k (cohc[k] and cihc[k], or the scalar one) to
+   row k of the nimp x (totalstim*nrep) ihcout.  Impairments found in the cache directory
+   (if not NULL) are copied from it; the rest run in one IHCAN_sweep and are stored in it. */
+static void mex_ihcan_sweep(double *px, double cf, int nrep, double tdres, int totalstim, int nimp,
+                            const double *cohc, int ncohc, const double *cihc, int ncihc, int species,
+                            const char *cachedir, double *ihcout, ANPROF *prof)
+{
+	double       *co, *ci, *rows, **row, *y;
+	const double *cached;
+	const char   *errmsg;
+	IHCKEY       key;
+	IHCMAP       map;
+	size_t       total = (size_t) totalstim*nrep, i;
+	int          k, nrun;
+
+	co   = (double*)mxCalloc(2*nimp,sizeof(double));
+	ci   = co + nimp;
+	row  = (double**)mxCalloc(nimp,sizeof(double*));
+	rows = (double*)mxCalloc(total*nimp,sizeof(double));
+	for (k=0, nrun=0; k<nimp; k++)
+	{
+		co[nrun] = cohc[(ncohc==1) ? 0 : k];
+		ci[nrun] = cihc[(ncihc==1) ? 0 : k];
+		cached = NULL;
+		if (cachedir)
+		{
+			ihc_cache_key(px,cf,nrep,tdres,totalstim,co[nrun],ci[nrun],species,&key);
+			cached = ihc_cache_map(cachedir,&key,(long long) total,&map);
+		}
+		if (cached)
+		{
+			for (i=0; i<total; i++)
+				ihcout[k + i*nimp] = cached[i];
+			ihc_cache_unmap(&map);
+		}
+		else
+			row[nrun++] = rows + (size_t) k*total;
+	}
+
+	if (nrun > 0 && IHCAN_sweep(px,cf,nrep,tdres,totalstim,nrun,co,ci,species,row,&errmsg,prof))
+	{
+		mxFree(px);
+		mexErrMsgTxt(errmsg);
+	}
+	for (k=0; k<nrun; k++)
+	{
+		y = row[k];
+		for (i=0; i<total; i++)
+			ihcout[(y - rows)/total + i*nimp] = y[i];
+		if (cachedir)
+		{
+			ihc_cache_key(px,cf,nrep,tdres,totalstim,co[k],ci[k],species,&key);
+			if (ihc_cache_store(cachedir,&key,y,(long long) total))
+				mexWarnMsgIdAndTxt("model_IHC:cache", "Could not write to the IHC cache directory %s.", cachedir);
+		}
+	}
+	mxFree(rows);
+	mxFree(row);
+	mxFree(co);
+}
+#endif
+
+/* Set up the middle-ear filter at sample 0; see MIDDLEEAR */
+void IHCAN_middle_ear_open(MIDDLEEAR *me, double tdres, int species)
+{
+    double fp, C;
+
+    memset(me, 0, sizeof(MIDDLEEAR));
+    me->species = species;
+    /* Prewarping and related constants for the middle ear */
+     fp = 1e3;  /* prewarping frequency 1 kHz */
+     C  = TWOPI*fp/tan(TWOPI/2*fp*tdres);
+     if (species==1) /* for cat */
+     {
+         /* Cat middle-ear filter - simplified version from Bruce et al. (JASA 2003) */
+         me->m11 = C/(C + 693.48);                    me->m12 = (693.48 - C)/C;            me->m13 = 0.0;
+         me->m14 = 1.0;                               me->m15 = -1.0;                      me->m16 = 0.0;
+         me->m21 = 1/(pow(C,2) + 11053*C + 1.163e8);  me->m22 = -2*pow(C,2) + 2.326e8;     me->m23 = pow(C,2) - 11053*C + 1.163e8; 
+         me->m24 = pow(C,2) + 1356.3*C + 7.4417e8;    me->m25 = -2*pow(C,2) + 14.8834e8;   me->m26 = pow(C,2) - 1356.3*C + 7.4417e8;
+         me->m31 = 1/(pow(C,2) + 4620*C + 909059944); me->m32 = -2*pow(C,2) + 2*909059944; me->m33 = pow(C,2) - 4620*C + 909059944;
+         me->m34 = 5.7585e5*C + 7.1665e7;             me->m35 = 14.333e7;                  me->m36 = 7.1665e7 - 5.7585e5*C;
+         me->megainmax=41.1405;
+     };
+     if (species>1) /* for human */
+     {
+         /* Human middle-ear filter - based on Pascal et al. (JASA 1998)  */
+         me->m11=1/(pow(C,2)+5.9761e+003*C+2.5255e+007);me->m12=(-2*pow(C,2)+2*2.5255e+007);me->m13=(pow(C,2)-5.9761e+003*C+2.5255e+007);me->m14=(pow(C,2)+5.6665e+003*C);             me->m15=-2*pow(C,2);					me->m16=(pow(C,2)-5.6665e+003*C);
+         me->m21=1/(pow(C,2)+6.4255e+003*C+1.3975e+008);me->m22=(-2*pow(C,2)+2*1.3975e+008);me->m23=(pow(C,2)-6.4255e+003*C+1.3975e+008);me->m24=(pow(C,2)+5.8934e+003*C+1.7926e+008); me->m25=(-2*pow(C,2)+2*1.7926e+008);	me->m26=(pow(C,2)-5.8934e+003*C+1.7926e+008);
+         me->m31=1/(pow(C,2)+2.4891e+004*C+1.2700e+009);me->m32=(-2*pow(C,2)+2*1.2700e+009);me->m33=(pow(C,2)-2.4891e+004*C+1.2700e+009);me->m34=(3.1137e+003*C+6.9768e+008);     me->m35=2*6.9768e+008;				me->m36=(-3.1137e+003*C+6.9768e+008);
+         me->megainmax=2;
+     };
+}
+
+void IHCAN_middle_ear_process(MIDDLEEAR *me, const double *px, int count, double *y)
+{
+    double mey1,mey2,mey3;
+    int    i,n;
+
+    for (i=0, n=me->n; i<count; i++, n++)
+    {
+    if (n==0)  /* Start of the middle-ear filtering section  */
+	{
+	    mey1  = me->m11*px[i];
+        if (me->species>1) mey1 = me->m11*me->m14*px[i];
+        mey2  = mey1*me->m24*me->m21;
+        mey3  = mey2*me->m34*me->m31;
+        y[i] = mey3/me->megainmax ;
+    }
+    else if (n==1)
+	{
+        mey1  = me->m11*(-me->m12*me->mey1[0] + px[i]    - me->px[0]);
+        if (me->species>1) mey1 = me->m11*(-me->m12*me->mey1[0]+me->m14*px[i]+me->m15*me->px[0]);
+		mey2  = me->m21*(-me->m22*me->mey2[0] + me->m24*mey1 + me->m25*me->mey1[0]);
+        mey3  = me->m31*(-me->m32*me->mey3[0] + me->m34*mey2 + me->m35*me->mey2[0]);
+        y[i] = mey3/me->megainmax;
+	}
+	else 
+	{
+        mey1  = me->m11*(-me->m12*me->mey1[0]  + px[i]      - me->px[0]);
+        if (me->species>1) mey1= me->m11*(-me->m12*me->mey1[0]-me->m13*me->mey1[1]+me->m14*px[i]+me->m15*me->px[0]+me->m16*me->px[1]);
+        mey2  = me->m21*(-me->m22*me->mey2[0] - me->m23*me->mey2[1] + me->m24*mey1 + me->m25*me->mey1[0] + me->m26*me->mey1[1]);
+        mey3  = me->m31*(-me->m32*me->mey3[0] - me->m33*me->mey3[1] + me->m34*mey2 + me->m35*me->mey2[0] + me->m36*me->mey2[1]);
+        y[i] = mey3/me->megainmax;
+	}; 	/* End of the middle-ear filtering section */   
+    me->px[1]   = me->px[0];   me->px[0]   = px[i];
+    me->mey1[1] = me->mey1[0]; me->mey1[0] = mey1;
+    me->mey2[1] = me->mey2[0]; me->mey2[0] = mey2;
+    me->mey3[1] = me->mey3[0]; me->mey3[0] = mey3;
+    }
+    me->n += count;
+}
+
+void IHCAN_middle_ear(const double *px, double tdres, int totalstim, int species, double *meout)
+{
+    MIDDLEEAR me;
+
+    IHCAN_middle_ear_open(&me, tdres, species);
+    IHCAN_middle_ear_process(&me, px, totalstim, meout);
+}
+
+/* Set up the parameters and filter states of one channel at sample 0; see IHCSTREAM */
+static void chirp_plan(CHIRPPLAN *cp, double cf, double tdres, double taumax);
+
+/* Make the plan of a channel (see IHCPLAN) */
+static void make_plan(IHCPLAN *pl, double cf, double tdres, double cohc, int species)
+{
+	double bmplace, bmTaubm;
+	double Taumax[1], Taumin[1], bmTaumax[1], bmTaumin[1], ratiobm[1];
+	int    grdelay[1], bmorder;
+
+    memset(pl, 0, sizeof(IHCPLAN));
+    pl->cf = cf; pl->tdres = tdres; pl->cohc = cohc; pl->species = species;
 
-	tmpgain = (double*)mxCalloc(totalstim,sizeof(double));
-    
 	/** Calculate the center frequency for the control-path wideband filter
 	    from the location on basilar membrane, based on Greenwood (JASA 1990) */
 
@@ -234,173 +429,462 @@ void IHCAN(double *px, double cf, int nrep, double tdres, int totalstim,
     {
         /* Cat frequency shift corresponding to 1.2 mm */
         bmplace = 11.9 * log10(0.80 + cf / 456.0); /* Calculate the location on basilar membrane from CF */
-        centerfreq = 456.0*(pow(10,(bmplace+1.2)/11.9)-0.80); /* shift the center freq */
+        pl->centerfreq = 456.0*(pow(10,(bmplace+1.2)/11.9)-0.80); /* shift the center freq */
     }
 
 	if (species>1) /* for human */
     {
         /* Human frequency shift corresponding to 1.2 mm */
         bmplace = (35/2.1) * log10(1.0 + cf / 165.4); /* Calculate the location on basilar membrane from CF */
-        centerfreq = 165.4*(pow(10,(bmplace+1.2)/(35/2.1))-1.0); /* shift the center freq */
+        pl->centerfreq = 165.4*(pow(10,(bmplace+1.2)/(35/2.1))-1.0); /* shift the center freq */
     }
     
-	/*==================================================================*/
-	/*====== Parameters for the gain ===========*/
-    
-	if(species==1) gain = 52.0/2.0*(tanh(2.2*log10(cf/0.6e3)+0.15)+1.0); /* for cat */
-    if(species>1) gain = 52.0/2.0*(tanh(2.2*log10(cf/0.6e3)+0.15)+1.0); /* for human */
-    /*gain = 52/2*(tanh(2.2*log10(cf/1e3)+0.15)+1);*/
-    if(gain>60.0) gain = 60.0;  
-    if(gain<15.0) gain = 15.0;
-    
 	/*====== Parameters for the control-path wideband filter =======*/
 	bmorder = 3;
 	Get_tauwb(cf,species,bmorder,Taumax,Taumin);
-	taubm   = cohc*(Taumax[0]-Taumin[0])+Taumin[0];
-	ratiowb = Taumin[0]/Taumax[0];
 	/*====== Parameters for the signal-path C1 filter ======*/
 	Get_taubm(cf,species,Taumax[0],bmTaumax,bmTaumin,ratiobm);
 	bmTaubm  = cohc*(bmTaumax[0]-bmTaumin[0])+bmTaumin[0];
-	fcohc    = bmTaumax[0]/bmTaubm;
+	pl->bmTaumax = bmTaumax[0]; pl->bmTaumin = bmTaumin[0]; pl->ratiobm = ratiobm[0];
     /*====== Parameters for the control-path wideband filter =======*/
-	wborder  = 3;
-    TauWBMax = Taumin[0]+0.2*(Taumax[0]-Taumin[0]);
-	TauWBMin = TauWBMax/Taumax[0]*Taumin[0];
-    tauwb    = TauWBMax+(bmTaubm-bmTaumax[0])*(TauWBMax-TauWBMin)/(bmTaumax[0]-bmTaumin[0]);
-	
-	wbgain = gain_groupdelay(tdres,centerfreq,cf,tauwb,grdelay);
-	tmpgain[0]   = wbgain; 
-	lasttmpgain  = wbgain;
+    pl->TauWBMax = Taumin[0]+0.2*(Taumax[0]-Taumin[0]);
+	pl->TauWBMin = pl->TauWBMax/Taumax[0]*Taumin[0];
+    pl->tauwb    = pl->TauWBMax+(bmTaubm-bmTaumax[0])*(pl->TauWBMax-pl->TauWBMin)/(bmTaumax[0]-bmTaumin[0]);
+	pl->wbgain   = gain_groupdelay(tdres,pl->centerfreq,cf,pl->tauwb,grdelay);
+
+    /*====== The chirp filters; C2's poles stay at -sigma0*fcohc with fcohc = 1/ratiobm ======*/
+    chirp_plan(&pl->c1, cf, tdres, pl->bmTaumax);
+    chirp_plan(&pl->c2, cf, tdres, pl->bmTaumax);
+    pl->c2status = IHCAN_chirp_coefs(&pl->c2, -pl->c2.sigma0*(1/pl->ratiobm), &pl->c2coefs);
+
+   	/* Total path delay of the IHC output signal */
+    pl->delaypoint = IHCAN_delaypoint(cf, tdres);
+}
+
+void IHCAN_plan(double cf, double tdres, double cohc, int species, IHCPLAN *plan)
+{
+    static IHCPLAN cache[PLAN_CACHE];
+    static int     ncache = 0, next = 0;
+    int            i;
+
+    PLAN_LOCK();
+    for (i=0; i<ncache; i++)
+        if (cache[i].cf == cf && cache[i].tdres == tdres && cache[i].cohc == cohc && cache[i].species == species)
+        {
+            *plan = cache[i];
+            PLAN_UNLOCK();
+            return;
+        }
+    PLAN_UNLOCK();
+
+    make_plan(plan, cf, tdres, cohc, species);
+
+    /* Once the cache is full, the oldest plan makes room */
+    PLAN_LOCK();
+    cache[next] = *plan;
+    next = (next+1) % PLAN_CACHE;
+    if (ncache < PLAN_CACHE) ncache++;
+    PLAN_UNLOCK();
+}
+
+static int ihcan_init(IHCSTREAM *s, double cf, double tdres, double cohc, double cihc, int species)
+{
+    memset(s, 0, sizeof(IHCSTREAM));
+    s->cf = cf; s->tdres = tdres; s->cohc = cohc; s->cihc = cihc; s->species = species;
+
+    /* Scheduled control-path gains, grown as needed (see ihcan_block) */
+    s->ngain = 64;
+    s->gain  = (double*)calloc(s->ngain,sizeof(double));
+    if (!s->gain)
+    {
+        s->st.errmsg = "IHCAN: out of memory.\n";
+        return 1;
+    }
+
+    IHCAN_plan(cf, tdres, cohc, species, &s->plan);
+    s->centerfreq = s->plan.centerfreq;
+	s->bmTaumax = s->plan.bmTaumax; s->bmTaumin = s->plan.bmTaumin; s->ratiobm = s->plan.ratiobm;
+	s->wborder  = 3;
+    s->TauWBMax = s->plan.TauWBMax;
+	s->TauWBMin = s->plan.TauWBMin;
+    s->tauwb    = s->plan.tauwb;
+	s->wbgain   = s->plan.wbgain;
+	s->gain[0]     = s->wbgain; 
+	s->lasttmpgain = s->wbgain;
   	/*===============================================================*/
     /* Nonlinear asymmetry of OHC function and IHC C1 transduction function*/
-	ohcasym  = 7.0;    
-	ihcasym  = 3.0;
+	s->ohcasym  = 7.0;    
+	s->ihcasym  = 3.0;
   	/*===============================================================*/
     /*===============================================================*/
-    /* Prewarping and related constants for the middle ear */
-     fp = 1e3;  /* prewarping frequency 1 kHz */
-     C  = TWOPI*fp/tan(TWOPI/2*fp*tdres);
-     if (species==1) /* for cat */
-     {
-         /* Cat middle-ear filter - simplified version from Bruce et al. (JASA 2003) */
-         m11 = C/(C + 693.48);                    m12 = (693.48 - C)/C;            m13 = 0.0;
-         m14 = 1.0;                               m15 = -1.0;                      m16 = 0.0;
-         m21 = 1/(pow(C,2) + 11053*C + 1.163e8);  m22 = -2*pow(C,2) + 2.326e8;     m23 = pow(C,2) - 11053*C + 1.163e8; 
-         m24 = pow(C,2) + 1356.3*C + 7.4417e8;    m25 = -2*pow(C,2) + 14.8834e8;   m26 = pow(C,2) - 1356.3*C + 7.4417e8;
-         m31 = 1/(pow(C,2) + 4620*C + 909059944); m32 = -2*pow(C,2) + 2*909059944; m33 = pow(C,2) - 4620*C + 909059944;
-         m34 = 5.7585e5*C + 7.1665e7;             m35 = 14.333e7;                  m36 = 7.1665e7 - 5.7585e5*C;
-         megainmax=41.1405;
-     };
-     if (species>1) /* for human */
-     {
-         /* Human middle-ear filter - based on Pascal et al. (JASA 1998)  */
-         m11=1/(pow(C,2)+5.9761e+003*C+2.5255e+007);m12=(-2*pow(C,2)+2*2.5255e+007);m13=(pow(C,2)-5.9761e+003*C+2.5255e+007);m14=(pow(C,2)+5.6665e+003*C);             m15=-2*pow(C,2);					m16=(pow(C,2)-5.6665e+003*C);
-         m21=1/(pow(C,2)+6.4255e+003*C+1.3975e+008);m22=(-2*pow(C,2)+2*1.3975e+008);m23=(pow(C,2)-6.4255e+003*C+1.3975e+008);m24=(pow(C,2)+5.8934e+003*C+1.7926e+008); m25=(-2*pow(C,2)+2*1.7926e+008);	m26=(pow(C,2)-5.8934e+003*C+1.7926e+008);
-         m31=1/(pow(C,2)+2.4891e+004*C+1.2700e+009);m32=(-2*pow(C,2)+2*1.2700e+009);m33=(pow(C,2)-2.4891e+004*C+1.2700e+009);m34=(3.1137e+003*C+6.9768e+008);     m35=2*6.9768e+008;				m36=(-3.1137e+003*C+6.9768e+008);
-         megainmax=2;
-     };
-  	for (n=0;n<totalstim;n++) /* Start of the loop */
-    {    
-        if (n==0)  /* Start of the middle-ear filtering section  */
-		{
-	    	mey1[0]  = m11*px[0];
-            if (species>1) mey1[0] = m11*m14*px[0];
-            mey2[0]  = mey1[0]*m24*m21;
-            mey3[0]  = mey2[0]*m34*m31;
-            meout = mey3[0]/megainmax ;
-        }
-            
-        else if (n==1)
-		{
-            mey1[1]  = m11*(-m12*mey1[0] + px[1]       - px[0]);
-            if (species>1) mey1[1] = m11*(-m12*mey1[0]+m14*px[1]+m15*px[0]);
-			mey2[1]  = m21*(-m22*mey2[0] + m24*mey1[1] + m25*mey1[0]);
-            mey3[1]  = m31*(-m32*mey3[0] + m34*mey2[1] + m35*mey2[0]);
-            meout = mey3[1]/megainmax;
-		}
-	    else 
-		{
-            mey1[n]  = m11*(-m12*mey1[n-1]  + px[n]         - px[n-1]);
-            if (species>1) mey1[n]= m11*(-m12*mey1[n-1]-m13*mey1[n-2]+m14*px[n]+m15*px[n-1]+m16*px[n-2]);
-            mey2[n]  = m21*(-m22*mey2[n-1] - m23*mey2[n-2] + m24*mey1[n] + m25*mey1[n-1] + m26*mey1[n-2]);
-            mey3[n]  = m31*(-m32*mey3[n-1] - m33*mey3[n-2] + m34*mey2[n] + m35*mey2[n-1] + m36*mey2[n-2]);
-            meout = mey3[n]/megainmax;
-		}; 	/* End of the middle-ear filtering section */   
-     
-		/* Control-path filter */
-
-        wbout1 = WbGammaTone(meout,tdres,centerfreq,n,tauwb,wbgain,wborder);
-        wbout  = pow((tauwb/TauWBMax),wborder)*wbout1*10e3*__max(1,cf/5e3);
+    IHCAN_middle_ear_open(&s->me, tdres, species);
+    s->delaypoint = s->plan.delaypoint;
+    return 0;
+}
+
+/* Declarations of the filter functions used by the stages below */
+static double chirp_step(CHIRPSTATE *st, const CHIRPPLAN *cp, const CHIRPCOEFS *k, double x);
+double WbGammaTone(double, double, double, int, double, double, int, WBGTSTATE *);
+double OhcLowPass(double, double, double, int, double, int, LOWPASSSTATE *);
+double IhcLowPass(double, double, double, int, double, int, LOWPASSSTATE *);
+
+/* The stages of ihcan_block, each over count <= IHC_CHUNK samples from sample s->n.  They
+   only feed forward (the middle ear into the control path and both chirp filters, the
+   control path into C1, the chirp filters into the IHC), so each runs over the whole block
+   before the next one starts, with the results of running them sample by sample.  Only the
+   control path and C1 depend on cohc, and only the transduction on cihc, which lets
+   IHCAN_sweep share the others between impairments.  On failure s->st.errmsg is set. */
+
+/* Control path and signal-path C1 filter: middle-ear output meout to c1filterout */
+static int ihcan_c1_path(IHCSTREAM *s, const double *meout, int count, double *c1filterout, ANPROF *prof, double *t)
+{
+	double rsigma[IHC_CHUNK];
+	double wbout1,wbout,ohcnonlinout,ohcout,tmptauc1,tauc1,wb_gain;
+	int    i,n,grd,grdelay[1];
+	CHIRPCOEFS k;
+
+	/* Control-path filter */
+
+    for (i=0, n=s->n; i<count; i++, n++)
+    {
+    wbout1 = WbGammaTone(meout[i],s->tdres,s->centerfreq,n,s->tauwb,s->wbgain,s->wborder,&s->st.wb);
+    wbout  = pow((s->tauwb/s->TauWBMax),s->wborder)*wbout1*10e3*__max(1,s->cf/5e3);
   
-        ohcnonlinout = Boltzman(wbout,ohcasym,12.0,5.0,5.0); /* pass the control signal through OHC Nonlinear Function */
-		ohcout = OhcLowPass(ohcnonlinout,tdres,600,n,1.0,2);/* lowpass filtering after the OHC nonlinearity */
+    ohcnonlinout = Boltzman(wbout,s->ohcasym,12.0,5.0,5.0); /* pass the control signal through OHC Nonlinear Function */
+	ohcout = OhcLowPass(ohcnonlinout,s->tdres,600,n,1.0,2,&s->st.ohc);/* lowpass filtering after the OHC nonlinearity */
         
-		tmptauc1 = NLafterohc(ohcout,bmTaumin[0],bmTaumax[0],ohcasym); /* nonlinear function after OHC low-pass filter */
-		tauc1    = cohc*(tmptauc1-bmTaumin[0])+bmTaumin[0];  /* time -constant for the signal-path C1 filter */
-		rsigma   = 1/tauc1-1/bmTaumax[0]; /* shift of the location of poles of the C1 filter from the initial positions */
+	tmptauc1 = NLafterohc(ohcout,s->bmTaumin,s->bmTaumax,s->ohcasym); /* nonlinear function after OHC low-pass filter */
+	tauc1    = s->cohc*(tmptauc1-s->bmTaumin)+s->bmTaumin;  /* time -constant for the signal-path C1 filter */
+	rsigma[i] = 1/tauc1-1/s->bmTaumax; /* shift of the location of poles of the C1 filter from the initial positions */
 
-		if (1/tauc1<0.0) mexErrMsgTxt("The poles are in the right-half plane; system is unstable.\n");
+	if (1/tauc1<0.0)
+	{
+		s->st.errmsg = "The poles are in the right-half plane; system is unstable.\n";
+		return 1;
+	}
 
-		tauwb = TauWBMax+(tauc1-bmTaumax[0])*(TauWBMax-TauWBMin)/(bmTaumax[0]-bmTaumin[0]);
+	s->tauwb = s->TauWBMax+(tauc1-s->bmTaumax)*(s->TauWBMax-s->TauWBMin)/(s->bmTaumax-s->bmTaumin);
 
-	    wb_gain = gain_groupdelay(tdres,centerfreq,cf,tauwb,grdelay);
+	wb_gain = gain_groupdelay(s->tdres,s->centerfreq,s->cf,s->tauwb,grdelay);
 		
-		grd = grdelay[0]; 
+	grd = grdelay[0]; 
 
-        if ((grd+n)<totalstim)
-	         tmpgain[grd+n] = wb_gain;
+    /* The gain takes effect grd samples from now; gain[] is a ring indexed by sample
+       number, in which 0 marks a sample without a scheduled gain */
+    if (grd >= s->ngain)
+    {
+        int    m, ngain = s->ngain;
+        double *g;
+        while (ngain <= grd) ngain *= 2;
+        if ((g = (double*)calloc(ngain,sizeof(double))) == NULL)
+        {
+            s->st.errmsg = "IHCAN: out of memory.\n";
+            return 1;
+        }
+        for (m=n; m<n+s->ngain; m++)
+            g[m % ngain] = s->gain[m % s->ngain];
+        free(s->gain);
+        s->gain = g; s->ngain = ngain;
+    }
+    if (grd >= 0)
+        s->gain[(grd+n) % s->ngain] = wb_gain;
 
-        if (tmpgain[n] == 0)
-			tmpgain[n] = lasttmpgain;	
+    if (s->gain[n % s->ngain] == 0)
+		s->gain[n % s->ngain] = s->lasttmpgain;	
 		
-		wbgain      = tmpgain[n];
-		lasttmpgain = wbgain;
+	s->wbgain      = s->gain[n % s->ngain];
+	s->lasttmpgain = s->wbgain;
+	s->gain[n % s->ngain] = 0;
+    }
+    *t = prof_lap(prof, PROF_CONTROL_PATH, *t, count);
 	 		        
-        /*====== Signal-path C1 filter ======*/
+    /*====== Signal-path C1 filter ======*/
          
-		 c1filterouttmp = C1ChirpFilt(meout, tdres, cf, n, bmTaumax[0], rsigma); /* C1 filter output */
+    for (i=0; i<count; i++)
+    {
+	switch (IHCAN_chirp_coefs(&s->plan.c1, -s->plan.c1.sigma0 - rsigma[i], &k)) /* poles shifted by rsigma */
+	{
+	case 1:  s->st.c1.errmsg = "The system becomes unstable.\n"; break;
+	case 2:  s->st.c1.errmsg = "The zeros are in the right-half plane.\n"; break;
+	}
+	if (s->st.c1.errmsg)
+	{
+		s->st.errmsg = s->st.c1.errmsg;
+		return 1;
+	}
+	c1filterout[i] = chirp_step(&s->st.c1, &s->plan.c1, &k, meout[i]); /* C1 filter output */
+    }
+    *t = prof_lap(prof, PROF_C1_FILTER, *t, count);
+    return 0;
+}
 
-	 
-        /*====== Parallel-path C2 filter ======*/
+/* Parallel-path C2 filter and its transduction: middle-ear output meout to c2vihc */
+static int ihcan_c2_path(IHCSTREAM *s, const double *meout, int count, double *c2vihc, ANPROF *prof, double *t)
+{
+	double c2filterout;
+	int    i;
 
-		 c2filterouttmp  = C2ChirpFilt(meout, tdres, cf, n, bmTaumax[0], 1/ratiobm[0]); /* parallel-filter output*/
+    /* C2 is time invariant: its coefficients are part of the plan */
+    switch (s->plan.c2status)
+    {
+    case 1:  s->st.c2.errmsg = "The system becomes unstable.\n"; break;
+    case 2:  s->st.c2.errmsg = "The zeros are in the right-hand plane.\n"; break;
+    }
+    if (s->st.c2.errmsg)
+    {
+        s->st.errmsg = s->st.c2.errmsg;
+        return 1;
+    }
+    for (i=0; i<count; i++)
+    {
+	c2filterout = chirp_step(&s->st.c2, &s->plan.c2, &s->plan.c2coefs, meout[i]); /* parallel-filter output*/
+	c2vihc[i] = -NLogarithm(c2filterout*fabs(c2filterout)*s->cf/10*s->cf/2e3,0.2,1.0,s->cf); /* C2 transduction output */
+    }
+    *t = prof_lap(prof, PROF_C2_FILTER, *t, count);
+    return 0;
+}
 
-	    /*=== Run the inner hair cell (IHC) section: NL function and then lowpass filtering ===*/
+/* The inner hair cell (IHC) section: C1 transduction with cihc, then lowpass filtering in
+   the lowpass state ihc */
+static void ihcan_transduction(const IHCSTREAM *s, double cihc, const double *c1filterout, const double *c2vihc,
+                               int count, LOWPASSSTATE *ihc, double *y, ANPROF *prof, double *t)
+{
+	double c1vihctmp;
+	int    i,n;
 
-        c1vihctmp  = NLogarithm(cihc*c1filterouttmp,0.1,ihcasym,cf);
-	     
-		c2vihctmp = -NLogarithm(c2filterouttmp*fabs(c2filterouttmp)*cf/10*cf/2e3,0.2,1.0,cf); /* C2 transduction output */
+    for (i=0, n=s->n; i<count; i++, n++)
+    {
+    c1vihctmp  = NLogarithm(cihc*c1filterout[i],0.1,s->ihcasym,s->cf);
             
-        ihcouttmp[n] = IhcLowPass(c1vihctmp+c2vihctmp,tdres,3000,n,1.0,7);
-   };  /* End of the loop */
-   
-    /* Stretched out the IHC output according to nrep (number of repetitions) */
-   
-    for(i=0;i<totalstim*nrep;i++)
+    y[i] = IhcLowPass(c1vihctmp+c2vihc[i],s->tdres,3000,n,1.0,7,ihc);
+    }
+    *t = prof_lap(prof, PROF_IHC_TRANSDUCTION, *t, count);
+}
+
+/* Run the next n <= IHC_CHUNK samples of the channel from its middle-ear output meout,
+   writing the (undelayed) IHC outputs to y, one stage after the other; t is the profile's
+   clock.  On failure s->st.errmsg is set and the outputs are meaningless. */
+static int ihcan_block_me(IHCSTREAM *s, const double *meout, int count, double *y, ANPROF *prof, double t)
+{
+	double c1filterout[IHC_CHUNK],c2vihc[IHC_CHUNK];
+
+    if (ihcan_c1_path(s, meout, count, c1filterout, prof, &t)
+        || ihcan_c2_path(s, meout, count, c2vihc, prof, &t))
+        return 1;
+    ihcan_transduction(s, s->cihc, c1filterout, c2vihc, count, &s->st.ihc, y, prof, &t);
+    s->n += count;
+    return 0;
+}
+
+/* The same from the stimulus px, running the channel's own middle-ear filter first */
+static int ihcan_block(IHCSTREAM *s, const double *px, int count, double *y, ANPROF *prof)
+{
+	double meout[IHC_CHUNK],t;
+
+    t = prof_start(prof);
+    IHCAN_middle_ear_process(&s->me, px, count, meout);
+    t = prof_lap(prof, PROF_MIDDLE_EAR, t, count);
+    return ihcan_block_me(s, meout, count, y, prof, t);
+}
+
+/* IHCAN from the stimulus x, or, if me is non-zero, from its middle-ear output x.  Only one
+   period is computed and stored; the nrep repetitions, delayed by delaypoint samples, are
+   written straight from it.  With nrep = 0, ihcout receives the undelayed period itself. */
+static int ihcan_run(const double *x, int me, double cf, int nrep, double tdres, int totalstim,
+                     double cohc, double cihc, int species, IHCSTATE *state, double *ihcout, ANPROF *prof)
+{	
+	double     *period, t;
+	long long  i;
+	int        n,delaypoint;
+	IHCSTREAM  s;
+
+    /* Allocate dynamic memory for the temporary variables (calloc rather than mxCalloc,
+       so that IHCAN may also be called from threads other than MATLAB's) */
+	period = NULL;
+	if (ihcan_init(&s, cf, tdres, cohc, cihc, species))
+		goto cleanup;
+	period = (nrep == 0) ? ihcout : (double*)calloc(totalstim,sizeof(double));
+	if (!period)
 	{
-		ihcouttmp[i] = ihcouttmp[(int) (fmod(i,totalstim))];
-  	};   
-   	/* Adjust total path delay to IHC output signal */
-    if (species==1)
-        delay      = delay_cat(cf);
-    if (species>1)
-    {/*    delay      = delay_human(cf); */
-        delay      = delay_cat(cf); /* signal delay changed back to cat function for version 5.2 */
-    };
-    delaypoint =__max(0,(int) ceil(delay/tdres));    
-         
-    for(i=delaypoint;i<totalstim*nrep;i++)
+		s.st.errmsg = "IHCAN: out of memory.\n";
+		goto cleanup;
+	}
+	if (prof) prof->bytes += (double) ((nrep == 0) ? 0 : totalstim)*sizeof(double) + s.ngain*sizeof(double);
+    
+  	for (n=0;n<totalstim;n+=IHC_CHUNK) /* Start of the loop */
+    {    
+        if (me ? ihcan_block_me(&s, x+n, __min(IHC_CHUNK,totalstim-n), period+n, prof, prof_start(prof))
+               : ihcan_block(&s, x+n, __min(IHC_CHUNK,totalstim-n), period+n, prof))
+            goto cleanup;
+    };  /* End of the loop */
+   
+    t = prof_start(prof);
+    /* Stretched out the IHC output according to nrep (number of repetitions), and adjust
+       the total path delay to IHC output signal */
+    delaypoint = s.delaypoint;
+    for (i=delaypoint, n=0; i<(long long) totalstim*nrep; i++)
 	{        
-		ihcout[i] = ihcouttmp[i - delaypoint];
+		ihcout[i] = period[n];
+		if (++n == totalstim) n = 0;
   	};   
+    prof_lap(prof, PROF_IHC_OUTPUT, t, 1);
 
     /* Freeing dynamic memory allocated earlier */
+cleanup:
+    if (period != ihcout) free(period);
+    free(s.gain);
+    *state = s.st;
 
-    mxFree(ihcouttmp);
-    mxFree(mey1); mxFree(mey2); mxFree(mey3);	
-    mxFree(tmpgain);
+    return (state->errmsg != NULL);
+}
+
+int IHCAN(double *px, double cf, int nrep, double tdres, int totalstim,
+                double cohc, double cihc, int species, IHCSTATE *state, double *ihcout, ANPROF *prof)
+{
+    return ihcan_run(px, 0, cf, nrep, tdres, totalstim, cohc, cihc, species, state, ihcout, prof);
+}
+
+int IHCAN_period(const double *meout, double cf, double tdres, int totalstim, double cohc, double cihc,
+                 int species, IHCSTATE *state, double *period, ANPROF *prof)
+{
+    return ihcan_run(meout, 1, cf, 0, tdres, totalstim, cohc, cihc, species, state, period, prof);
+}
+
+int IHCAN_delaypoint(double cf, double tdres)
+{
+    /* signal delay changed back to cat function for version 5.2, for all species */
+    return __max(0,(int) ceil(delay_cat(cf)/tdres));
+}
+
+int IHCAN_sweep(const double *px, double cf, int nrep, double tdres, int totalstim, int nimp,
+                const double *cohc, const double *cihc, int species, double **ihcout,
+                const char **errmsg, ANPROF *prof)
+{
+	double       meout[IHC_CHUNK],c2vihc[IHC_CHUNK],y[IHC_CHUNK],*c1filterout,t;
+	IHCSTREAM    *s;
+	LOWPASSSTATE *ihc;
+	int          *path,npath,i,j,k,m,n,total;
+
+    /* One stream per distinct cohc runs the control path and C1; the first one also runs
+       the middle ear and C2 for all of them */
+    *errmsg = NULL;
+    total = totalstim*nrep;
+    s    = (IHCSTREAM*)calloc(nimp,sizeof(IHCSTREAM));
+    ihc  = (LOWPASSSTATE*)calloc(nimp,sizeof(LOWPASSSTATE));
+    path = (int*)calloc(nimp,sizeof(int));
+    c1filterout = (double*)calloc((size_t)nimp*IHC_CHUNK,sizeof(double));
+    npath = 0;
+    if (!s || !ihc || !path || !c1filterout)
+    {
+        *errmsg = "IHCAN: out of memory.\n";
+        goto cleanup;
+    }
+    for (k=0; k<nimp; k++)
+    {
+        for (j=0; j<npath && s[j].cohc!=cohc[k]; j++) ;
+        path[k] = j;
+        if (j < npath)
+            continue;
+        if (ihcan_init(&s[npath++], cf, tdres, cohc[k], cihc[k], species))
+        {
+            *errmsg = s[npath-1].st.errmsg;
+            goto cleanup;
+        }
+    }
+    if (prof) prof->bytes += (double) npath*(sizeof(IHCSTREAM)+IHC_CHUNK*sizeof(double));
+
+    for (n=0; n<totalstim; n+=m)
+    {
+        m = __min(IHC_CHUNK,totalstim-n);
+        t = prof_start(prof);
+        IHCAN_middle_ear_process(&s[0].me, px+n, m, meout);
+        t = prof_lap(prof, PROF_MIDDLE_EAR, t, m);
+        for (j=0; j<npath; j++)
+            if (ihcan_c1_path(&s[j], meout, m, c1filterout+(size_t)j*IHC_CHUNK, prof, &t))
+            {
+                *errmsg = s[j].st.errmsg;
+                goto cleanup;
+            }
+        if (ihcan_c2_path(&s[0], meout, m, c2vihc, prof, &t))
+        {
+            *errmsg = s[0].st.errmsg;
+            goto cleanup;
+        }
+        for (k=0; k<nimp; k++)
+        {
+            ihcan_transduction(&s[0], cihc[k], c1filterout+(size_t)path[k]*IHC_CHUNK, c2vihc, m,
+                               &ihc[k], y, prof, &t);
+            /* Delayed by delaypoint samples, as in IHCAN */
+            for (i=0; i<m && n+i+s[0].delaypoint<total; i++)
+                ihcout[k][n+i+s[0].delaypoint] = y[i];
+        }
+        for (j=0; j<npath; j++)
+            s[j].n += m;
+    }
+
+    /* The repetitions, and the zeros before the delayed output */
+    t = prof_start(prof);
+    for (k=0; k<nimp; k++)
+    {
+        for (i=0; i<s[0].delaypoint && i<total; i++)
+            ihcout[k][i] = 0;
+        for (i=totalstim+s[0].delaypoint; i<total; i++)
+            ihcout[k][i] = ihcout[k][i-totalstim];
+    }
+    prof_lap(prof, PROF_IHC_OUTPUT, t, 1);
+
+cleanup:
+    if (s)
+        for (j=0; j<npath; j++)
+            free(s[j].gain);
+    free(s); free(ihc); free(path); free(c1filterout);
+    return (*errmsg != NULL);
+}
+
+int IHCAN_stream_open(IHCSTREAM *s, double cf, double tdres, double cohc, double cihc, int species)
+{
+    if (ihcan_init(s, cf, tdres, cohc, cihc, species))
+        return 1;
+    if (s->delaypoint > 0 && (s->delayline = (double*)calloc(s->delaypoint,sizeof(double))) == NULL)
+    {
+        free(s->gain); s->gain = NULL;
+        s->st.errmsg = "IHCAN: out of memory.\n";
+        return 1;
+    }
+    return 0;
+}
+
+int IHCAN_stream_process(IHCSTREAM *s, const double *px, int n, double *ihcout)
+{
+    double y, t;
+    int    i, j, m, slot;
+
+    for (j=0; j<n; j+=m)
+    {
+        m = __min(IHC_CHUNK, n-j);
+        if (ihcan_block(s, px+j, m, ihcout+j, s->prof))
+            return 1;
+        /* Delay by delaypoint samples: the first delaypoint outputs are zero, as in IHCAN */
+        if (s->delaypoint == 0)
+            continue;
+        t = prof_start(s->prof);
+        for (i=j; i<j+m; i++)
+        {
+            y = ihcout[i];
+            slot = (s->n - m + i - j) % s->delaypoint;
+            ihcout[i] = s->delayline[slot];
+            s->delayline[slot] = y;
+        }
+        prof_lap(s->prof, PROF_IHC_OUTPUT, t, 0);
+    }
+    return 0;
+}
 
-} /* End of the SingleAN function */
+void IHCAN_stream_close(IHCSTREAM *s)
+{
+    free(s->gain); free(s->delayline);
+    s->gain = s->delayline = NULL;
+}
 /* -------------------------------------------------------------------------------------------- */
 /* -------------------------------------------------------------------------------------------- */
 /** Get TauMax, TauMin for the tuning filter. The TauMax is determined by the bandwidth/Q10
@@ -461,307 +945,133 @@ double Get_taubm(double cf, int species, double taumax,double *bmTaumax,double *
   return 0;
 }
 /* -------------------------------------------------------------------------------------------- */
-/** Pass the signal through the signal-path C1 Tenth Order Nonlinear Chirp-Gammatone Filter */
-
-double C1ChirpFilt(double x, double tdres,double cf, int n, double taumax, double rsigma)
+/** The signal-path C1 Tenth Order Nonlinear Chirp-Gammatone Filter, and the parallel-path C2
+    filter, which is the same filter with the OHC completely impaired.  Both have five pole
+    pairs p[1], p[3], p[5], p[7] = p[1] and p[9] = p[5] and a fifth-order zero, which moves
+    with the poles so as to keep the phase at CF of the initial layout.  The poles of C1 move
+    every sample with the control path's rsigma; those of C2 stay at -sigma0*fcohc.  They
+    used to recompute the fixed part of the layout on every sample; now chirp_plan does it
+    once per channel, IHCAN_chirp_coefs places the poles and the zero, and chirp_step runs
+    one sample. */
+
+/* Pole pair i (1..5) uses pole set POLESET[i-1]: p[1], p[3], p[5], p[1], p[5] */
+static const int POLESET[5] = {0, 1, 2, 0, 2};
+
+/* The fixed part of the filter (the n==0 branch of the old C1ChirpFilt/C2ChirpFilt) */
+static void chirp_plan(CHIRPPLAN *cp, double cf, double tdres, double taumax)
 {
-    static double C1gain_norm, C1initphase; 
-    static double C1input[12][4], C1output[12][4];
+	double pzero, rzero, CF, gain_norm, preal[3], pimg[3];
+	int    i, r;
 
-    double ipw, ipb, rpa, pzero, rzero;
-	double sigma0,fs_bilinear,CF,norm_gain,phase,c1filterout;
-	int i,r,order_of_pole,half_order_pole,order_of_zero;
-	double temp, dy, preal, pimg;
-
-	COMPLEX p[11]; 
-	
-	/* Defining initial locations of the poles and zeros */
 	/*======== setup the locations of poles and zeros =======*/
-	  sigma0 = 1/taumax;
-	  ipw    = 1.01*cf*TWOPI-50;
-	  ipb    = 0.2343*TWOPI*cf-1104;
-	  rpa    = pow(10, log10(cf)*0.9 + 0.55)+ 2000;
-	  pzero  = pow(10,log10(cf)*0.7+1.6)+500;
-
-	/*===============================================================*/     
-         
-     order_of_pole    = 10;             
-     half_order_pole  = order_of_pole/2;
-     order_of_zero    = half_order_pole;
-
-	 fs_bilinear = TWOPI*cf/tan(TWOPI*cf*tdres/2);
-     rzero       = -pzero;
-	 CF          = TWOPI*cf;
-   
-   if (n==0)
-   {		  
-	p[1].x = -sigma0;     
-
-    p[1].y = ipw;
-
-	p[5].x = p[1].x - rpa; p[5].y = p[1].y - ipb;
-
-    p[3].x = (p[1].x + p[5].x) * 0.5; p[3].y = (p[1].y + p[5].y) * 0.5;
-
-    p[2]   = compconj(p[1]);    p[4] = compconj(p[3]); p[6] = compconj(p[5]);
-
-    p[7]   = p[1]; p[8] = p[2]; p[9] = p[5]; p[10]= p[6];
-
-	   C1initphase = 0.0;
-       for (i=1;i<=half_order_pole;i++)          
-	   {
-           preal     = p[i*2-1].x;
-		   pimg      = p[i*2-1].y;
-	       C1initphase = C1initphase + atan(CF/(-rzero))-atan((CF-pimg)/(-preal))-atan((CF+pimg)/(-preal));
-	   };
-
-	/*===================== Initialize C1input & C1output =====================*/
-
-      for (i=1;i<=(half_order_pole+1);i++)          
-      {
-		   C1input[i][3] = 0; 
-		   C1input[i][2] = 0; 
-		   C1input[i][1] = 0;
-		   C1output[i][3] = 0; 
-		   C1output[i][2] = 0; 
-		   C1output[i][1] = 0;
-      }
+	cp->sigma0 = 1/taumax;
+	cp->ipw    = 1.01*cf*TWOPI-50;
+	cp->ipb    = 0.2343*TWOPI*cf-1104;
+	cp->rpa    = pow(10, log10(cf)*0.9 + 0.55)+ 2000;
+	pzero      = pow(10,log10(cf)*0.7+1.6)+500;
+	cp->fs     = TWOPI*cf/tan(TWOPI*cf*tdres/2);  /* fs_bilinear */
+	rzero      = -pzero;
+	CF         = TWOPI*cf;
+	cp->CF     = CF;
+
+	preal[0] = -cp->sigma0;                pimg[0] = cp->ipw;
+	preal[2] = preal[0] - cp->rpa;         pimg[2] = pimg[0] - cp->ipb;
+	preal[1] = (preal[0] + preal[2])*0.5;  pimg[1] = (pimg[0] + pimg[2])*0.5;
+
+	cp->initphase = 0.0;
+	for (i=0; i<5; i++)
+		cp->initphase = cp->initphase + atan(CF/(-rzero))-atan((CF-pimg[POLESET[i]])/(-preal[POLESET[i]]))
+		                                                -atan((CF+pimg[POLESET[i]])/(-preal[POLESET[i]]));
 
 	/*===================== normalize the gain =====================*/
-    
-      C1gain_norm = 1.0;
-      for (r=1; r<=order_of_pole; r++)
-		   C1gain_norm = C1gain_norm*(pow((CF - p[r].y),2) + p[r].x*p[r].x);
-      
-   };
-     
-    norm_gain= sqrt(C1gain_norm)/pow(sqrt(CF*CF+rzero*rzero),order_of_zero);
-	
-	p[1].x = -sigma0 - rsigma;
-
-	if (p[1].x>0.0) mexErrMsgTxt("The system becomes unstable.\n");
-	
-	p[1].y = ipw;
-
-	p[5].x = p[1].x - rpa; p[5].y = p[1].y - ipb;
-
-    p[3].x = (p[1].x + p[5].x) * 0.5; p[3].y = (p[1].y + p[5].y) * 0.5;
-
-    p[2] = compconj(p[1]); p[4] = compconj(p[3]); p[6] = compconj(p[5]);
-
-    p[7] = p[1]; p[8] = p[2]; p[9] = p[5]; p[10]= p[6];
-
-    phase = 0.0;
-    for (i=1;i<=half_order_pole;i++)          
-    {
-           preal = p[i*2-1].x;
-		   pimg  = p[i*2-1].y;
-	       phase = phase-atan((CF-pimg)/(-preal))-atan((CF+pimg)/(-preal));
-	};
-
-	rzero = -CF/tan((C1initphase-phase)/order_of_zero);
-
-    if (rzero>0.0) mexErrMsgTxt("The zeros are in the right-half plane.\n");
-	 
-   /*%==================================================  */
-	/*each loop below is for a pair of poles and one zero */
-   /*%      time loop begins here                         */
-   /*%==================================================  */
- 
-       C1input[1][3]=C1input[1][2]; 
-	   C1input[1][2]=C1input[1][1]; 
-	   C1input[1][1]= x;
-
-       for (i=1;i<=half_order_pole;i++)          
-       {
-           preal = p[i*2-1].x;
-		   pimg  = p[i*2-1].y;
-		  	   
-           temp  = pow((fs_bilinear-preal),2)+ pow(pimg,2);
-		   
-
-           /*dy = (input[i][1] + (1-(fs_bilinear+rzero)/(fs_bilinear-rzero))*input[i][2]
-                                 - (fs_bilinear+rzero)/(fs_bilinear-rzero)*input[i][3] );
-           dy = dy+2*output[i][1]*(fs_bilinear*fs_bilinear-preal*preal-pimg*pimg);
-
-           dy = dy-output[i][2]*((fs_bilinear+preal)*(fs_bilinear+preal)+pimg*pimg);*/
-		   
-	       dy = C1input[i][1]*(fs_bilinear-rzero) - 2*rzero*C1input[i][2] - (fs_bilinear+rzero)*C1input[i][3]
-                 +2*C1output[i][1]*(fs_bilinear*fs_bilinear-preal*preal-pimg*pimg)
-			     -C1output[i][2]*((fs_bilinear+preal)*(fs_bilinear+preal)+pimg*pimg);
-
-		   dy = dy/temp;
-
-		   C1input[i+1][3] = C1output[i][2]; 
-		   C1input[i+1][2] = C1output[i][1]; 
-		   C1input[i+1][1] = dy;
-
-		   C1output[i][2] = C1output[i][1]; 
-		   C1output[i][1] = dy;
-       }
-
-	   dy = C1output[half_order_pole][1]*norm_gain;  /* don't forget the gain term */
-	   c1filterout= dy/4.0;   /* signal path output is divided by 4 to give correct C1 filter gain */
-	                   
-     return (c1filterout);
-}  
-
-/* -------------------------------------------------------------------------------------------- */
-/** Parallelpath C2 filter: same as the signal-path C1 filter with the OHC completely impaired */
+	/* p[1..10] = p1, conj(p1), p3, conj(p3), p5, conj(p5), p1, conj(p1), p5, conj(p5) */
+	gain_norm = 1.0;
+	for (r=1; r<=10; r++)
+	{
+		int    set = POLESET[(r-1)/2];
+		double y   = (r%2) ? pimg[set] : -pimg[set];
+		gain_norm = gain_norm*(pow((CF - y),2) + preal[set]*preal[set]);
+	}
+	cp->normgain = sqrt(gain_norm)/pow(sqrt(CF*CF+rzero*rzero),5);
+}
 
-double C2ChirpFilt(double xx, double tdres,double cf, int n, double taumax, double fcohc)
+/* Place the poles and the zero of a chirp filter (see model_IHC.hpp) */
+int IHCAN_chirp_coefs(const CHIRPPLAN *cp, double px1, CHIRPCOEFS *k)
 {
-	static double C2gain_norm, C2initphase;
-    static double C2input[12][4];  static double C2output[12][4];
-   
-	double ipw, ipb, rpa, pzero, rzero;
-
-	double sigma0,fs_bilinear,CF,norm_gain,phase,c2filterout;
-	int    i,r,order_of_pole,half_order_pole,order_of_zero;
-	double temp, dy, preal, pimg;
-
-	COMPLEX p[11]; 	
-    
-    /*================ setup the locations of poles and zeros =======*/
-
-	  sigma0 = 1/taumax;
-	  ipw    = 1.01*cf*TWOPI-50;
-      ipb    = 0.2343*TWOPI*cf-1104;
-	  rpa    = pow(10, log10(cf)*0.9 + 0.55)+ 2000;
-	  pzero  = pow(10,log10(cf)*0.7+1.6)+500;
-	/*===============================================================*/     
-         
-     order_of_pole    = 10;             
-     half_order_pole  = order_of_pole/2;
-     order_of_zero    = half_order_pole;
-
-	 fs_bilinear = TWOPI*cf/tan(TWOPI*cf*tdres/2);
-     rzero       = -pzero;
-	 CF          = TWOPI*cf;
-   	    
-    if (n==0)
-    {		  
-	p[1].x = -sigma0;     
-
-    p[1].y = ipw;
-
-	p[5].x = p[1].x - rpa; p[5].y = p[1].y - ipb;
-
-    p[3].x = (p[1].x + p[5].x) * 0.5; p[3].y = (p[1].y + p[5].y) * 0.5;
-
-    p[2] = compconj(p[1]); p[4] = compconj(p[3]); p[6] = compconj(p[5]);
-
-    p[7] = p[1]; p[8] = p[2]; p[9] = p[5]; p[10]= p[6];
-
-	   C2initphase = 0.0;
-       for (i=1;i<=half_order_pole;i++)         
-	   {
-           preal     = p[i*2-1].x;
-		   pimg      = p[i*2-1].y;
-	       C2initphase = C2initphase + atan(CF/(-rzero))-atan((CF-pimg)/(-preal))-atan((CF+pimg)/(-preal));
-	   };
-
-	/*===================== Initialize C2input & C2output =====================*/
+	double CF = cp->CF, fs = cp->fs, phase, rzero, preal[3], pimg[3];
+	int    i, j;
 
-      for (i=1;i<=(half_order_pole+1);i++)          
-      {
-		   C2input[i][3] = 0; 
-		   C2input[i][2] = 0; 
-		   C2input[i][1] = 0;
-		   C2output[i][3] = 0; 
-		   C2output[i][2] = 0; 
-		   C2output[i][1] = 0;
-      }
-    
-    /*===================== normalize the gain =====================*/
-    
-     C2gain_norm = 1.0;
-     for (r=1; r<=order_of_pole; r++)
-		   C2gain_norm = C2gain_norm*(pow((CF - p[r].y),2) + p[r].x*p[r].x);
-    };
-     
-    norm_gain= sqrt(C2gain_norm)/pow(sqrt(CF*CF+rzero*rzero),order_of_zero);
-    
-	p[1].x = -sigma0*fcohc;
+	if (px1>0.0)
+		return 1;
 
-	if (p[1].x>0.0) mexErrMsgTxt("The system becomes unstable.\n");
-	
-	p[1].y = ipw;
-
-	p[5].x = p[1].x - rpa; p[5].y = p[1].y - ipb;
+	preal[0] = px1;                        pimg[0] = cp->ipw;
+	preal[2] = preal[0] - cp->rpa;         pimg[2] = pimg[0] - cp->ipb;
+	preal[1] = (preal[0] + preal[2])*0.5;  pimg[1] = (pimg[0] + pimg[2])*0.5;
 
-    p[3].x = (p[1].x + p[5].x) * 0.5; p[3].y = (p[1].y + p[5].y) * 0.5;
+	phase = 0.0;
+	for (i=0; i<5; i++)
+		phase = phase-atan((CF-pimg[POLESET[i]])/(-preal[POLESET[i]]))-atan((CF+pimg[POLESET[i]])/(-preal[POLESET[i]]));
 
-    p[2] = compconj(p[1]); p[4] = compconj(p[3]); p[6] = compconj(p[5]);
+	rzero = -CF/tan((cp->initphase-phase)/5);
+	if (rzero>0.0)
+		return 2;
 
-    p[7] = p[1]; p[8] = p[2]; p[9] = p[5]; p[10]= p[6];
+	k->A  = fs-rzero;
+	k->B  = 2*rzero;
+	k->Cc = fs+rzero;
+	for (j=0; j<3; j++)
+	{
+		k->D[j] = fs*fs-preal[j]*preal[j]-pimg[j]*pimg[j];
+		k->E[j] = (fs+preal[j])*(fs+preal[j])+pimg[j]*pimg[j];
+		k->T[j] = pow((fs-preal[j]),2)+ pow(pimg[j],2);
+	}
+	return 0;
+}
 
-    phase = 0.0;
-    for (i=1;i<=half_order_pole;i++)          
-    {
-           preal = p[i*2-1].x;
-		   pimg  = p[i*2-1].y;
-	       phase = phase-atan((CF-pimg)/(-preal))-atan((CF+pimg)/(-preal));
-	};
+/* Filter one sample x; each pole pair and one zero is a bilinear-transformed biquad */
+static double chirp_step(CHIRPSTATE *st, const CHIRPPLAN *cp, const CHIRPCOEFS *k, double x)
+{
+	double (*input)[4] = st->input, (*output)[4] = st->output;
+	double dy;
+	int    i, j;
 
-	rzero = -CF/tan((C2initphase-phase)/order_of_zero);	
-    if (rzero>0.0) mexErrMsgTxt("The zeros are in the right-hand plane.\n");
-   /*%==================================================  */
-   /*%      time loop begins here                         */
-   /*%==================================================  */
+	input[1][3] = input[1][2]; 
+	input[1][2] = input[1][1]; 
+	input[1][1] = x;
 
-       C2input[1][3]=C2input[1][2]; 
-	   C2input[1][2]=C2input[1][1]; 
-	   C2input[1][1]= xx;
+	for (i=1; i<=5; i++)
+	{
+		j  = POLESET[i-1];
+		dy = input[i][1]*k->A - k->B*input[i][2] - k->Cc*input[i][3]
+		     +2*output[i][1]*k->D[j]
+		     -output[i][2]*k->E[j];
+		dy = dy/k->T[j];
+
+		input[i+1][3] = output[i][2]; 
+		input[i+1][2] = output[i][1]; 
+		input[i+1][1] = dy;
+
+		output[i][2] = output[i][1]; 
+		output[i][1] = dy;
+	}
 
-      for (i=1;i<=half_order_pole;i++)          
-      {
-           preal = p[i*2-1].x;
-		   pimg  = p[i*2-1].y;
-		  	   
-           temp  = pow((fs_bilinear-preal),2)+ pow(pimg,2);
-		   
-           /*dy = (input[i][1] + (1-(fs_bilinear+rzero)/(fs_bilinear-rzero))*input[i][2]
-                                 - (fs_bilinear+rzero)/(fs_bilinear-rzero)*input[i][3] );
-           dy = dy+2*output[i][1]*(fs_bilinear*fs_bilinear-preal*preal-pimg*pimg);
-
-           dy = dy-output[i][2]*((fs_bilinear+preal)*(fs_bilinear+preal)+pimg*pimg);*/
-		   
-	      dy = C2input[i][1]*(fs_bilinear-rzero) - 2*rzero*C2input[i][2] - (fs_bilinear+rzero)*C2input[i][3]
-                 +2*C2output[i][1]*(fs_bilinear*fs_bilinear-preal*preal-pimg*pimg)
-			     -C2output[i][2]*((fs_bilinear+preal)*(fs_bilinear+preal)+pimg*pimg);
-
-		   dy = dy/temp;
-
-		   C2input[i+1][3] = C2output[i][2]; 
-		   C2input[i+1][2] = C2output[i][1]; 
-		   C2input[i+1][1] = dy;
-
-		   C2output[i][2] = C2output[i][1]; 
-		   C2output[i][1] = dy;
-
-       };
-
-	  dy = C2output[half_order_pole][1]*norm_gain;
-	  c2filterout= dy/4.0;
-	  
-	  return (c2filterout); 
-}   
+	dy = output[5][1]*cp->normgain;  /* don't forget the gain term */
+	return dy/4.0;  /* signal path output is divided by 4 to give correct C1 filter gain */
+}
 
 /* -------------------------------------------------------------------------------------------- */
 /** Pass the signal through the Control path Third Order Nonlinear Gammatone Filter */
 
-double WbGammaTone(double x,double tdres,double centerfreq, int n, double tau,double gain,int order)
+double WbGammaTone(double x,double tdres,double centerfreq, int n, double tau,double gain,int order, WBGTSTATE *st)
 {
-  static double wbphase;
-  static COMPLEX wbgtf[4], wbgtfl[4];
+  COMPLEX *wbgtf = st->gtf, *wbgtfl = st->gtfl;
 
   double delta_phase,dtmp,c1LP,c2LP,out;
   int i,j;
   
   if (n==0)
   {
-      wbphase = 0;
+      st->phase = 0;
       for(i=0; i<=order;i++)
       {
             wbgtfl[i] = compmult(0,compexp(0));
@@ -770,17 +1080,17 @@ double WbGammaTone(double x,double tdres,double centerfreq, int n, double tau,do
   }
   
   delta_phase = -TWOPI*centerfreq*tdres;
-  wbphase += delta_phase;
+  st->phase += delta_phase;
   
   dtmp = tau*2.0/tdres;
   c1LP = (dtmp-1)/(dtmp+1);
   c2LP = 1.0/(dtmp+1);
-  wbgtf[0] = compmult(x,compexp(wbphase));                 /* FREQUENCY SHIFT */
+  wbgtf[0] = compmult(x,compexp(st->phase));                 /* FREQUENCY SHIFT */
   
   for(j = 1; j <= order; j++)                              /* IIR Bilinear transformation LPF */
   wbgtf[j] = comp2sum(compmult(c2LP*gain,comp2sum(wbgtf[j-1],wbgtfl[j-1])),
       compmult(c1LP,wbgtfl[j]));
-  out = REAL(compprod(compexp(-wbphase), wbgtf[order])); /* FREQ SHIFT BACK UP */
+  out = REAL(compprod(compexp(-st->phase), wbgtf[order])); /* FREQ SHIFT BACK UP */
   
   for(i=0; i<=order;i++) wbgtfl[i] = wbgtf[i];
   return(out);
@@ -852,9 +1162,9 @@ double Boltzman(double x, double asym, double s0, double s1, double x1)
 /* -------------------------------------------------------------------------------------------- */
 /* Get the output of the OHC Low Pass Filter in the Control path */
 
-double OhcLowPass(double x,double tdres,double Fc, int n,double gain,int order)
+double OhcLowPass(double x,double tdres,double Fc, int n,double gain,int order, LOWPASSSTATE *st)
 {
-  static double ohc[4],ohcl[4];
+  double *ohc = st->y, *ohcl = st->yl;
 
   double c,c1LP,c2LP;
   int i,j;
@@ -881,9 +1191,9 @@ double OhcLowPass(double x,double tdres,double Fc, int n,double gain,int order)
 /* -------------------------------------------------------------------------------------------- */
 /* Get the output of the IHC Low Pass Filter  */
 
-double IhcLowPass(double x,double tdres,double Fc, int n,double gain,int order)
+double IhcLowPass(double x,double tdres,double Fc, int n,double gain,int order, LOWPASSSTATE *st)
 {
-  static double ihc[8],ihcl[8];
+  double *ihc = st->y, *ihcl = st->yl;
   
   double C,c1LP,c2LP;
   int i,j;
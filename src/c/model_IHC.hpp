@@ -0,0 +1,161 @@
+#ifndef _MODEL_IHC_HPP
+#define _MODEL_IHC_HPP
+
+/* MODEL_IHC.HPP header file
+ * Per-channel state of the IHC model (model_IHC.c).  The filters used to keep their
+ * memories in function-level static arrays, so only one IHCAN run could exist per
+ * process.  All of that state now lives in an IHCSTATE owned by the caller, which makes
+ * IHCAN reentrant: a filterbank can run one IHCSTATE per CF on as many threads as it likes.
+ */
+
+#include "complex.hpp"
+#include "profile.hpp"
+
+/* Signal-path C1 or parallel-path C2 chirp filter (five pole pairs) */
+typedef struct {
+    double input[12][4], output[12][4];
+    const char *errmsg;  /* non-NULL once the filter has become unstable */
+} CHIRPSTATE;
+
+/* The part of a chirp filter that depends only on (cf, tdres, taumax): the fixed pole
+ * offsets, the bilinear-transform frequency, the phase of the initial poles and zero that
+ * the moving zero keeps, and the gain normalization */
+typedef struct {
+    double sigma0, ipw, ipb, rpa, fs, CF, initphase, normgain;
+} CHIRPPLAN;
+
+/* The difference-equation coefficients of a chirp filter for one pole position: the zero
+ * terms fs-rzero, 2*rzero and fs+rzero, and the terms of the three distinct pole pairs
+ * (p[1], p[3] and p[5]; p[7] and p[9] repeat p[1] and p[5]) */
+typedef struct {
+    double A, B, Cc, D[3], E[3], T[3];
+} CHIRPCOEFS;
+
+/* Control-path wideband gammatone filter (up to third order) */
+typedef struct {
+    double phase;
+    COMPLEX gtf[4], gtfl[4];
+} WBGTSTATE;
+
+/* OHC or IHC lowpass filter (up to seventh order) */
+typedef struct {
+    double y[8], yl[8];
+} LOWPASSSTATE;
+
+/* Complete filter state of one IHC channel; IHCAN resets it at the start of a run */
+typedef struct {
+    CHIRPSTATE   c1, c2;
+    WBGTSTATE    wb;
+    LOWPASSSTATE ohc, ihc;
+    const char  *errmsg;  /* reason IHCAN failed, if it returned non-zero */
+} IHCSTATE;
+
+/* Run the IHC model for one CF.  Returns 0 on success; otherwise state->errmsg says why.
+ * If prof is not NULL, the stage times and buffers are added to it (see profile.hpp). */
+int IHCAN(double *px, double cf, int nrep, double tdres, int totalstim,
+          double cohc, double cihc, int species, IHCSTATE *state, double *ihcout, ANPROF *prof);
+
+/* The middle-ear filter.  It does not depend on CF, so a filterbank runs it once per
+ * stimulus and feeds its output to every channel (see IHCAN_bank); IHCAN and the stream
+ * below run their own. */
+typedef struct {
+    int    species;
+    double m11,m12,m13,m14,m15,m16,m21,m22,m23,m24,m25,m26,m31,m32,m33,m34,m35,m36,megainmax;
+    double px[2], mey1[2], mey2[2], mey3[2];  /* samples n-1 and n-2 */
+    int    n;           /* samples processed */
+} MIDDLEEAR;
+
+/* Put the filter for sampling interval tdres and species at sample 0 */
+void IHCAN_middle_ear_open(MIDDLEEAR *me, double tdres, int species);
+
+/* Filter the next n stimulus samples px (Pa) into y */
+void IHCAN_middle_ear_process(MIDDLEEAR *me, const double *px, int n, double *y);
+
+/* Filter a whole stimulus of totalstim samples into meout */
+void IHCAN_middle_ear(const double *px, double tdres, int totalstim, int species, double *meout);
+
+/* One period of IHCAN's output from the middle-ear output meout of the stimulus (totalstim
+ * samples) rather than the stimulus, without the path delay: IHCAN's output of nrep
+ * repetitions is 0 for its first IHCAN_delaypoint(cf, tdres) samples, then this period
+ * repeated.  The middle ear is linear, so callers that run one stimulus at several levels
+ * or CFs can filter it once and scale its output; callers that handle the repetitions
+ * themselves (SingleAN_periodic in model_Synapse_v2025a.hpp) need not store them. */
+int IHCAN_period(const double *meout, double cf, double tdres, int totalstim, double cohc, double cihc,
+                 int species, IHCSTATE *state, double *period, ANPROF *prof);
+
+/* The path delay of the IHC output in samples */
+int IHCAN_delaypoint(double cf, double tdres);
+
+/* Everything about a channel that depends only on (cf, tdres, cohc, species): the tuning
+ * of Get_tauwb and Get_taubm, the control-path filter at rest, the path delay, the C1
+ * filter's fixed part, and the C2 filter, whose poles never move.  IHCAN_plan keeps the
+ * plans it has made, so a channel that runs again (another call, level or repetition) does
+ * not recompute them, and the per-sample work of C1 is only what depends on its pole shift. */
+typedef struct {
+    double cf, tdres, cohc;
+    int    species, delaypoint;
+    double centerfreq, TauWBMax, TauWBMin, bmTaumax, bmTaumin, ratiobm, tauwb, wbgain;
+    CHIRPPLAN  c1, c2;
+    CHIRPCOEFS c2coefs;
+    int    c2status;    /* 0, or why the C2 filter is unstable (see ihcan_c2_path) */
+} IHCPLAN;
+
+/* Copy the plan of a channel to *plan, making it on first use */
+void IHCAN_plan(double cf, double tdres, double cohc, int species, IHCPLAN *plan);
+
+/* The per-sample part of a chirp filter: place the poles for p[1].x = px1 and the zero that
+ * keeps the initial phase of cp, and compute the coefficients k.  Returns 0, 1 if the poles
+ * are in the right-half plane or 2 if the zero is.  IHCAN_plan uses it for C2, IHCAN and
+ * IHCAN_bank for C1 on every sample. */
+int IHCAN_chirp_coefs(const CHIRPPLAN *cp, double px1, CHIRPCOEFS *k);
+
+/* A channel run one block of samples at a time.  Besides the filter memories it holds the
+ * channel's parameters, its middle-ear filter, the ring of control-path gains scheduled
+ * grdelay samples ahead and the delay line of the path delay, so its memory does not grow
+ * with the stimulus.  IHCAN runs the same code. */
+typedef struct {
+    double cf, tdres, cohc, cihc;
+    int    species, wborder;
+    double centerfreq, TauWBMax, TauWBMin, bmTaumax, bmTaumin, ratiobm, ohcasym, ihcasym;
+    IHCPLAN plan;
+    MIDDLEEAR me;
+    double tauwb, wbgain, lasttmpgain;
+    double *gain;       /* gain[m % ngain]: control-path gain scheduled for sample m, or 0 */
+    int    ngain;
+    double *delayline;  /* the last delaypoint undelayed outputs */
+    int    delaypoint;
+    int    n;           /* samples processed */
+    ANPROF *prof;       /* stage times are added here if not NULL; open sets it to NULL */
+    IHCSTATE st;
+} IHCSTREAM;
+
+/* Open a channel at sample 0.  Returns 0 on success; otherwise s->st.errmsg says why. */
+int  IHCAN_stream_open(IHCSTREAM *s, double cf, double tdres, double cohc, double cihc, int species);
+
+/* Run the next n stimulus samples, writing n IHC output samples.  Concatenated, the outputs
+ * are identical to those of IHCAN with nrep = 1.  Returns 0 on success; otherwise
+ * s->st.errmsg says why. */
+int  IHCAN_stream_process(IHCSTREAM *s, const double *px, int n, double *ihcout);
+
+void IHCAN_stream_close(IHCSTREAM *s);
+
+/* Run IHCAN for the nimp impairments (cohc[k], cihc[k]) of one stimulus and CF, writing
+ * impairment k to ihcout[k] (totalstim*nrep samples).  The middle ear and the C2 filter do
+ * not depend on the impairment, and the control path and C1 filter only on cohc, so they run
+ * once and once per distinct cohc, respectively; only the IHC transduction and lowpass run
+ * once per impairment.  Each output is identical to that of IHCAN.  Returns 0 on success;
+ * otherwise *errmsg says why. */
+int  IHCAN_sweep(const double *px, double cf, int nrep, double tdres, int totalstim, int nimp,
+                 const double *cohc, const double *cihc, int species, double **ihcout,
+                 const char **errmsg, ANPROF *prof);
+
+/* Tuning, delay and nonlinearity helpers of model_IHC.c, shared with ihc_filterbank.c */
+double Get_tauwb(double cf, int species, int order, double *taumax, double *taumin);
+double Get_taubm(double cf, int species, double taumax, double *bmTaumax, double *bmTaumin, double *ratio);
+double gain_groupdelay(double tdres, double centerfreq, double cf, double tau, int *grdelay);
+double delay_cat(double cf);
+double Boltzman(double x, double asym, double s0, double s1, double x1);
+double NLafterohc(double x, double taumin, double taumax, double asym);
+double NLogarithm(double x, double slope, double asym, double cf);
+
+#endif
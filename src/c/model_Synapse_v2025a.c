@@ -38,13 +38,28 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>      /* Added for MS Visual C++ compatability, by Ian Bruce, 1999 */
+#ifndef AN_NO_MEXFUNCTION
 #include <mex.h>
+#endif
 #include <time.h>
 /* #include <iostream.h> */
 
 #include "complex.hpp"
+#include "resample.hpp"
+#include "ffgn.hpp"
+#include "thread_pool.hpp"
+#include "pla_conv.hpp"
+#include "simd.hpp"
+#include "model_Synapse_v2025a.hpp"
+#ifndef AN_NO_MEXFUNCTION
+#include "fft.hpp"
+#include "mex_options.hpp"
+#include "mex_profile.hpp"
+#endif
 
 #define MAXSPIKES 1000000
+#define SYN_CHUNK 256   /* IHC samples per stage pass of the streaming synapse */
+#define AN_REP_BLOCK 65536  /* least samples per block of SingleAN (see single_an) */
 #ifndef TWOPI
 #define TWOPI 6.28318530717959
 #endif
@@ -57,6 +72,17 @@
 #define __min(a,b) (((a) < (b))? (a): (b))
 #endif
 
+#ifndef AN_NO_MEXFUNCTION
+/* Release the filter designs, FFT plans, noise spectra and PLA parameter files cached by the
+   native code, and stop the parked worker threads */
+static void clear_caches(void) {
+    resample_clear_cache();
+    ffGn_clear_cache();
+    fft_clear_cache();
+    pla_params_clear_cache();
+    tpool_shutdown();
+}
+
 /*
  * This function is the Mex "wrapper" that allows inputs to be passed from MATLAB to the C 
  * functions that implement the model. Once compiled, this function is available in MATLAB 
@@ -64,12 +90,15 @@
  */
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
     // Declare variables
-	double *px, *pxtmp, *meanrate, *varrate, *psth;
-	int    pxbins, lp, totalstim;
+	double *px, *pxtmp, *meanrate, *varrate, *psth, *trials;
+	int    pxbins, totalstim;
 	mwSize outsize[2];
+	SYNOPTS opts;
+	ANPROF prof;
+	const char *errmsg;
 
     // Declare function signature for SingleAN, which we use below
-	void SingleAN(
+	int SingleAN(
         double *,  // px
         double,    // cf
         int,       // nrep
@@ -78,24 +107,21 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
         double,    // fibertype
         double,    // noiseType
         double,    // implnt
-        double,    // sampFreq
-        double*,   // tau_slow
-        double*,   // w_slow
-        double*,   // tau_fast
-        double*,   // w_fast
-        int,       // n_process
+        const SYNOPTS *, // opts
         double *,  // meanrate (output)
         double *,  // varrate (output)
-        double *   // psth (output)
+        double *,  // psth (output)
+        double *,  // trials (output)
+        const char ** // errmsg (output)
     );
 	
 	// Verify that we have the appropriate number of arguments
-	if (nrhs != 7) {
-		mexErrMsgTxt("model_Synapse_2025a requires 7 input arguments!");
+	if (nrhs != 7 && nrhs != 8) {
+		mexErrMsgTxt("model_Synapse_2025a requires 7 input arguments (plus an optional opts struct)!");
 	}; 
 
-	if (nlhs != 3) {
-		mexErrMsgTxt("model_Synapse_2025a requires 3 output argument!");
+	if (nlhs < 3 || nlhs > 5) {
+		mexErrMsgTxt("model_Synapse_2025a requires 3 output arguments (plus optional per-trial spike counts and profile)!");
 	};
 	
 	// Get input pointers and de-reference or assign as needed
@@ -106,19 +132,18 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
     double fibertype = mxGetPr(prhs[4])[0];
     double noiseType = mxGetPr(prhs[5])[0];
     double implnt = mxGetPr(prhs[6])[0];
+	get_synapse_options((nrhs > 7) ? prhs[7] : NULL, &opts);
+	mexAtExit(clear_caches);
 	
 	/* Check with individual input arguments */
 	pxbins = mxGetN(prhs[0]);
 	if (pxbins==1)
 		mexErrMsgTxt("px must be a row vector\n");
 	
-	/* Calculate number of samples for total repetition time and allocate */
+	/* Calculate number of samples for total repetition time; SingleAN reads the first
+	   totalstim*nrep samples of the input in place */
 	totalstim = (int)floor(pxbins/nrep);    
-    px = (double*)mxCalloc(totalstim*nrep,sizeof(double)); 
-
-	/* Put stimulus waveform into pressure waveform */
-   	for (lp=0; lp<pxbins; lp++)
-			px[lp] = pxtmp[lp];
+	px = pxtmp;
 
 	/* Create an array for the return argument */
     outsize[0] = 1;
@@ -133,37 +158,22 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
     varrate = mxGetPr(plhs[1]);
     psth = mxGetPr(plhs[2]);
 
-    /* 
-     * ~ Parallel exponential PLA approximation ~
-     * Below, we set up the variables needed for the fast PLA approximation described in 
-     * Guest and Carney (2024) cited above. We hard-code the n_process value to be 14 to 
-     * match the optimized parameter set available in the paper. 
-     */
-    /* Fill tau vectors based on Equation 6 and use of 14 time constants */
-    double sampFreq = 10e3;  // synapse sampling rate (Hz)
-    double tau_slow[14];
-    double tau_fast[14];
-    for (int i = 0; i < 14; i++) {
-        tau_slow[i] = 5e-4 * pow(10.0, 1/exp(1.0) * i);
-        tau_fast[i] = 1e-1 * pow(10.0, 1/exp(1.0) * i);
+    /* Optional fourth output: the spike counts of each trial, ntrials x totalstim */
+    trials = NULL;
+    if (nlhs > 3) {
+        outsize[0] = opts.ntrials;
+        plhs[3] = mxCreateNumericArray(2, outsize, mxDOUBLE_CLASS, mxREAL);
+        trials = mxGetPr(plhs[3]);
+    }
+
+    /* Optional fifth output: the stage times (see mex_profile.hpp) */
+    prof_clear(&prof);
+    if (nlhs > 4) {
+        opts.prof = &prof;
     }
 
-    /* Fill w vectors based on Table 1 */
-    double w_slow[14] = {
-        1054.1349144510866, 235.42021095822022, 351.3091743124357, 99.00123234954474, 
-        55.18423650003196, 28.99454378212968, 6.556134147763605, 6.558380224204848, 
-        1.1576087874250394, 0.995488845827021, 0.3588672871386332, 0.1573449044190812, 
-        0.010428823220777147, 0.08773889583510958
-    };
-    double w_fast[14] = {
-        6.106637716398411, 1.1558964083697898, 1.3095958543425545, 0.785695677692722, 
-        0.21835528692662018, 0.10344785429373701, 0.08413927488982781, 0.001596356536824024, 
-        0.018886711336962816, 0.0008089617759213521, 0.002806098243601203, 0.0006529927704604911, 
-        3.13953727422695e-5, 0.0004490670084957763
-    };
-			
 	/* run the model */
-	SingleAN(
+	if (SingleAN(
 		px,
 		cf,
 		nrep,
@@ -172,176 +182,416 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
 		fibertype,
 		noiseType,
 		implnt,
-        sampFreq,
-        tau_slow,
-        w_slow,
-        tau_fast,
-        w_fast,
-        14,  // n_process hard-coded to 14
+        &opts,
 		meanrate,
 		varrate,
-		psth
-	);
+		psth,
+		trials,
+		&errmsg
+	)) mexErrMsgTxt(errmsg);
 
-	mxFree(px);
+	if (nlhs > 4)
+		plhs[4] = mex_profile(&prof);
 }
+#endif
 
-void SingleAN(
-    double *px, 
-    double cf, 
-    int nrep, 
-    double tdres, 
-    int totalstim, 
-    double fibertype, 
-    double noiseType, 
-    double implnt, 
-    double sampFreq, 
-    double* tau_slow,
-	double* w_slow,
-	double* tau_fast,
-	double* w_fast,
-	int n_process,
-    double *meanrate, 
-    double *varrate, 
-    double *psth
-) {	
-	/*variables for the signal-path, control-path and onward */
-	double *synouttmp,*sptime;
-
-	int    i,nspikes,ipst;
-	double I,spont;
-        
-    /* Declarations of the functions used in the program */
-	double Synapse(double *, double, double, int, int, double, double, double, double, double*, double*, double*, double*, int, double *);
-	int    SpikeGenerator(double *, double, int, int, double *);
-    
-    /* Allocate dynamic memory for the temporary variables */
-    synouttmp  = (double*)mxCalloc(totalstim*nrep,sizeof(double));
-    sptime  = (double*)mxCalloc((long) ceil(totalstim*tdres*nrep/0.00075),sizeof(double));  	
-	   
-    /* Spontaneous Rate of the fiber corresponding to Fibertype */    
-    if (fibertype==1) spont = 0.1;
-    if (fibertype==2) spont = 4.0;
-    if (fibertype==3) spont = 100.0;
-    
-    /*====== Run the synapse model ======*/    
-    I = Synapse(px, tdres, cf, totalstim, nrep, spont, noiseType, implnt, sampFreq, tau_slow, w_slow, tau_fast, w_fast, n_process, synouttmp);
-            
-    /* Wrapping up the unfolded (due to no. of repetitions) Synapse Output */
-    for(i = 0; i<I ; i++)
+void Synapse_default_options(SYNOPTS *opts) {
+    opts->resampleN = RESAMPLE_N_MATLAB;
+    opts->seed = rng_shuffle_seed();
+    opts->fiber = 0;
+    opts->ntrials = 1;
+    opts->nthreads = 0;
+    opts->pla = *pla_params_default();
+    opts->single = 0;
+    opts->indepreps = 0;
+    opts->neurogram = NULL;
+    opts->prof = NULL;
+}
+
+/* Fold count samples of a synapse output, starting at sample pos of its totalstim*nrep, into
+   the repetition average meanrate (totalstim samples) */
+static void an_fold(const double *synout, int count, long long pos, int totalstim, int nrep, double *meanrate)
+{
+    int i, ipst = (int) (pos % totalstim);
+
+    for(i = 0; i<count ; i++)
 	{       
-		ipst = (int) (fmod(i,totalstim));
-        meanrate[ipst] = meanrate[ipst] + synouttmp[i]/nrep;        
+        meanrate[ipst] = meanrate[ipst] + synout[i]/nrep;        
+        if (++ipst == totalstim) ipst = 0;
 	};
+}
+
+/* Turn the folded synapse output meanrate into the mean rate and rate variance */
+static void an_refractory(int totalstim, double *meanrate, double *varrate)
+{
+    int i;
+
     /* Synapse Output taking into account the Refractory Effects (Vannucci and Teich, 1978) */
     for(i = 0; i<totalstim ; i++)
 	{       
 		varrate[i] = meanrate[i]/pow((1+0.75e-3*meanrate[i]),3); /* estimated instananeous variance in the discharge rate */
         meanrate[i]    = meanrate[i]/(1+0.75e-3*meanrate[i]);  /* estimated instantaneous mean rate */     
 	};
-    /*======  Spike Generations ======*/
-    
-	nspikes = SpikeGenerator(synouttmp, tdres, totalstim, nrep, sptime);
-	for(i = 0; i < nspikes; i++)
-	{        
-		ipst = (int) (fmod(sptime[i],tdres*totalstim) / tdres);
-        psth[ipst] = psth[ipst] + 1;       
-	};
+}
 
-    /* Freeing dynamic memory allocated earlier */
+/* The spike trains of SingleAN, advanced one block of synapse output at a time: trial k has
+   its own generator and random stream, and the trials are split into nblock contiguous
+   blocks, each counting its spikes into its own PSTH */
+typedef struct {
+    const double *synout;   /* the current block of synapse output */
+    int      count;
+    double   tdres;
+    int      totalstim, ntrials, nblock;
+    SPIKESTATE *st;         /* ntrials generators ... */
+    RNG      *rng;          /* ... and their streams */
+    double   *blockpsth;    /* nblock partial PSTHs of totalstim bins */
+    double   *trials;       /* ntrials x totalstim per-trial PSTHs, or NULL */
+} SPIKESTREAMJOB;
 
-    mxFree(sptime); mxFree(synouttmp); 
+/* Task b steps the trials of block b through the current block of synapse output */
+static void spike_stream_task(void *arg, int b)
+{
+    SPIKESTREAMJOB *job = (SPIKESTREAMJOB *) arg;
+    double *psth = job->blockpsth + (size_t)b*job->totalstim;
+    int    first = (int) ((long long) b*job->ntrials/job->nblock);
+    int    last  = (int) ((long long) (b+1)*job->ntrials/job->nblock);
+    int    i, k, ipst;
 
-} /* End of the SingleAN function */
-/* -------------------------------------------------------------------------------------------- */
-/*  Synapse model: if the time resolution is not small enough, the concentration of
-   the immediate pool could be as low as negative, at this time there is an alert message
-   print out and the concentration is set at saturated level  */
-/* --------------------------------------------------------------------------------------------*/
-double Synapse(
-    double *ihcout, 
+    for (k = first; k < last; k++)
+        for (i = 0; i < job->count && !job->st[k].done; i++)
+            if (SpikeGenerator_step(&job->st[k], job->synout[i]))
+            {
+                ipst = (int) (fmod(job->st[k].sptime,job->tdres*job->totalstim) / job->tdres);
+                psth[ipst] = psth[ipst] + 1;
+                if (job->trials) job->trials[k + (size_t)ipst*job->ntrials] += 1;
+            }
+}
+
+static SYNSTREAM *syn_stream_open(double, double, int, double, double, double, const SYNOPTS *,
+                                  const double *, uint32_t, const char **);
+
+/* The repetitions of single_an_independent, run a wave of nslot at a time: slot j runs
+   repetition first+j into its own rate and PSTH, which are merged in repetition order */
+typedef struct {
+    const double *x;        /* the input of single_an */
+    int      xlen, delay;
+    double   cf, tdres, spont, noiseType, implnt;
+    int      totalstim, nrep, first;
+    SYNOPTS  opts;
+    double   *rate, *psth;  /* nslot x totalstim: the repetition's synapse output / nrep and spike counts */
+    size_t   **spikes;      /* per slot, the trials index k + bin*ntrials of each spike, if trials are kept */
+    size_t   *nspikes, *capspikes;
+    const char **errmsg;    /* one per slot */
+} REPJOB;
+
+/* Slot j runs repetition first+j from rest, one block of at most AN_REP_BLOCK samples at a
+   time: the synapse, with fresh fGn from noise stream first+j (frozen fGn is the same for
+   every repetition), and the spike generator of each trial */
+static void rep_task(void *arg, int j)
+{
+    REPJOB   *job = (REPJOB *) arg;
+    int      r = job->first + j, T = job->totalstim, ntrials = job->opts.ntrials;
+    int      block = __min(T, AN_REP_BLOCK), i, k, m, got, bin;
+    double   *rate = job->rate + (size_t)j*T, *psth = job->psth + (size_t)j*T, *in = NULL, *out;
+    size_t   *sp;
+    long long src = (long long) r*T, pos, fed;
+    SYNSTREAM *s;
+    SPIKESTATE *st = NULL;
+    RNG      *rng = NULL;
+
+    memset(rate, 0, T*sizeof(double));
+    memset(psth, 0, T*sizeof(double));
+    job->nspikes[j] = 0;
+    s = syn_stream_open(job->tdres, job->cf, T, job->spont, job->noiseType, job->implnt, &job->opts,
+                        NULL, (uint32_t) r, &job->errmsg[j]);
+    if (s == NULL)
+        return;
+    in  = (double*)malloc((2*(size_t)block + Synapse_stream_lag(s))*sizeof(double));
+    st  = (SPIKESTATE*)calloc(ntrials,sizeof(SPIKESTATE));
+    rng = (RNG*)calloc(ntrials,sizeof(RNG));
+    if (!in || !st || !rng)
+    {
+        job->errmsg[j] = "SingleAN: out of memory.\n";
+        goto cleanup;
+    }
+    out = in + block;
+
+    for (pos = 0, fed = 0; pos < T; pos += got)
+    {
+        /* Samples r*T+fed ... of the input, or, after the last block, the end of the stream */
+        if (fed < T)
+        {
+            m = (int) __min(block, T-fed);
+            for (i=0; i<m; i++)
+                in[i] = (src+fed+i < job->delay) ? 0 : job->x[(src+fed+i - job->delay) % job->xlen];
+            got = Synapse_stream_process(s, in, m, out);
+            fed += m;
+        }
+        else if (T-pos > block + Synapse_stream_lag(s))
+        {
+            job->errmsg[j] = "SingleAN: the synapse output lags more than Synapse_stream_lag.\n";
+            goto cleanup;
+        }
+        else
+            got = Synapse_stream_finish(s, out);
+        if (got == 0)
+            continue;
+
+        an_fold(out, got, pos, T, job->nrep, rate);
+        /* Trial k of repetition r draws from spike stream r*ntrials+k, so repetition 0 has
+           the spike trains of a single-repetition run */
+        for (k=0; k<ntrials; k++)
+        {
+            if (pos == 0)
+            {
+                rng_init(&rng[k], job->opts.seed, RNG_STREAM_SPIKES, job->opts.fiber, (uint32_t) (r*ntrials + k));
+                SpikeGenerator_init(&st[k], out[0], job->tdres, T * job->tdres, &rng[k]);
+            }
+            for (i=0; i<got && !st[k].done; i++)
+                if (SpikeGenerator_step(&st[k], out[i]))
+                {
+                    bin = (int) (fmod(st[k].sptime,job->tdres*T) / job->tdres);
+                    psth[bin] = psth[bin] + 1;
+                    if (job->spikes == NULL)
+                        continue;
+                    if (job->nspikes[j] == job->capspikes[j])
+                    {
+                        size_t cap = (job->capspikes[j] > 0) ? 2*job->capspikes[j] : 1024;
+                        if ((sp = (size_t*)realloc(job->spikes[j], cap*sizeof(size_t))) == NULL)
+                        {
+                            job->errmsg[j] = "SingleAN: out of memory.\n";
+                            goto cleanup;
+                        }
+                        job->spikes[j] = sp; job->capspikes[j] = cap;
+                    }
+                    job->spikes[j][job->nspikes[j]++] = k + (size_t)bin*ntrials;
+                }
+        }
+    }
+
+cleanup:
+    Synapse_stream_close(s);
+    free(rng); free(st); free(in);
+}
+
+/* single_an with opts->indepreps: every repetition starts from rest, as a run with nrep = 1
+   on its part of the input, with fresh fGn from its own noise stream (repetition r draws
+   stream r; frozen fGn is shared by all repetitions), and the repetitions run concurrently
+   on up to opts->nthreads threads.  Each slot keeps only its repetition's rate and PSTH,
+   and the spikes of each trial if those are asked for; they are merged in repetition
+   order, so the result does not depend on the number of threads. */
+static int single_an_independent(const double *x, int xlen, int delay, double cf, int nrep, double tdres,
+                                 int totalstim, double spont, double noiseType, double implnt,
+                                 const SYNOPTS *opts, double *meanrate, double *varrate, double *psth,
+                                 double *trials, const char **errmsg)
+{
+    REPJOB   job;
+    int      nslot, nrun, i, j;
+    size_t   n;
+    double   t, *rate, *slotpsth;
+
+    nslot = __min(nrep, (opts->nthreads > 0) ? opts->nthreads : tpool_nthreads_default());
+    job.x = x; job.xlen = xlen; job.delay = delay;
+    job.cf = cf; job.tdres = tdres; job.spont = spont; job.noiseType = noiseType; job.implnt = implnt;
+    job.totalstim = totalstim; job.nrep = nrep;
+    job.opts = *opts;
+    job.opts.prof = (nslot == 1) ? opts->prof : NULL;  /* the profile is not for concurrent use */
+    job.rate      = (double*)calloc(2*(size_t)nslot*totalstim,sizeof(double));
+    job.psth      = job.rate + (size_t)nslot*totalstim;
+    job.spikes    = trials ? (size_t**)calloc(nslot,sizeof(size_t*)) : NULL;
+    job.nspikes   = (size_t*)calloc(2*(size_t)nslot,sizeof(size_t));
+    job.capspikes = job.nspikes + nslot;
+    job.errmsg    = (const char**)calloc(nslot,sizeof(const char*));
+    *errmsg = NULL;
+    if (!job.rate || (trials && !job.spikes) || !job.nspikes || !job.errmsg)
+        *errmsg = "SingleAN: out of memory.\n";
+    else if (opts->prof)
+        opts->prof->bytes += 2*(double) nslot*totalstim*sizeof(double);
+
+    for (job.first = 0; job.first < nrep && *errmsg == NULL; job.first += nslot)
+    {
+        nrun = __min(nslot, nrep - job.first);
+        tpool_run(nrun, nrun, rep_task, &job);
+
+        /* Merge the wave in repetition order */
+        t = prof_start(opts->prof);
+        for (j = 0; j < nrun; j++)
+        {
+            if ((*errmsg = job.errmsg[j]) != NULL)
+                break;
+            rate     = job.rate + (size_t)j*totalstim;
+            slotpsth = job.psth + (size_t)j*totalstim;
+            for (i = 0; i < totalstim; i++)
+            {
+                meanrate[i] = meanrate[i] + rate[i];
+                psth[i]     = psth[i] + slotpsth[i];
+            }
+            if (trials)
+                for (n = 0; n < job.nspikes[j]; n++)
+                    trials[job.spikes[j][n]] += 1;
+        }
+        prof_lap(opts->prof, PROF_RATES, t, 0);
+    }
+    if (*errmsg == NULL)
+        an_refractory(totalstim, meanrate, varrate);
+
+    if (job.spikes)
+        for (j = 0; j < nslot; j++)
+            free(job.spikes[j]);
+    free(job.errmsg); free(job.nspikes); free(job.spikes); free(job.rate);
+    return (*errmsg != NULL);
+}
+
+/* SingleAN on the IHC output whose sample i (of totalstim*nrep) is 0 for i < delay and
+   x[(i-delay) % xlen] otherwise: x itself for xlen = totalstim*nrep and delay = 0, or nrep
+   repetitions of one period.  The repetitions are never stored: the IHC output is fed to
+   the streaming synapse and its output folded into the rates and fed to the spike
+   generators one block of AN_REP_BLOCK samples (or one period, if longer) at a time. */
+static int single_an(const double *x, int xlen, int delay, double cf, int nrep, double tdres,
+                     int totalstim, double fibertype, double noiseType, double implnt,
+                     const SYNOPTS *opts, double *meanrate, double *varrate, double *psth,
+                     double *trials, const char **errmsg)
+{
+	double     *in, *out, spont, t;
+	long long  n = (long long) totalstim*nrep, pos, fed;
+	int        i, k, m, got, block, lag, idx;
+	SYNSTREAM  *s = NULL;
+	SPIKESTREAMJOB spk;
+
+    /* Spontaneous Rate of the fiber corresponding to Fibertype */    
+    if (fibertype==1) spont = 0.1;
+    if (fibertype==2) spont = 4.0;
+    if (fibertype==3) spont = 100.0;
+    if (opts->indepreps && nrep > 1)
+        return single_an_independent(x, xlen, delay, cf, nrep, tdres, totalstim, spont, noiseType,
+                                     implnt, opts, meanrate, varrate, psth, trials, errmsg);
+
+    /*====== Run the synapse model ======*/    
+    in = NULL; spk.st = NULL; spk.rng = NULL; spk.blockpsth = NULL;
+    s = Synapse_stream_open(tdres, cf, (int) n, spont, noiseType, implnt, opts, errmsg);
+    if (s == NULL)
+        goto cleanup;
+
+    /* Allocate dynamic memory for the temporary variables: one block of IHC and synapse
+       output (the latter with room for the lag that Synapse_stream_finish flushes), one
+       generator per trial and one PSTH per block of trials */
+    block = (int) __min(n, __max(totalstim, AN_REP_BLOCK));
+    lag   = Synapse_stream_lag(s);
+    spk.ntrials   = opts->ntrials;
+    spk.nblock    = __min(opts->ntrials, (opts->nthreads > 0) ? opts->nthreads : tpool_nthreads_default());
+    spk.tdres     = tdres; spk.totalstim = totalstim; spk.trials = trials;
+    in            = (double*)calloc(2*(size_t)block + lag,sizeof(double));
+    out           = in + block;
+    spk.st        = (SPIKESTATE*)calloc(spk.ntrials,sizeof(SPIKESTATE));
+    spk.rng       = (RNG*)calloc(spk.ntrials,sizeof(RNG));
+    spk.blockpsth = (double*)calloc((size_t)spk.nblock*totalstim,sizeof(double));
+    *errmsg = "SingleAN: out of memory.\n";
+    if (!in || !spk.st || !spk.rng || !spk.blockpsth)
+        goto cleanup;
+    if (opts->prof)
+        opts->prof->bytes += (2*(double) block + lag + (double) spk.nblock*totalstim)*sizeof(double)
+                             + (double) spk.ntrials*(sizeof(SPIKESTATE)+sizeof(RNG));
+
+    idx = 0;  /* x index of the next sample from delay on */
+    for (pos = 0, fed = 0; pos < n; pos += got)
+    {
+        /* The next block of IHC output, or, after the last one, the end of the stream */
+        if (fed < n)
+        {
+            m = (int) __min(block, n-fed);
+            if (delay == 0 && xlen == n)
+                got = Synapse_stream_process(s, x+fed, m, out);
+            else
+            {
+                for (i=0; i<m; i++)
+                {
+                    in[i] = (fed+i < delay) ? 0 : x[idx];
+                    if (fed+i >= delay && ++idx == xlen) idx = 0;
+                }
+                got = Synapse_stream_process(s, in, m, out);
+            }
+            fed += m;
+        }
+        else
+        {
+            if (n-pos > block + lag)
+            {
+                *errmsg = "SingleAN: the synapse output lags more than Synapse_stream_lag.\n";
+                goto cleanup;
+            }
+            got = Synapse_stream_finish(s, out);
+        }
+
+        t = prof_start(opts->prof);
+        an_fold(out, got, pos, totalstim, nrep, meanrate);
+        t = prof_lap(opts->prof, PROF_RATES, t, pos == 0);
+        /*======  Spike Generations ======*/
+        /* Trial k draws from stream (seed, spikes, fiber, k), so the spike trains depend on
+           neither the number of threads nor the number of trials before them */
+        if (pos == 0 && got > 0)
+            for (k = 0; k < spk.ntrials; k++)
+            {
+                rng_init(&spk.rng[k], opts->seed, RNG_STREAM_SPIKES, opts->fiber, (uint32_t) k);
+                SpikeGenerator_init(&spk.st[k], out[0], tdres, totalstim * tdres * nrep, &spk.rng[k]);
+            }
+        spk.synout = out; spk.count = got;
+        if (got > 0)
+            tpool_run(spk.nblock, spk.nblock, spike_stream_task, &spk);
+        prof_lap(opts->prof, PROF_SPIKES, t, (pos == 0) ? spk.ntrials : 0);
+    }
+    an_refractory(totalstim, meanrate, varrate);
+    for (k = 0; k < spk.nblock; k++)
+        for (i = 0; i < totalstim; i++)
+            psth[i] += spk.blockpsth[(size_t)k*totalstim + i];
+    *errmsg = NULL;
+
+    /* Freeing dynamic memory allocated earlier */
+cleanup:
+    Synapse_stream_close(s);
+    free(spk.blockpsth); free(spk.rng); free(spk.st); free(in);
+    return (*errmsg != NULL);
+}
+
+int SingleAN(
+    double *px, 
+    double cf, 
+    int nrep, 
     double tdres, 
-	double cf, 
     int totalstim, 
-    int nrep, 
-    double spont, 
+    double fibertype, 
     double noiseType, 
     double implnt, 
-    double sampFreq,
-	double* tau_slow,
-	double* w_slow,
-	double* tau_fast,
-	double* w_fast,
-	int n_process,
-    double *synouttmp
-) {    
-    /* Initalize Variables */     
-    int z, b;
-    int resamp = (int) ceil(1/(tdres*sampFreq));
-    double incr = 0.0; int delaypoint = (int) floor(7500/(cf/1e3));   
-    
-    double alpha1, beta1, I1, alpha2, beta2, I2, binwidth, I_slow, I_fast;
-    int    k,j,indx,i;    
-    double synstrength,synslope,CI,CL,PG,CG,VL,PL,VI;
+    const SYNOPTS *opts,
+    double *meanrate, 
+    double *varrate, 
+    double *psth,
+    double *trials,
+    const char **errmsg
+) {	
+    return single_an(px, totalstim*nrep, 0, cf, nrep, tdres, totalstim, fibertype, noiseType,
+                     implnt, opts, meanrate, varrate, psth, trials, errmsg);
+} /* End of the SingleAN function */
+
+int SingleAN_periodic(const double *period, int delaypoint, double cf, int nrep, double tdres,
+                      int totalstim, double fibertype, double noiseType, double implnt,
+                      const SYNOPTS *opts, double *meanrate, double *varrate, double *psth,
+                      double *trials, const char **errmsg)
+{
+    return single_an(period, totalstim, delaypoint, cf, nrep, tdres, totalstim, fibertype,
+                     noiseType, implnt, opts, meanrate, varrate, psth, trials, errmsg);
+}
+/* Parameters and state of the exponential adaptation at the IHC-synapse junction */
+typedef struct {
+    double synstrength, synslope, CI, CL, PG, CG, VL, PL, VI;
+} EXPADAPT;
+
+/* Fill the parameters of a fiber and put the adaptation at rest */
+static void exp_adapt_init(EXPADAPT *e, double cf, double spont, double implnt)
+{
 	double cf_factor,PImax,kslope,Ass,Asp,TauR,TauST,Ar_Ast,PTS,Aon,AR,AST,Prest,gamma1,gamma2,k1,k2;
-	double VI0,VI1,alpha,beta,theta1,theta2,theta3,vsat,tmpst,tmp,PPI,CIlast,temp;
-            
-    double *sout1, *sout2, *synSampOut, *powerLawIn, *exponOut, *TmpSyn;            
-    double *m1, *m2, *m3, *m4, *m5;
-	double *n1, *n2, *n3;
-    
-    mxArray	*randInputArray[6], *randOutputArray[1];
-    double *randNums;
-    
-    mxArray	*IhcInputArray[3], *IhcOutputArray[1];
-    double *sampIHC, *ihcDims;	  
-        
-    exponOut = (double*)mxCalloc((long) ceil(totalstim*nrep),sizeof(double));
-    powerLawIn = (double*)mxCalloc((long) ceil(totalstim*nrep+3*delaypoint),sizeof(double));
-    sout1 = (double*)mxCalloc((long) ceil((totalstim*nrep+2*delaypoint)*tdres*sampFreq),sizeof(double));
-    sout2 = (double*)mxCalloc((long) ceil((totalstim*nrep+2*delaypoint)*tdres*sampFreq),sizeof(double));
-    synSampOut  = (double*)mxCalloc((long) ceil((totalstim*nrep+2*delaypoint)*tdres*sampFreq),sizeof(double));
-    TmpSyn  = (double*)mxCalloc((long) ceil(totalstim*nrep+2*delaypoint),sizeof(double));
-      
-    m1 = (double*)mxCalloc((long) ceil((totalstim*nrep+2*delaypoint)*tdres*sampFreq),sizeof(double));
-    m2 = (double*)mxCalloc((long) ceil((totalstim*nrep+2*delaypoint)*tdres*sampFreq),sizeof(double));
-    m3  = (double*)mxCalloc((long) ceil((totalstim*nrep+2*delaypoint)*tdres*sampFreq),sizeof(double)); 
-    m4 = (double*)mxCalloc((long) ceil((totalstim*nrep+2*delaypoint)*tdres*sampFreq),sizeof(double));
-    m5  = (double*)mxCalloc((long) ceil((totalstim*nrep+2*delaypoint)*tdres*sampFreq),sizeof(double)); 
-    
-    n1 = (double*)mxCalloc((long) ceil((totalstim*nrep+2*delaypoint)*tdres*sampFreq),sizeof(double));
-    n2 = (double*)mxCalloc((long) ceil((totalstim*nrep+2*delaypoint)*tdres*sampFreq),sizeof(double));
-    n3 = (double*)mxCalloc((long) ceil((totalstim*nrep+2*delaypoint)*tdres*sampFreq),sizeof(double));    
-	
-    /*----------------------------------------------------------*/    
-    /*------- Parameters of the Power-law function -------------*/
-    /*----------------------------------------------------------*/ 
-    binwidth = 1/sampFreq;
-    alpha1 = 2.5e-6*100e3; beta1 = 5e-4; I1 = 0;
-    alpha2 = 1e-2*100e3; beta2 = 1e-1; I2 = 0;
-
-    /*----------------------------------------------------------*/    
-    /*------- Generating a random sequence ---------------------*/
-    /*----------------------------------------------------------*/ 
-    randInputArray[0] = mxCreateDoubleMatrix(1, 1, mxREAL);
-    *mxGetPr(randInputArray[0])= ceil((totalstim*nrep+2*delaypoint)*tdres*sampFreq);
-    randInputArray[1] = mxCreateDoubleMatrix(1, 1, mxREAL);
-    *mxGetPr(randInputArray[1])= 1/sampFreq;
-    randInputArray[2] = mxCreateDoubleMatrix(1, 1, mxREAL);
-    *mxGetPr(randInputArray[2])= 0.9; /* Hurst index */
-    randInputArray[3] = mxCreateDoubleMatrix(1, 1, mxREAL);
-    *mxGetPr(randInputArray[3])= noiseType; /* fixed or variable fGn */
-    randInputArray[4] = mxCreateDoubleMatrix(1, 1, mxREAL);
-    *mxGetPr(randInputArray[4])= spont; /* high, medium, or low */
-	 randInputArray[5] = mxCreateDoubleMatrix(1, 1, mxREAL);
-    *mxGetPr(randInputArray[5]) = 2014; /* model version 2014 */
-            
-    mexCallMATLAB(1, randOutputArray, 6, randInputArray, "ffGn_rochester");
-    randNums = mxGetPr(randOutputArray[0]);      
-
-    /*----------------------------------------------------------*/
-    /*----- Double Exponential Adaptation ----------------------*/
-    /*----------------------------------------------------------*/    
+	double VI0,VI1,alpha,beta,theta1,theta2,theta3,vsat,tmpst;
+    double synstrength,synslope,CI,CL,PG,CG,VL,PL,VI;
+
        if (spont==100) cf_factor = __min(800,pow(10,0.29*cf/1e3 + 0.7));
        if (spont==4)   cf_factor = __min(50,2.5e-4*cf*4+0.2);
        if (spont==0.1) cf_factor = __min(1.0,2.5e-4*cf*0.1+0.15);              
@@ -390,162 +640,717 @@ double Synapse(
        if(tmpst<400) synstrength = log(exp(tmpst)-1);
        else synstrength = tmpst;
        synslope = Prest/log(2)*synstrength;
-       
-       k = 0;     
-       for (indx=0; indx<totalstim*nrep; ++indx)
-       {
-            tmp = synstrength*(ihcout[indx]);
-            if(tmp<400) tmp = log(1+exp(tmp));
-            PPI = synslope/synstrength*tmp;           
+
+       e->synstrength = synstrength; e->synslope = synslope;
+       e->CI = CI; e->CL = CL; e->PG = PG; e->CG = CG; e->VL = VL; e->PL = PL; e->VI = VI;
+}
+
+/* Advance the adaptation by one IHC output sample and return its output */
+static double exp_adapt_step(EXPADAPT *e, double ihcout, double tdres)
+{
+    double tmp, PPI, CIlast, temp;
+
+    tmp = e->synstrength*(ihcout);
+    if(tmp<400) tmp = log(1+exp(tmp));
+    PPI = e->synslope/e->synstrength*tmp;           
          
-            CIlast = CI; 
-            CI = CI + (tdres/VI)*(-PPI*CI + PL*(CL-CI));
-            CL = CL + (tdres/VL)*(-PL*(CL - CIlast) + PG*(CG - CL));
-            if(CI<0)
-            {
-                temp = 1/PG+1/PL+1/PPI;
-                CI = CG/(PPI*temp);
-                CL = CI*(PPI+PL)/PL;
-            };
-            exponOut[k] = CI*PPI;
-            k=k+1;
-        }                 
-        for (k=0; k<delaypoint; k++)
-			powerLawIn[k] = exponOut[0];    
-        for (k=delaypoint; k<totalstim*nrep+delaypoint; k++)
-			powerLawIn[k] = exponOut[k-delaypoint];
-        for (k=totalstim*nrep+delaypoint; k<totalstim*nrep+3*delaypoint; k++)
-			powerLawIn[k] = powerLawIn[k-1];         
-   /*----------------------------------------------------------*/ 
-   /*------ Downsampling to sampFreq (Low) sampling rate ------*/   
-   /*----------------------------------------------------------*/    
-    IhcInputArray[0] = mxCreateDoubleMatrix(1, k, mxREAL);
-    ihcDims = mxGetPr(IhcInputArray[0]);
-    for (i=0;i<k;++i)
-        ihcDims[i] = powerLawIn[i];    
-    IhcInputArray[1] = mxCreateDoubleMatrix(1, 1, mxREAL);
-    *mxGetPr(IhcInputArray[1])= 1;    
-    IhcInputArray[2] = mxCreateDoubleMatrix(1, 1, mxREAL);
-    *mxGetPr(IhcInputArray[2])= resamp;    
-    mexCallMATLAB(1, IhcOutputArray, 3, IhcInputArray, "resample");
-    sampIHC = mxGetPr(IhcOutputArray[0]);
-    
-    mxFree(powerLawIn); mxFree(exponOut);
-   /*----------------------------------------------------------*/
-   /*----- Running Power-law Adaptation -----------------------*/     
-   /*----------------------------------------------------------*/
-    /* Declare array types we need for PLA approximation system */
-    double E_slow[n_process], E_fast[n_process], D_slow[n_process], D_fast[n_process];
-
-    /* Calculate decay coefficients for PLA approximation given specified taus */
-	for (int p = 0; p < n_process; p++) {
-		D_slow[p] = 1 - exp(-1/sampFreq / tau_slow[p]);
-		D_fast[p] = 1 - exp(-1/sampFreq / tau_fast[p]);
+    CIlast = e->CI; 
+    e->CI = e->CI + (tdres/e->VI)*(-PPI*e->CI + e->PL*(e->CL-e->CI));
+    e->CL = e->CL + (tdres/e->VL)*(-e->PL*(e->CL - CIlast) + e->PG*(e->CG - e->CL));
+    if(e->CI<0)
+    {
+        temp = 1/e->PG+1/e->PL+1/PPI;
+        e->CI = e->CG/(PPI*temp);
+        e->CL = e->CI*(PPI+e->PL)/e->PL;
+    };
+    return e->CI*PPI;
+}
+
+/* -------------------------------------------------------------------------------------------- */
+/*  Synapse model: if the time resolution is not small enough, the concentration of
+   the immediate pool could be as low as negative, at this time there is an alert message
+   print out and the concentration is set at saturated level  */
+/* --------------------------------------------------------------------------------------------*/
+double Synapse(
+    double *ihcout, 
+    double tdres, 
+	double cf, 
+    int totalstim, 
+    int nrep, 
+    double spont, 
+    double noiseType, 
+    double implnt, 
+    const SYNOPTS *opts,
+    double *synouttmp,
+    const char **errmsg
+) {    
+    SYNSTREAM *s;
+    int m;
+
+    /* The exponential adaptation, decimation to sampFreq, power-law adaptation and
+       upsampling run in the streaming kernel below, a block of samples at a time: each stage
+       keeps only the few samples of history it needs, and synouttmp is the only array of
+       the stimulus's length (besides the fGn at sampFreq and, for implnt 1, the history of
+       the power-law adaptation).  The repetitions are one stream of totalstim*nrep samples. */
+    s = Synapse_stream_open(tdres, cf, totalstim*nrep, spont, noiseType, implnt, opts, errmsg);
+    if (s == NULL) return(-1);
+    m = Synapse_stream_process(s, ihcout, totalstim*nrep, synouttmp);
+    Synapse_stream_finish(s, synouttmp+m);
+    Synapse_stream_close(s);
+    *errmsg = NULL;
+    return((long) ceil(totalstim*nrep));
+}    
+/* ------------------------------------------------------------------------------------ */
+/* Streaming synapse: the stages of Synapse run a block of SYN_CHUNK samples at a time,
+   keeping only the history each of them needs (see model_Synapse_v2025a.hpp) */
+
+struct SYNSTREAM {
+    double   tdres, implnt, sampFreq, binwidth;
+    int      totalstim, delaypoint, resamp, n_process;
+    int      nvec;          /* n_process rounded up to whole vectors */
+    int      nloop;         /* synapse-rate samples of the power-law adaptation */
+    /* exponential adaptation */
+    EXPADAPT ea;
+    int      nin;           /* IHC samples consumed */
+    double   lastexp;       /* its latest output, repeated to pad the end */
+    /* decimation to sampFreq */
+    RSSTREAM *rs;
+    double   *dbuf;         /* decimator outputs of one block, SYN_CHUNK*maxout */
+    double   *pbuf;         /* ... and their power-law adaptation outputs */
+    double   *randNums;     /* fGn of the whole duration */
+    /* power-law adaptation */
+    int      n;             /* synapse-rate samples done */
+    double   alpha1, beta1, I1, alpha2, beta2, I2, I_slow, I_fast;
+    double   sout1[2], sout2[2], m[5][2], nn[3][2];   /* samples n-1 and n-2 (implnt 0) */
+    PLACONV  *pc;                                     /* exact sums (implnt 1) */
+    double   *E_slow, *E_fast, *A_slow, *A_fast, *w_slow, *w_fast;  /* implnt 2, A = 1-D */
+    /* linear interpolation back to 1/tdres */
+    double   lastsyn;       /* synapse-rate output n-1 */
+    int      nout;          /* output samples produced */
+    double   *queue;        /* produced but not yet returned, a ring */
+    int      qcap, qhead, qlen;
+    double   *out;          /* caller's buffer during Synapse_stream_process */
+    int      nwritten, outcap;
+    ANPROF   *prof;         /* opts->prof */
+};
+
+/* Hand one output sample to the caller, or queue it if the caller's buffer is full */
+static void syn_stream_emit(SYNSTREAM *s, double v)
+{
+    if (s->qlen == 0 && s->nwritten < s->outcap)
+        s->out[s->nwritten++] = v;
+    else
+        s->queue[(s->qhead + s->qlen++) % s->qcap] = v;
+    s->nout++;
+}
+
+/* Update the parallel exponential processes that approximate the power-law adaptation
+   (implnt 2) and their sums I_slow and I_fast, AN_LANES processes per instruction.  The
+   states start at zero, so the first sample needs no special case, and the padding
+   processes (w = 0, A = 0) stay at zero. */
+static void pla_exp_step(SYNSTREAM *s, double sout1, double sout2)
+{
+    vreal x1 = vset1(sout1), x2 = vset1(sout2), I1 = vzero(), I2 = vzero(), e1, e2;
+    int   i;
+
+    for (i = 0; i < s->nvec; i += AN_LANES) {
+        e1 = vfmadd(vload(s->A_slow+i), vload(s->E_slow+i), vmul(vload(s->w_slow+i), x1));
+        e2 = vfmadd(vload(s->A_fast+i), vload(s->E_fast+i), vmul(vload(s->w_fast+i), x2));
+        vstore(s->E_slow+i, e1);
+        vstore(s->E_fast+i, e2);
+        I1 = vadd(I1, e1);
+        I2 = vadd(I2, e2);
+    }
+    s->I_slow = vhsum(I1);
+    s->I_fast = vhsum(I2);
+}
+
+/* Power-law adaptation of synapse-rate sample s->n; returns its output */
+static double syn_stream_pla(SYNSTREAM *s, double sampIHC)
+{
+    double sout1, sout2, randNum = s->randNums[s->n];
+    double m1, m2, m3, m4, m5, n1, n2, n3;
+    int    k = s->n;
+
+    if (s->implnt == 0) {
+        sout1 = __max( 0, sampIHC + randNum- s->alpha1*s->I1); 
+        sout2 = __max( 0, sampIHC - s->alpha2*s->I2); 
+        if (k==0)
+        {
+            n1 = 1.0e-3*sout2;
+            n2 = n1; n3 = n2;
+        }
+        else if (k==1)
+        {
+            n1 = 1.992127932802320*s->nn[0][0]+ 1.0e-3*(sout2 - 0.994466986569624*s->sout2[0]);
+            n2 = 1.999195329360981*s->nn[1][0]+ n1 - 1.997855276593802*s->nn[0][0];
+            n3 = -0.798261718183851*s->nn[2][0]+ n2 + 0.798261718184977*s->nn[1][0];
+        }
+        else
+        {			
+            n1 = 1.992127932802320*s->nn[0][0] - 0.992140616993846*s->nn[0][1]+ 1.0e-3*(sout2 - 0.994466986569624*s->sout2[0] + 0.000000000002347*s->sout2[1]);
+            n2 = 1.999195329360981*s->nn[1][0] - 0.999195402928777*s->nn[1][1]+n1 - 1.997855276593802*s->nn[0][0] + 0.997855827934345*s->nn[0][1];
+            n3 =-0.798261718183851*s->nn[2][0] - 0.199131619873480*s->nn[2][1]+n2 + 0.798261718184977*s->nn[1][0] + 0.199131619874064*s->nn[1][1];
+        }   
+        s->I2 = n3;       
+
+        if (k==0)
+        {
+            m1 = 0.2*sout1;
+            m2 = m1;	m3 = m2;			
+            m4 = m3;	m5 = m4;
+        }
+        else if (k==1)
+        {
+            m1 = 0.491115852967412*s->m[0][0] + 0.2*(sout1 - 0.173492003319319*s->sout1[0]);
+            m2 = 1.084520302502860*s->m[1][0] + m1 - 0.803462163297112*s->m[0][0];
+            m3 = 1.588427084535629*s->m[2][0] + m2 - 1.416084732997016*s->m[1][0];
+            m4 = 1.886287488516458*s->m[3][0] + m3 - 1.830362725074550*s->m[2][0];
+            m5 = 1.989549282714008*s->m[4][0] + m4 - 1.983165053215032*s->m[3][0];
+        }        
+        else
+        {
+            m1 = 0.491115852967412*s->m[0][0] - 0.055050209956838*s->m[0][1]+ 0.2*(sout1- 0.173492003319319*s->sout1[0]+ 0.000000172983796*s->sout1[1]);
+            m2 = 1.084520302502860*s->m[1][0] - 0.288760329320566*s->m[1][1] + m1 - 0.803462163297112*s->m[0][0] + 0.154962026341513*s->m[0][1];
+            m3 = 1.588427084535629*s->m[2][0] - 0.628138993662508*s->m[2][1] + m2 - 1.416084732997016*s->m[1][0] + 0.496615555008723*s->m[1][1];
+            m4 = 1.886287488516458*s->m[3][0] - 0.888972875389923*s->m[3][1] + m3 - 1.830362725074550*s->m[2][0] + 0.836399964176882*s->m[2][1];
+            m5 = 1.989549282714008*s->m[4][0] - 0.989558985673023*s->m[4][1] + m4 - 1.983165053215032*s->m[3][0] + 0.983193027347456*s->m[3][1];
+        }   
+        s->I1 = m5; 
+
+        s->nn[0][1] = s->nn[0][0]; s->nn[0][0] = n1;
+        s->nn[1][1] = s->nn[1][0]; s->nn[1][0] = n2;
+        s->nn[2][1] = s->nn[2][0]; s->nn[2][0] = n3;
+        s->m[0][1] = s->m[0][0]; s->m[0][0] = m1;
+        s->m[1][1] = s->m[1][0]; s->m[1][0] = m2;
+        s->m[2][1] = s->m[2][0]; s->m[2][0] = m3;
+        s->m[3][1] = s->m[3][0]; s->m[3][0] = m4;
+        s->m[4][1] = s->m[4][0]; s->m[4][0] = m5;
+    } else if (s->implnt == 1) {
+        sout1 = __max( 0, sampIHC + randNum- s->alpha1*s->I1); 
+        sout2 = __max( 0, sampIHC - s->alpha2*s->I2); 
+        /* I1 and I2 are the full sums over all past samples, by online block convolution
+           (see pla_conv.hpp) */
+        pla_conv_push(s->pc, sout1, sout2, &s->I1, &s->I2);
+    } else {
+        sout1 = __max(0, sampIHC + randNum - s->alpha1/s->sampFreq*s->I_slow);
+        sout2 = __max(0, sampIHC - s->alpha2/s->sampFreq*s->I_fast);
+        pla_exp_step(s, sout1, sout2);
+    }
+    s->sout1[1] = s->sout1[0]; s->sout1[0] = sout1;
+    s->sout2[1] = s->sout2[0]; s->sout2[0] = sout2;
+    s->n++;
+    return sout1 + sout2;
+}
+
+/* Interpolate samples (k-1)*resamp ... k*resamp-1 at 1/tdres, the interval that ends with
+   synapse-rate output k; the output is delayed by delaypoint samples against them */
+static void syn_stream_interpolate(SYNSTREAM *s, int k, double synSampOut)
+{
+    double incr;
+    int    b, idx;
+
+    if (k > 0)
+    {
+        incr = (synSampOut-s->lastsyn)/s->resamp;
+        for (b=0; b<s->resamp; ++b)
+        {
+            idx = (k-1)*s->resamp + b - s->delaypoint;
+            if (idx >= 0 && idx < s->totalstim)
+                syn_stream_emit(s, s->lastsyn + b*incr);
+        }
+    }
+    s->lastsyn = synSampOut;
+}
+
+/* Run count <= SYN_CHUNK outputs of the exponential adaptation through the decimator, the
+   power-law adaptation and the interpolation.  Each stage only feeds the next, so each runs
+   over the whole block in turn, with the results of running them sample by sample, and the
+   profile's clock is read once per stage. */
+static void syn_stream_block(SYNSTREAM *s, const double *powerLawIn, int count)
+{
+    int    i, j, ny, nd = 0, k0 = s->n, nout0 = s->nout;
+    double t = prof_start(s->prof);
+
+    for (i=0; i<count; i++)
+    {
+        ny = resample_stream_push(s->rs, powerLawIn[i], s->dbuf+nd);
+        for (j=0; j<ny; j++)
+            if (k0+nd < s->nloop)
+                nd++;
+    }
+    t = prof_lap(s->prof, PROF_DECIMATION, t, count);
+    for (j=0; j<nd; j++)
+        s->pbuf[j] = syn_stream_pla(s, s->dbuf[j]);
+    t = prof_lap(s->prof, PROF_PLA, t, nd);
+    for (j=0; j<nd; j++)
+        syn_stream_interpolate(s, k0+j, s->pbuf[j]);
+    prof_lap(s->prof, PROF_INTERPOLATION, t, s->nout-nout0);
+}
+
+/* Run count copies of the value v through syn_stream_block */
+static void syn_stream_repeat(SYNSTREAM *s, double v, int count)
+{
+    double x[SYN_CHUNK];
+    int    i, m;
+
+    for (i=0; i<SYN_CHUNK; i++)
+        x[i] = v;
+    for (; count>0; count-=m)
+    {
+        m = __min(count, SYN_CHUNK);
+        syn_stream_block(s, x, m);
+    }
+}
+
+/* The sizes of a stream that follow from its sampling intervals, CF and length */
+static void syn_stream_sizes(SYNSTREAM *s, double tdres, double cf, int totalstim, double sampFreq)
+{
+    s->tdres = tdres; s->sampFreq = sampFreq; s->totalstim = totalstim;
+    s->resamp = (int) ceil(1/(tdres*sampFreq));
+    s->delaypoint = (int) floor(7500/(cf/1e3));
+    s->nloop  = (int) floor((totalstim+2*s->delaypoint)*tdres*sampFreq);
+}
+
+/* Synapse_stream_open; if unitnoise is not NULL, the fGn is unitnoise scaled by the sigma
+   of spont instead of a new draw (see BundleAN).  Fresh noise is drawn from the stream of
+   repetition rep (see single_an_independent). */
+static SYNSTREAM *syn_stream_open(double tdres, double cf, int totalstim, double spont, double noiseType,
+                                  double implnt, const SYNOPTS *opts, const double *unitnoise,
+                                  uint32_t rep, const char **errmsg)
+{
+    SYNSTREAM *s;
+    RNG rng;
+    const PLAPARAMS *pla = &opts->pla;
+    double sampFreq = pla->sampFreq, t, sigma;
+    int nnoise, p, i, n_process = pla->n_process, maxout;
+
+    *errmsg = "Synapse_stream_open: out of memory.\n";
+    if ((s = (SYNSTREAM*)calloc(1,sizeof(SYNSTREAM))) == NULL) return NULL;
+    syn_stream_sizes(s, tdres, cf, totalstim, sampFreq);
+    s->implnt = implnt; s->n_process = n_process;
+    s->prof = opts->prof;
+    nnoise    = (int) ceil((totalstim+2*s->delaypoint)*tdres*sampFreq);
+    s->binwidth = 1/sampFreq;
+    s->alpha1 = 2.5e-6*100e3; s->beta1 = 5e-4;
+    s->alpha2 = 1e-2*100e3;   s->beta2 = 1e-1;
+
+    s->rs       = resample_stream_open(1, s->resamp, opts->resampleN, (long long) totalstim + 3*s->delaypoint);
+    s->randNums = (double*)calloc(nnoise,sizeof(double));
+    s->qcap     = (opts->resampleN+3)*s->resamp + 16;  /* the lag of the decimator and interpolator */
+    s->queue    = (double*)calloc(s->qcap,sizeof(double));
+    s->nvec     = (n_process + AN_LANES-1)/AN_LANES*AN_LANES;
+    s->E_slow   = (double*)calloc(6*(size_t)s->nvec,sizeof(double));
+    if (implnt == 1)
+        s->pc = pla_conv_open(s->nloop, s->binwidth, s->beta1, s->beta2);
+    if (!s->rs || !s->randNums || !s->queue || !s->E_slow || (implnt == 1 && !s->pc)
+        || (s->dbuf = (double*)calloc(2*(size_t)SYN_CHUNK*(maxout = resample_stream_maxout(s->rs)),sizeof(double))) == NULL)
+    {
+        Synapse_stream_close(s);
+        return NULL;
+    }
+    s->pbuf = s->dbuf + (size_t)SYN_CHUNK*maxout;
+    if (s->prof)
+        s->prof->bytes += sizeof(SYNSTREAM) + resample_stream_bytes(s->rs)
+                        + ((double) nnoise + s->qcap + 6*(size_t)s->nvec + 2*(size_t)SYN_CHUNK*maxout)*sizeof(double)
+                        + (s->pc ? pla_conv_bytes(s->pc) : 0);
+    s->E_fast = s->E_slow + s->nvec;
+    s->A_slow = s->E_fast + s->nvec; s->A_fast = s->A_slow + s->nvec;
+    s->w_slow = s->A_fast + s->nvec; s->w_fast = s->w_slow + s->nvec;
+	for (p = 0; p < n_process; p++) {
+		s->A_slow[p] = 1 - pla->D_slow[p];
+		s->A_fast[p] = 1 - pla->D_fast[p];
+        s->w_slow[p] = pla->w_slow[p]; s->w_fast[p] = pla->w_fast[p];
 	}
 
-    k = 0;
-    for (int n=0; n<floor((totalstim*nrep+2*delaypoint)*tdres*sampFreq); n++)
+    /* The fGn is drawn for the whole duration at once, exactly as in Synapse */
+    t = prof_start(s->prof);
+    if (unitnoise)
     {
-        if (implnt == 0) {
-          sout1[k]  = __max( 0, sampIHC[n] + randNums[n]- alpha1*I1); 
-          sout2[k]  = __max( 0, sampIHC[n] - alpha2*I2); 
-                if (k==0)
-                {
-                    n1[k] = 1.0e-3*sout2[k];
-                    n2[k] = n1[k]; n3[0]= n2[k];
-                }
-                else if (k==1)
-                {
-                    n1[k] = 1.992127932802320*n1[k-1]+ 1.0e-3*(sout2[k] - 0.994466986569624*sout2[k-1]);
-                    n2[k] = 1.999195329360981*n2[k-1]+ n1[k] - 1.997855276593802*n1[k-1];
-                    n3[k] = -0.798261718183851*n3[k-1]+ n2[k] + 0.798261718184977*n2[k-1];
-                }
-                else
-                {			
-                    n1[k] = 1.992127932802320*n1[k-1] - 0.992140616993846*n1[k-2]+ 1.0e-3*(sout2[k] - 0.994466986569624*sout2[k-1] + 0.000000000002347*sout2[k-2]);
-                    n2[k] = 1.999195329360981*n2[k-1] - 0.999195402928777*n2[k-2]+n1[k] - 1.997855276593802*n1[k-1] + 0.997855827934345*n1[k-2];
-                    n3[k] =-0.798261718183851*n3[k-1] - 0.199131619873480*n3[k-2]+n2[k] + 0.798261718184977*n2[k-1] + 0.199131619874064*n2[k-2];
-                }   
-                I2 = n3[k];       
-
-                if (k==0)
-                {
-                    m1[k] = 0.2*sout1[k];
-                    m2[k] = m1[k];	m3[k] = m2[k];			
-                    m4[k] = m3[k];	m5[k] = m4[k];
-                }
-                else if (k==1)
-                {
-                    m1[k] = 0.491115852967412*m1[k-1] + 0.2*(sout1[k] - 0.173492003319319*sout1[k-1]);
-                    m2[k] = 1.084520302502860*m2[k-1] + m1[k] - 0.803462163297112*m1[k-1];
-                    m3[k] = 1.588427084535629*m3[k-1] + m2[k] - 1.416084732997016*m2[k-1];
-                    m4[k] = 1.886287488516458*m4[k-1] + m3[k] - 1.830362725074550*m3[k-1];
-                    m5[k] = 1.989549282714008*m5[k-1] + m4[k] - 1.983165053215032*m4[k-1];
-                }        
-                else
-                {
-                    m1[k] = 0.491115852967412*m1[k-1] - 0.055050209956838*m1[k-2]+ 0.2*(sout1[k]- 0.173492003319319*sout1[k-1]+ 0.000000172983796*sout1[k-2]);
-                    m2[k] = 1.084520302502860*m2[k-1] - 0.288760329320566*m2[k-2] + m1[k] - 0.803462163297112*m1[k-1] + 0.154962026341513*m1[k-2];
-                    m3[k] = 1.588427084535629*m3[k-1] - 0.628138993662508*m3[k-2] + m2[k] - 1.416084732997016*m2[k-1] + 0.496615555008723*m2[k-2];
-                    m4[k] = 1.886287488516458*m4[k-1] - 0.888972875389923*m4[k-2] + m3[k] - 1.830362725074550*m3[k-1] + 0.836399964176882*m3[k-2];
-                    m5[k] = 1.989549282714008*m5[k-1] - 0.989558985673023*m5[k-2] + m4[k] - 1.983165053215032*m4[k-1] + 0.983193027347456*m4[k-2];
-                }   
-                I1 = m5[k]; 
-
-        } else if (implnt == 1) {
-          sout1[k]  = __max( 0, sampIHC[n] + randNums[n]- alpha1*I1); 
-          sout2[k]  = __max( 0, sampIHC[n] - alpha2*I2); 
-            I1 = 0; I2 = 0; 
-            for (j=0; j<k+1; ++j)
+        sigma = ffGn_sigma(spont, 2014);
+        for (i=0; i<nnoise; i++)
+            s->randNums[i] = sigma*unitnoise[i];
+    }
+    else
+    {
+        if (noiseType == 0)
+            rng_init(&rng, 37, RNG_STREAM_NOISE, 0, 0);
+        else
+            rng_init(&rng, opts->seed, RNG_STREAM_NOISE, opts->fiber, rep);
+        if (ffGn(nnoise, 1/sampFreq, 0.9, spont, 2014, opts->resampleN, &rng, s->randNums, errmsg))
+        {
+            Synapse_stream_close(s);
+            return NULL;
+        }
+    }
+    prof_lap(s->prof, PROF_FGN, t, 1);
+
+    exp_adapt_init(&s->ea, cf, spont, implnt);
+    *errmsg = NULL;
+    return s;
+}
+
+/* A stream that only interpolates synapse-rate outputs computed elsewhere (pla = 0 in
+   syn_stream_run_decimated, see BundleAN), so it has no decimator, fGn or adaptation */
+static SYNSTREAM *syn_stream_open_interp(double tdres, double cf, int totalstim, const SYNOPTS *opts)
+{
+    SYNSTREAM *s = (SYNSTREAM*)calloc(1,sizeof(SYNSTREAM));
+
+    if (s)
+        syn_stream_sizes(s, tdres, cf, totalstim, opts->pla.sampFreq);
+    return s;
+}
+
+SYNSTREAM *Synapse_stream_open(double tdres, double cf, int totalstim, double spont, double noiseType,
+                               double implnt, const SYNOPTS *opts, const char **errmsg)
+{
+    return syn_stream_open(tdres, cf, totalstim, spont, noiseType, implnt, opts, NULL, 0, errmsg);
+}
+
+int Synapse_stream_process(SYNSTREAM *s, const double *ihcout, int n, double *synout)
+{
+    double x[SYN_CHUNK], t;
+    int    i, m;
+
+    s->out = synout; s->outcap = n; s->nwritten = 0;
+
+    /* Samples queued by earlier calls go first */
+    while (s->qlen > 0 && s->nwritten < n)
+    {
+        synout[s->nwritten++] = s->queue[s->qhead];
+        s->qhead = (s->qhead+1) % s->qcap;
+        s->qlen--;
+    }
+
+    for (n = __min(n, s->totalstim-s->nin); n>0; n-=m, ihcout+=m)
+    {
+        m = __min(n, SYN_CHUNK);
+        t = prof_start(s->prof);
+        for (i=0; i<m; i++)
+            x[i] = exp_adapt_step(&s->ea, ihcout[i], s->tdres);
+        prof_lap(s->prof, PROF_EXP_ADAPTATION, t, m);
+        /* The input of the decimator starts with delaypoint copies of the first sample */
+        if (s->nin == 0)
+            syn_stream_repeat(s, x[0], s->delaypoint);
+        syn_stream_block(s, x, m);
+        s->lastexp = x[m-1];
+        s->nin += m;
+    }
+    s->out = NULL;
+    return s->nwritten;
+}
+
+int Synapse_stream_finish(SYNSTREAM *s, double *synout)
+{
+    int m = 0;
+
+    while (s->qlen > 0)
+    {
+        synout[m++] = s->queue[s->qhead];
+        s->qhead = (s->qhead+1) % s->qcap;
+        s->qlen--;
+    }
+
+    /* ... and ends with 2*delaypoint copies of the last one */
+    s->out = synout + m; s->outcap = s->totalstim; s->nwritten = 0;
+    if (s->nin > 0)
+        syn_stream_repeat(s, s->lastexp, 2*s->delaypoint);
+    m += s->nwritten;
+    s->out = NULL;
+
+    /* Samples beyond the last interpolation interval are zero, as in Synapse */
+    for (; s->nout < s->totalstim; s->nout++)
+        synout[m++] = 0.0;
+    return m;
+}
+
+int Synapse_stream_lag(const SYNSTREAM *s)
+{
+    return s->qcap;  /* the queue is sized for the lag of the decimator and interpolator */
+}
+
+void Synapse_stream_close(SYNSTREAM *s)
+{
+    if (s == NULL) return;
+    resample_stream_close(s->rs);
+    free(s->dbuf); free(s->randNums); free(s->queue); free(s->E_slow);
+    pla_conv_close(s->pc);
+    free(s);
+}
+/* ------------------------------------------------------------------------------------ */
+/* Fiber bundles: many fibers of one CF on one IHC output (see BundleAN) */
+
+/* The n exponential-adaptation outputs of ihcout, padded and decimated exactly as
+   Synapse_stream_process and Synapse_stream_finish feed them to the power-law adaptation:
+   the nloop synapse-rate samples of dec.  Returns 0, or 1 if out of memory. */
+static int syn_decimate(const double *ihcout, int n, double tdres, double cf, double spont,
+                        double implnt, const SYNOPTS *opts, double *dec, int nloop)
+{
+    EXPADAPT ea;
+    RSSTREAM *rs;
+    double   x = 0, *y = NULL;
+    int      resamp = (int) ceil(1/(tdres*opts->pla.sampFreq));
+    int      delaypoint = (int) floor(7500/(cf/1e3));
+    int      i, j, k, ny, nd = 0;
+
+    rs = resample_stream_open(1, resamp, opts->resampleN, (long long) n + 3*delaypoint);
+    if (rs == NULL || (y = (double*)malloc(resample_stream_maxout(rs)*sizeof(double))) == NULL)
+    {
+        resample_stream_close(rs);
+        return 1;
+    }
+    exp_adapt_init(&ea, cf, spont, implnt);
+    /* delaypoint copies of the first sample, the n samples and 2*delaypoint copies of the last */
+    for (i = 0; i < n + 2*delaypoint; i++)
+    {
+        if (i < n)
+            x = exp_adapt_step(&ea, ihcout[i], tdres);
+        for (k = (i == 0) ? delaypoint+1 : 1; k > 0; k--)
+        {
+            ny = resample_stream_push(rs, x, y);
+            for (j=0; j<ny; j++)
+                if (nd < nloop)
+                    dec[nd++] = y[j];
+        }
+    }
+    free(y);
+    resample_stream_close(rs);
+    return 0;
+}
+
+/* Run the power-law adaptation (if pla, else dec already holds its output) and the
+   interpolation of an open stream on the synapse-rate samples dec[j0 .. j1-1], writing the
+   output samples to synout, which has room for cap >= (j1-j0)*resamp of them.  After the
+   last one (j1 = nloop) the samples beyond the last interpolation interval are zero, as in
+   Synapse.  Returns the number of samples written. */
+static int syn_stream_run_decimated(SYNSTREAM *s, const double *dec, int j0, int j1, int pla,
+                                    double *synout, int cap)
+{
+    int j;
+
+    s->out = synout; s->outcap = cap; s->nwritten = 0;
+    for (j=j0; j<j1; j++)
+        syn_stream_interpolate(s, j, pla ? syn_stream_pla(s, dec[j]) : dec[j]);
+    if (j1 == s->nloop)
+        for (; s->nout < s->totalstim && s->nwritten < cap; s->nout++)
+            synout[s->nwritten++] = 0.0;
+    s->out = NULL;
+    return s->nwritten;
+}
+
+/* Everything the tasks of BundleAN share */
+typedef struct {
+    const double *ihcout;
+    double   cf, tdres, noiseType, implnt;
+    int      nrep, totalstim, nfiber, ntype, nloop;
+    double   spont[3];      /* the distinct spontaneous rates of the bundle */
+    int      *type;         /* index into spont of each fiber */
+    double   *dec;          /* ntype decimated adaptation outputs, nloop samples each; with
+                               frozen noise, their power-law adaptation outputs */
+    double   *unitnoise;    /* frozen noise: the unit fGn, drawn once, or NULL */
+    double   *typemean, *typevar;  /* frozen noise: ntype rate functions of totalstim samples */
+    SYNOPTS  opts;          /* one thread per task, no profile */
+    double   *meanrate, *varrate, *psth;
+    const char **errmsg;    /* one per task */
+} BUNDLEJOB;
+
+/* Task k: the exponential adaptation and decimation of spontaneous rate k; with frozen
+   noise also its power-law adaptation and rates, which all of its fibers share */
+static void bundle_type_task(void *arg, int k)
+{
+    BUNDLEJOB *job = (BUNDLEJOB *) arg;
+    SYNSTREAM *s;
+    double    *dec = job->dec + (size_t)k*job->nloop, *out;
+    long long pos;
+    int       j, j1, jb, got, n = job->totalstim*job->nrep;
+
+    job->errmsg[k] = NULL;
+    if (syn_decimate(job->ihcout, n, job->tdres, job->cf, job->spont[k], job->implnt, &job->opts,
+                     dec, job->nloop))
+    {
+        job->errmsg[k] = "BundleAN: out of memory.\n";
+        return;
+    }
+    if (job->unitnoise == NULL)
+        return;
+    s = syn_stream_open(job->tdres, job->cf, n, job->spont[k], job->noiseType, job->implnt, &job->opts,
+                        job->unitnoise, 0, &job->errmsg[k]);
+    if (s == NULL)
+        return;
+    for (j=0; j<job->nloop; j++)
+        dec[j] = syn_stream_pla(s, dec[j]);
+    Synapse_stream_close(s);
+
+    /* The rates, from the interpolated output a block at a time */
+    if ((s = syn_stream_open_interp(job->tdres, job->cf, n, &job->opts)) == NULL)
+    {
+        job->errmsg[k] = "BundleAN: out of memory.\n";
+        return;
+    }
+    jb = __max(1, AN_REP_BLOCK/s->resamp);
+    if ((out = (double*)malloc((size_t)jb*s->resamp*sizeof(double))) == NULL)
+        job->errmsg[k] = "BundleAN: out of memory.\n";
+    else
+    {
+        for (pos = 0, j = 0; pos < n; pos += got, j = j1)
+        {
+            j1  = __min(j+jb, job->nloop);
+            got = syn_stream_run_decimated(s, dec, j, j1, 0, out, jb*s->resamp);
+            an_fold(out, got, pos, job->totalstim, job->nrep, job->typemean + (size_t)k*job->totalstim);
+        }
+        an_refractory(job->totalstim, job->typemean + (size_t)k*job->totalstim,
+                      job->typevar + (size_t)k*job->totalstim);
+    }
+    Synapse_stream_close(s);
+    free(out);
+}
+
+/* Task f: the rest of the synapse of fiber f (with fresh noise its own fGn and power-law
+   adaptation, then the interpolation), one block of about AN_REP_BLOCK samples at a time,
+   folded into its rates and fed to the spike generators of its trials as in single_an */
+static void bundle_fiber_task(void *arg, int f)
+{
+    BUNDLEJOB *job = (BUNDLEJOB *) arg;
+    SYNOPTS   opts = job->opts;
+    SYNSTREAM *s;
+    SPIKESTATE *st = NULL;
+    RNG       *rng = NULL;
+    double    *out = NULL;
+    long long pos;
+    int       k = job->type[f], T = job->totalstim, n = T*job->nrep, ntrials = opts.ntrials;
+    int       i, t, j, j1, jb, got, bin;
+    double    *meanrate = job->meanrate + (size_t)f*T;
+    double    *varrate  = job->varrate + (size_t)f*T;
+    double    *psth     = job->psth + (size_t)f*T;
+    const double *dec   = job->dec + (size_t)k*job->nloop;
+
+    job->errmsg[f] = NULL;
+    opts.fiber = job->opts.fiber + (uint32_t) f;
+    /* With frozen noise dec already holds the power-law adaptation output, and the rates
+       are its type's */
+    if (job->unitnoise)
+    {
+        memcpy(meanrate, job->typemean + (size_t)k*T, T*sizeof(double));
+        memcpy(varrate, job->typevar + (size_t)k*T, T*sizeof(double));
+        if ((s = syn_stream_open_interp(job->tdres, job->cf, n, &opts)) == NULL)
+            job->errmsg[f] = "BundleAN: out of memory.\n";
+    }
+    else
+        s = syn_stream_open(job->tdres, job->cf, n, job->spont[k], job->noiseType, job->implnt, &opts,
+                            NULL, 0, &job->errmsg[f]);
+    if (s == NULL)
+        return;
+    jb  = __max(1, AN_REP_BLOCK/s->resamp);
+    out = (double*)malloc((size_t)jb*s->resamp*sizeof(double));
+    st  = (SPIKESTATE*)calloc(ntrials,sizeof(SPIKESTATE));
+    rng = (RNG*)calloc(ntrials,sizeof(RNG));
+    if (!out || !st || !rng)
+    {
+        job->errmsg[f] = "BundleAN: out of memory.\n";
+        goto cleanup;
+    }
+
+    for (pos = 0, j = 0; pos < n; pos += got, j = j1)
+    {
+        j1  = __min(j+jb, job->nloop);
+        got = syn_stream_run_decimated(s, dec, j, j1, job->unitnoise == NULL, out, jb*s->resamp);
+        if (job->unitnoise == NULL)
+            an_fold(out, got, pos, T, job->nrep, meanrate);
+        /* The trials of the fiber, exactly as in SingleAN */
+        if (pos == 0 && got > 0)
+            for (t = 0; t < ntrials; t++)
+            {
+                rng_init(&rng[t], opts.seed, RNG_STREAM_SPIKES, opts.fiber, (uint32_t) t);
+                SpikeGenerator_init(&st[t], out[0], job->tdres, T * job->tdres * job->nrep, &rng[t]);
+            }
+        for (t = 0; t < ntrials; t++)
+            for (i = 0; i < got && !st[t].done; i++)
+                if (SpikeGenerator_step(&st[t], out[i]))
                 {
-                    I1 += (sout1[j])*binwidth/((k-j)*binwidth + beta1);
-                    I2 += (sout2[j])*binwidth/((k-j)*binwidth + beta2);              
+                    bin = (int) (fmod(st[t].sptime,job->tdres*T) / job->tdres);
+                    psth[bin] = psth[bin] + 1;
                 }
-        } else if (implnt == 2) {
-            // Apply power-law adaptation
-            sout1[n]  = __max(0, sampIHC[n] + randNums[n] - alpha1/sampFreq*I_slow);
-            sout2[n] = __max(0, sampIHC[n] - alpha2/sampFreq*I_fast);
-
-            // Update values for I_slow/I_fast based on approximation via parallel IIR lowpass filters
-            I_slow = 0.0; I_fast = 0.0;
-            for (int i = 0; i < n_process; i++) {
-                if (n == 0) {
-                    E_slow[i] = w_slow[i]*sout1[n];
-                    E_fast[i] = w_fast[i]*sout2[n];
-                } else {
-                    E_slow[i] = w_slow[i]*sout1[n] + (1-D_slow[i]) * E_slow[i];
-                    E_fast[i] = w_fast[i]*sout2[n] + (1-D_fast[i]) * E_fast[i];
-                }
-                I_slow += E_slow[i];
-				I_fast += E_fast[i];
-            }
-        }
-        synSampOut[k] = sout1[k] + sout2[k]; 
-        k = k+1;                  
-      }   /* end of all samples */
-      mxFree(sout1); mxFree(sout2);  
-      mxFree(m1); mxFree(m2); mxFree(m3); mxFree(m4); mxFree(m5); mxFree(n1); mxFree(n2); mxFree(n3); 
-    /*----------------------------------------------------------*/    
-    /*----- Upsampling to original (High 100 kHz) sampling rate --------*/  
-    /*----------------------------------------------------------*/    
-    for(z=0; z<k-1; ++z)
-    {    
-        incr = (synSampOut[z+1]-synSampOut[z])/resamp;
-        for(b=0; b<resamp; ++b)
+    }
+    if (job->unitnoise == NULL)
+        an_refractory(T, meanrate, varrate);
+
+cleanup:
+    Synapse_stream_close(s);
+    free(rng); free(st); free(out);
+}
+
+int BundleAN(const double *ihcout, double cf, int nrep, double tdres, int totalstim, int nfiber,
+             const double *fibertypes, double noiseType, double implnt, const SYNOPTS *opts,
+             double *meanrate, double *varrate, double *psth, const char **errmsg)
+{
+    static const double sponts[3] = {0.1, 4.0, 100.0};
+    BUNDLEJOB job;
+    RNG       rng;
+    int       f, k, n = totalstim*nrep, nthreads, nnoise, delaypoint, present[3] = {-1, -1, -1};
+
+    memset(&job, 0, sizeof(job));
+    job.ihcout = ihcout; job.cf = cf; job.tdres = tdres; job.noiseType = noiseType;
+    job.implnt = implnt; job.nrep = nrep; job.totalstim = totalstim; job.nfiber = nfiber;
+    job.meanrate = meanrate; job.varrate = varrate; job.psth = psth;
+    job.opts = *opts;
+    job.opts.nthreads = 1;  /* the fibers already keep every thread busy */
+    job.opts.prof = NULL;
+    nthreads = (opts->nthreads > 0) ? opts->nthreads : tpool_nthreads_default();
+    delaypoint = (int) floor(7500/(cf/1e3));
+    job.nloop = (int) floor((n+2*delaypoint)*tdres*opts->pla.sampFreq);
+    nnoise    = (int) ceil((n+2*delaypoint)*tdres*opts->pla.sampFreq);
+
+    /* The distinct spontaneous rates, in order of first appearance */
+    *errmsg = "BundleAN: out of memory.\n";
+    job.type = (int*)malloc(((size_t)nfiber+1)*sizeof(int));
+    job.errmsg = (const char**)calloc((size_t)nfiber+3,sizeof(const char*));
+    if (!job.type || !job.errmsg)
+        goto cleanup;
+    for (f=0; f<nfiber; f++)
+    {
+        k = (int) fibertypes[f] - 1;
+        if (present[k] < 0)
         {
-            TmpSyn[z*resamp+b] = synSampOut[z]+ b*incr; 
-        }        
-    }      
-    for (i=0;i<totalstim*nrep;++i)
-        synouttmp[i] = TmpSyn[i+delaypoint];      
-    
-    mxFree(synSampOut); mxFree(TmpSyn);   
-    mxDestroyArray(randInputArray[0]); mxDestroyArray(randOutputArray[0]);
-    mxDestroyArray(IhcInputArray[0]); mxDestroyArray(IhcOutputArray[0]); mxDestroyArray(IhcInputArray[1]); mxDestroyArray(IhcInputArray[2]);
-    mxDestroyArray(randInputArray[1]);mxDestroyArray(randInputArray[2]); mxDestroyArray(randInputArray[3]);
-    mxDestroyArray(randInputArray[4]);
-    return((long) ceil(totalstim*nrep));
-}    
+            present[k] = job.ntype;
+            job.spont[job.ntype++] = sponts[k];
+        }
+        job.type[f] = present[k];
+    }
+
+    job.dec = (double*)malloc((size_t)job.ntype*job.nloop*sizeof(double));
+    if (!job.dec)
+        goto cleanup;
+    if (noiseType == 0)
+    {
+        /* Frozen noise is the same sample for every fiber, up to its sigma: draw it once */
+        job.unitnoise = (double*)malloc((size_t)nnoise*sizeof(double));
+        job.typemean  = (double*)calloc(2*(size_t)job.ntype*totalstim,sizeof(double));
+        if (!job.unitnoise || !job.typemean)
+            goto cleanup;
+        job.typevar = job.typemean + (size_t)job.ntype*totalstim;
+        rng_init(&rng, 37, RNG_STREAM_NOISE, 0, 0);
+        if (ffGn_unit(nnoise, 1/opts->pla.sampFreq, 0.9, opts->resampleN, &rng, job.unitnoise, errmsg))
+            goto cleanup;
+    }
+
+    /*====== Shared stages, once per spontaneous rate ======*/
+    tpool_run(__min(nthreads, job.ntype), job.ntype, bundle_type_task, &job);
+    for (k=0; k<job.ntype; k++)
+        if ((*errmsg = job.errmsg[k]) != NULL)
+            goto cleanup;
+
+    /*====== Each fiber's own stages ======*/
+    tpool_run(__min(nthreads, nfiber), nfiber, bundle_fiber_task, &job);
+    for (f=0; f<nfiber; f++)
+        if ((*errmsg = job.errmsg[f]) != NULL)
+            goto cleanup;
+    *errmsg = NULL;
+
+cleanup:
+    free(job.type); free(job.errmsg); free(job.dec);
+    free(job.unitnoise); free(job.typemean);
+    return (*errmsg != NULL);
+}
 /* ------------------------------------------------------------------------------------ */
 /* Pass the output of Synapse model through the Spike Generator */
 
@@ -554,78 +1359,93 @@ double Synapse(
    http://www.urmc.rochester.edu/smd/Nanat/faculty-research/lab-pages/LaurelCarney/auditory-models.cfm
 */
 
-int SpikeGenerator(double *synouttmp, double tdres, int totalstim, int nrep, double *sptime) 
+int SpikeGenerator(double *synouttmp, double tdres, int totalstim, int nrep, RNG *rng, double *sptime) 
 {  
-   	double  c0,s0,c1,s1,dead;
-    int     nspikes,k,NoutMax,Nout,deadtimeIndex,randBufIndex;      
-    double	deadtimeRnd, endOfLastDeadtime, refracMult0, refracMult1, refracValue0, refracValue1;
-    double	Xsum, unitRateIntrvl, countTime, DT;    
-    
-    mxArray	*randInputArray[1], *randOutputArray[1];
-    double *randNums, *randDims;    
-    
-    c0      = 0.5;
-	s0      = 0.001;
-	c1      = 0.5;
-	s1      = 0.0125;
-    dead    = 0.00075;
-    
-    DT = totalstim * tdres * nrep;  /* Total duration of the rate function */
+    SPIKESTATE st;
+    int     k, Nout;
+
+    SpikeGenerator_init(&st, synouttmp[0], tdres, totalstim * tdres * nrep, rng);  /* Total duration of the rate function */
     Nout = 0;
-    NoutMax = (long) ceil(totalstim*nrep*tdres/dead);    
-       
-    randInputArray[0] = mxCreateDoubleMatrix(1, 2, mxREAL);
-    randDims = mxGetPr(randInputArray[0]);
-    randDims[0] = 1;
-    randDims[1] = NoutMax+1;
-    mexCallMATLAB(1, randOutputArray, 1, randInputArray, "rand");
-    randNums = mxGetPr(randOutputArray[0]);
-    randBufIndex = 0;
+	for (k=0; (k<totalstim*nrep) && !st.done; ++k)  /* Loop through rate vector */
+		if (SpikeGenerator_step(&st, synouttmp[k]))
+		{
+			sptime[Nout] = st.sptime; Nout = Nout+1;
+		}
+	return(Nout);  /* Number of spikes that occurred. */
+}
+
+void SpikeGenerator_init(SPIKESTATE *st, double synout0, double tdres, double DT, RNG *rng)
+{
+    double endOfLastDeadtime;
+
+    st->c0      = 0.5;
+	st->s0      = 0.001;
+	st->c1      = 0.5;
+	st->s1      = 0.0125;
+    st->dead    = 0.00075;
+    st->tdres   = tdres;
+    st->DT      = DT;
+    st->rng     = rng;
+    st->skip    = 0;
+    st->done    = 0;
     
+    /* Uniform deviates are drawn from rng as they are needed (see rng.hpp) */
+
 	/* Calculate useful constants */
-	deadtimeIndex = (long) floor(dead/tdres);  /* Integer number of discrete time bins within deadtime */
-	deadtimeRnd = deadtimeIndex*tdres;		   /* Deadtime rounded down to length of an integer number of discrete time bins */
+	st->deadtimeIndex = (long) floor(st->dead/tdres);  /* Integer number of discrete time bins within deadtime */
+	st->deadtimeRnd = st->deadtimeIndex*tdres;		   /* Deadtime rounded down to length of an integer number of discrete time bins */
 
-	refracMult0 = 1 - tdres/s0;  /* If y0(t) = c0*exp(-t/s0), then y0(t+tdres) = y0(t)*refracMult0 */
-	refracMult1 = 1 - tdres/s1;  /* If y1(t) = c1*exp(-t/s1), then y1(t+tdres) = y1(t)*refracMult1 */
+	st->refracMult0 = 1 - tdres/st->s0;  /* If y0(t) = c0*exp(-t/s0), then y0(t+tdres) = y0(t)*refracMult0 */
+	st->refracMult1 = 1 - tdres/st->s1;  /* If y1(t) = c1*exp(-t/s1), then y1(t+tdres) = y1(t)*refracMult1 */
 
 	/* Calculate effects of a random spike before t=0 on refractoriness and the time-warping sum at t=0 */
-    endOfLastDeadtime = __max(0,log(randNums[randBufIndex++]) / synouttmp[0] + dead);  /* End of last deadtime before t=0 */
-    refracValue0 = c0*exp(endOfLastDeadtime/s0);     /* Value of first exponential in refractory function */
-	refracValue1 = c1*exp(endOfLastDeadtime/s1);     /* Value of second exponential in refractory function */
-	Xsum = synouttmp[0] * (-endOfLastDeadtime + c0*s0*(exp(endOfLastDeadtime/s0)-1) + c1*s1*(exp(endOfLastDeadtime/s1)-1));  
+    endOfLastDeadtime = __max(0,log(rng_uniform(rng)) / synout0 + st->dead);  /* End of last deadtime before t=0 */
+    st->refracValue0 = st->c0*exp(endOfLastDeadtime/st->s0);     /* Value of first exponential in refractory function */
+	st->refracValue1 = st->c1*exp(endOfLastDeadtime/st->s1);     /* Value of second exponential in refractory function */
+	st->Xsum = synout0 * (-endOfLastDeadtime + st->c0*st->s0*(exp(endOfLastDeadtime/st->s0)-1) + st->c1*st->s1*(exp(endOfLastDeadtime/st->s1)-1));  
         /* Value of time-warping sum */
 		/*  ^^^^ This is the "integral" of the refractory function ^^^^ (normalized by 'tdres') */
 
 	/* Calculate first interspike interval in a homogeneous, unit-rate Poisson process (normalized by 'tdres') */
-    unitRateIntrvl = -log(randNums[randBufIndex++])/tdres;  
+    st->unitRateIntrvl = -log(rng_uniform(rng))/tdres;  
 	    /* NOTE: Both 'unitRateInterval' and 'Xsum' are divided (or normalized) by 'tdres' in order to reduce calculation time.  
 		This way we only need to divide by 'tdres' once per spike (when calculating 'unitRateInterval'), instead of 
 		multiplying by 'tdres' once per time bin (when calculating the new value of 'Xsum').                         */
 
-	countTime = tdres;
-	for (k=0; (k<totalstim*nrep) && (countTime<DT); ++k, countTime+=tdres, refracValue0*=refracMult0, refracValue1*=refracMult1)  /* Loop through rate vector */
+	st->countTime = tdres;
+}
+
+int SpikeGenerator_step(SPIKESTATE *st, double synout)
+{
+    int spike = 0;
+
+    if (st->skip > 0)  /* within the deadtime of the last spike */
+    {
+        st->skip--;
+        return 0;
+    }
+    if (st->done || !(st->countTime < st->DT))
+    {
+        st->done = 1;
+        return 0;
+    }
+	if (synout>0)  /* Nothing to do for non-positive rates, i.e. Xsum += 0 for non-positive rates. */
 	{
-		if (synouttmp[k]>0)  /* Nothing to do for non-positive rates, i.e. Xsum += 0 for non-positive rates. */
-		{
-		  Xsum += synouttmp[k]*(1 - refracValue0 - refracValue1);  /* Add synout*(refractory value) to time-warping sum */
+	  st->Xsum += synout*(1 - st->refracValue0 - st->refracValue1);  /* Add synout*(refractory value) to time-warping sum */
 			
-			if ( Xsum >= unitRateIntrvl )  /* Spike occurs when time-warping sum exceeds interspike "time" in unit-rate process */
-			{
-				sptime[Nout] = countTime; Nout = Nout+1;								
-				unitRateIntrvl = -log(randNums[randBufIndex++]) /tdres; 
-                 Xsum = 0;
+		if ( st->Xsum >= st->unitRateIntrvl )  /* Spike occurs when time-warping sum exceeds interspike "time" in unit-rate process */
+		{
+			st->sptime = st->countTime; spike = 1;
+			st->unitRateIntrvl = -log(rng_uniform(st->rng)) /st->tdres; 
+             st->Xsum = 0;
 				
-			    /* Increase index and time to the last time bin in the deadtime, and reset (relative) refractory function */
-				k += deadtimeIndex;
-				countTime += deadtimeRnd;
-				refracValue0 = c0;
-				refracValue1 = c1;
-			}
+		    /* Skip the time bins in the deadtime, advance the time to the last of them, and reset (relative) refractory function */
+			st->skip = st->deadtimeIndex;
+			st->countTime += st->deadtimeRnd;
+			st->refracValue0 = st->c0;
+			st->refracValue1 = st->c1;
 		}
-	} /* End of rate vector loop */			
-            
-    mxDestroyArray(randInputArray[0]); mxDestroyArray(randOutputArray[0]);	
-	nspikes = Nout;  /* Number of spikes that occurred. */
-	return(nspikes);
+	}
+    st->countTime += st->tdres; st->refracValue0 *= st->refracMult0; st->refracValue1 *= st->refracMult1;
+    return spike;
 }
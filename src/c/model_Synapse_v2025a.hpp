@@ -0,0 +1,144 @@
+#ifndef _MODEL_SYNAPSE_V2025A_HPP
+#define _MODEL_SYNAPSE_V2025A_HPP
+
+/* MODEL_SYNAPSE_V2025A.HPP header file
+ * Entry points of the synapse / spike-generator stage (model_Synapse_v2025a.c) for callers
+ * other than its own MEX gateway, e.g. the population model in model_AN_population.c.
+ * Compile model_Synapse_v2025a.c with -DAN_NO_MEXFUNCTION to link it into another MEX file
+ * or into a program without MATLAB, such as bench_an.c.
+ * SingleAN makes no mx* / mex* calls, so it can run on worker threads.
+ */
+
+#include <stdint.h>
+#include "rng.hpp"
+#include "pla_params.hpp"
+#include "profile.hpp"
+
+/* Simulation settings that trade accuracy for speed but are not part of the model itself.
+ * From MATLAB they are given as fields of an optional trailing opts struct (see
+ * mex_options.c); Synapse_default_options gives the published model's behaviour. */
+typedef struct {
+    int resampleN;  /* filter length N of the decimator and of the fGn upsampler
+                       (opts.resample_n); see resample.hpp.  RESAMPLE_N_MATLAB reproduces
+                       MATLAB's resample. */
+    uint64_t seed;  /* key of the fiber's random streams (opts.seed, see rng.hpp) */
+    uint32_t fiber; /* fiber id of the streams (opts.fiber_id); fibers with the same seed
+                       but different ids are independent */
+    int ntrials;    /* spike trains drawn from the one synapse output (opts.ntrials) */
+    int nthreads;   /* threads for the trials (opts.nthreads); 0 for one per processor */
+    int indepreps;  /* run each repetition from rest, on its own thread, with fresh fGn
+                       of its own or the shared frozen fGn (opts.independent_reps; see SingleAN) */
+    PLAPARAMS pla;  /* parallel-exponential PLA approximation of implnt 2 and the synapse
+                       sampling rate (opts.pla, see pla_params.hpp) */
+    int single;     /* run the IHC filters in single precision (opts.precision = 'single');
+                       only model_AN_population reads it */
+    const char *neurogram; /* file to write the outputs of model_AN_population to
+                       (opts.neurogram, see neurogram.hpp), or NULL to return them */
+    ANPROF *prof;   /* if not NULL, Synapse and SingleAN add their stage times to it (see
+                       profile.hpp); not an opts field, and not for concurrent calls */
+} SYNOPTS;
+
+/* Defaults: published model, resample_n = 10, fiber 0, a fresh seed from the clock, one
+ * trial, serial repetitions, the "gc2024" PLA parameters, no neurogram file and no profile */
+void Synapse_default_options(SYNOPTS *opts);
+
+/* Run the synapse and spike generator on one IHC output of totalstim*nrep samples; the
+ * outputs (totalstim samples each) must be zeroed by the caller.  The synapse runs once and
+ * the spike generator opts->ntrials times on its output, on up to opts->nthreads threads;
+ * psth holds the spikes of all trials, and trials (ntrials x totalstim, column-major, may be
+ * NULL) those of each trial.  With opts->indepreps the repetitions do not share the
+ * synapse's state: each starts from rest with its own spike trains (stream rep r*ntrials+k
+ * for trial k) and, with fresh noise (noiseType 1), its own fGn (stream rep r); frozen fGn
+ * (noiseType 0) is the same for every repetition.  The repetitions run on up to
+ * opts->nthreads threads, and their outputs are summed in repetition order, so the result
+ * does not depend on the number of threads.  Returns 0 on success, or non-zero with *errmsg set. */
+int  SingleAN(double *px, double cf, int nrep, double tdres, int totalstim, double fibertype,
+              double noiseType, double implnt, const SYNOPTS *opts, double *meanrate,
+              double *varrate, double *psth, double *trials, const char **errmsg);
+
+/* The two stages of SingleAN on their own.  Synapse writes the synapse output of the
+ * totalstim*nrep IHC samples ihcout (fiber of spontaneous rate spont) to synouttmp, and
+ * returns the number of samples, or -1 with *errmsg set.  SpikeGenerator draws one spike
+ * train from the rate function synouttmp with rng, writes the spike times to sptime (room
+ * for one per dead time) and returns their number. */
+double Synapse(double *ihcout, double tdres, double cf, int totalstim, int nrep, double spont,
+               double noiseType, double implnt, const SYNOPTS *opts, double *synouttmp,
+               const char **errmsg);
+int  SpikeGenerator(double *synouttmp, double tdres, int totalstim, int nrep, RNG *rng, double *sptime);
+
+/* SingleAN on nrep repetitions of one IHC output period (totalstim samples) delayed by
+ * delaypoint samples, i.e. on IHCAN's output given IHCAN_period's (model_IHC.hpp), with the
+ * same result.  The repetitions are never stored: SingleAN streams its input through the
+ * synapse and folds the output into the rates and spike trains block by block, so this
+ * needs memory for one period whatever nrep is (besides the synapse's fGn). */
+int  SingleAN_periodic(const double *period, int delaypoint, double cf, int nrep, double tdres,
+                       int totalstim, double fibertype, double noiseType, double implnt,
+                       const SYNOPTS *opts, double *meanrate, double *varrate, double *psth,
+                       double *trials, const char **errmsg);
+
+/* A bundle of nfiber fibers of one CF on one IHC output: fiber f has type fibertypes[f] and
+ * fiber id opts->fiber+f, and its outputs are identical to those of SingleAN with that type
+ * and id.  The outputs are nfiber x totalstim (row f at offset f*totalstim) and must be
+ * zeroed by the caller; psth holds the spikes of all opts->ntrials trials of each fiber.
+ * The exponential adaptation and decimation run once per distinct fiber type, not per fiber.
+ * With frozen noise (noiseType 0) the fGn of every fiber is the same unit sample scaled by
+ * the sigma of its spontaneous rate, so it is drawn once and the whole synapse runs once per
+ * type; otherwise each fiber draws its own fGn and runs its own power-law adaptation.  Each
+ * fiber's synapse output is interpolated, folded into its rates and fed to its spike
+ * generators one block at a time, as in SingleAN, so besides the outputs only each type's
+ * decimated adaptation output (at the synapse rate) is kept whole.  The per-fiber stages
+ * run on up to opts->nthreads threads.  Returns 0 on success, or non-zero with *errmsg set. */
+int  BundleAN(const double *ihcout, double cf, int nrep, double tdres, int totalstim, int nfiber,
+              const double *fibertypes, double noiseType, double implnt, const SYNOPTS *opts,
+              double *meanrate, double *varrate, double *psth, const char **errmsg);
+
+/* The synapse of one fiber run one block of IHC output at a time.  The exponential
+ * adaptation, decimator, power-law adaptation and interpolation run block by block and
+ * keep only the history they need: the filter states, the decimator's window of
+ * 2*resample_n*resamp+1 samples, and the few output samples those delay.  The exception
+ * is the fGn, which Synapse draws with one FFT over the whole duration; the stream draws
+ * the same noise at open, at the synapse rate (1/resamp of the stimulus length).  With
+ * implnt 1 the power-law sums also keep all past synapse-rate samples (pla_conv.hpp). */
+typedef struct SYNSTREAM SYNSTREAM;
+
+/* Open a stream for totalstim IHC samples; the other arguments are as for SingleAN.
+ * Returns NULL with *errmsg set on failure. */
+SYNSTREAM *Synapse_stream_open(double tdres, double cf, int totalstim, double spont, double noiseType,
+                               double implnt, const SYNOPTS *opts, const char **errmsg);
+
+/* Feed the next n IHC output samples and write the synapse output samples that are complete,
+ * at most n, to synout; returns how many.  The output lags the input by about
+ * (resample_n+2)*resamp samples. */
+int  Synapse_stream_process(SYNSTREAM *s, const double *ihcout, int n, double *synout);
+
+/* After all totalstim samples have been fed, write the remaining output samples (totalstim
+ * minus those returned so far) and return their number.  Concatenated, the outputs are
+ * identical to Synapse's with nrep = 1. */
+int  Synapse_stream_finish(SYNSTREAM *s, double *synout);
+
+/* The most samples the output can lag the input by, and so the most Synapse_stream_finish
+ * writes: a caller can size its buffers for that at open */
+int  Synapse_stream_lag(const SYNSTREAM *s);
+
+void Synapse_stream_close(SYNSTREAM *s);
+
+/* State of the spike generator between time bins, so that it can also run on a rate
+ * function that arrives in blocks (SpikeGenerator runs the same code over a whole one) */
+typedef struct {
+    double c0, s0, c1, s1, dead, tdres, DT;
+    double deadtimeRnd, refracMult0, refracMult1;
+    double refracValue0, refracValue1, Xsum, unitRateIntrvl, countTime;
+    double sptime;      /* time of the spike just generated */
+    long   deadtimeIndex;
+    long   skip;        /* time bins left in the current deadtime */
+    int    done;        /* the rate function's duration DT has been reached */
+    RNG    *rng;
+} SPIKESTATE;
+
+/* Start a spike train of duration DT, given the first rate sample */
+void SpikeGenerator_init(SPIKESTATE *st, double synout0, double tdres, double DT, RNG *rng);
+
+/* Advance by one rate sample; returns 1 if a spike occurred, at time st->sptime */
+int  SpikeGenerator_step(SPIKESTATE *st, double synout);
+
+#endif
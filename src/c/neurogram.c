@@ -0,0 +1,151 @@
+/*
+neurogram.c implements the memory-mapped neurogram files declared in neurogram.hpp
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "neurogram.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+static const char magic[8] = {'A','N','N','G','R','A','M',NG_VERSION};
+
+#ifdef _WIN32
+
+/* Create path with size bytes and map it read-write */
+static int map_file(const char *path, size_t size, NEUROGRAM *ng)
+{
+    LARGE_INTEGER len;
+
+    ng->file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                           FILE_ATTRIBUTE_NORMAL, NULL);
+    if (ng->file == INVALID_HANDLE_VALUE)
+    {
+        ng->file = NULL;
+        return 1;
+    }
+    len.QuadPart = (LONGLONG) size;
+    if (!SetFilePointerEx(ng->file, len, NULL, FILE_BEGIN) || !SetEndOfFile(ng->file)
+        || (ng->mapping = CreateFileMappingA(ng->file, NULL, PAGE_READWRITE, 0, 0, NULL)) == NULL
+        || (ng->base = (char*) MapViewOfFile(ng->mapping, FILE_MAP_WRITE, 0, 0, 0)) == NULL)
+        return 1;
+    ng->size = size;
+    return 0;
+}
+
+static int unmap_file(NEUROGRAM *ng)
+{
+    int err = 0;
+
+    if (ng->base)
+        err = !FlushViewOfFile(ng->base, 0) | !UnmapViewOfFile(ng->base);
+    if (ng->mapping) CloseHandle(ng->mapping);
+    if (ng->file)
+        err |= !FlushFileBuffers(ng->file) | !CloseHandle(ng->file);
+    return err;
+}
+
+#else
+
+static int map_file(const char *path, size_t size, NEUROGRAM *ng)
+{
+    void *base;
+    int  fd, err;
+
+    if ((fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0666)) < 0)
+        return 1;
+#ifdef __linux__
+    /* Reserve the blocks now: a full disk would otherwise only show as a SIGBUS on a store
+       into the mapping */
+    err = posix_fallocate(fd, 0, (off_t) size) != 0;
+#else
+    err = ftruncate(fd, (off_t) size) != 0;
+#endif
+    if (!err && (base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) != MAP_FAILED)
+    {
+        ng->base = (char*) base;
+        ng->size = size;
+    }
+    else
+        err = 1;
+    close(fd);  /* the mapping stays valid */
+    return err;
+}
+
+static int unmap_file(NEUROGRAM *ng)
+{
+    int err = 0;
+
+    if (ng->base)
+        err = (msync(ng->base, ng->size, MS_SYNC) != 0) | (munmap(ng->base, ng->size) != 0);
+    return err;
+}
+
+#endif
+
+int neurogram_create(const char *path, const double *cfs, const double *fibertypes, int nfib,
+                     long long ncf, long long nsamples, double fs, int nrep, int species,
+                     double implnt, NEUROGRAM *ng)
+{
+    NGHEADER  hd;
+    double    *tail;
+    long long c, nchunk, offset;
+
+    memset(ng, 0, sizeof(NEUROGRAM));
+    if (ncf < 1 || nsamples < 1) return 1;
+    ng->ncf = ncf;
+    ng->nsamples = nsamples;
+    ng->chunk = (nsamples < NG_CHUNK) ? nsamples : NG_CHUNK;
+    nchunk = (nsamples + ng->chunk - 1)/ng->chunk;
+    offset = ((long long) sizeof(NGHEADER) + 2*ncf*(long long) sizeof(double) + 4095)/4096*4096;
+    if (map_file(path, (size_t) (offset + nchunk*NG_NVAR*ncf*ng->chunk*(long long) sizeof(double)), ng))
+    {
+        unmap_file(ng);
+        memset(ng, 0, sizeof(NEUROGRAM));
+        return 1;
+    }
+    ng->data = (double*) (ng->base + offset);
+
+    memset(&hd, 0, sizeof(hd));
+    memcpy(hd.magic, magic, sizeof(magic));
+    hd.ncf = ncf; hd.nsamples = nsamples; hd.chunk = ng->chunk;
+    hd.nvar = NG_NVAR; hd.data_offset = offset;
+    hd.fs = fs; hd.nrep = nrep; hd.species = species; hd.implnt = implnt;
+    strncpy(hd.model, NG_MODEL, sizeof(hd.model) - 1);
+    memcpy(ng->base, &hd, sizeof(hd));
+    tail = (double*) (ng->base + sizeof(NGHEADER));
+    for (c = 0; c < ncf; c++)
+    {
+        tail[c] = cfs[c];
+        tail[ncf + c] = fibertypes[(nfib == 1) ? 0 : c];
+    }
+    return 0;
+}
+
+void neurogram_write(NEUROGRAM *ng, int var, long long c, const double *x)
+{
+    long long t, n;
+
+    for (t = 0; t < ng->nsamples; t += ng->chunk)
+    {
+        n = (ng->nsamples - t < ng->chunk) ? ng->nsamples - t : ng->chunk;
+        memcpy(ng->data + ng->chunk*(c + ng->ncf*(var + NG_NVAR*(t/ng->chunk))), x + t,
+               (size_t) n*sizeof(double));
+    }
+}
+
+int neurogram_close(NEUROGRAM *ng)
+{
+    int err = unmap_file(ng);
+
+    memset(ng, 0, sizeof(NEUROGRAM));
+    return err;
+}
@@ -0,0 +1,66 @@
+#ifndef _NEUROGRAM_HPP
+#define _NEUROGRAM_HPP
+
+/* NEUROGRAM.HPP header file
+ * Memory-mapped neurogram files, so that model_AN_population can write outputs larger than
+ * memory and MATLAB (read_neurogram.m) can read parts of them without loading the rest.
+ *
+ * A file is a 128-byte NGHEADER, the ncf CFs and the ncf fiber types as doubles, and, from
+ * data_offset (a multiple of 4096), the NG_NVAR variables (mean rate, rate variance, PSTH)
+ * in CF x time chunks of `chunk` samples.  Chunk j holds samples j*chunk ... j*chunk+chunk-1
+ * of every variable and CF: sample t of variable v at CF c is the double at index
+ *
+ *     (t % chunk) + chunk*(c + ncf*(v + NG_NVAR*(t/chunk)))
+ *
+ * from data_offset, i.e. MATLAB's x(t, c, v, j) for an array of size [chunk ncf NG_NVAR
+ * nchunk].  A time window of all CFs is thus a few contiguous runs, and so is the whole of
+ * one CF.  The last chunk is padded with zeros.  All numbers are in native byte order.
+ *
+ * Each channel is written by one worker with neurogram_write; writers of different
+ * channels may run concurrently.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define NG_VERSION  1
+#define NG_NVAR     3
+#define NG_MEANRATE 0
+#define NG_VARRATE  1
+#define NG_PSTH     2
+#define NG_CHUNK    65536   /* samples per chunk, or fewer if the neurogram is shorter */
+#define NG_MODEL    "zbc2014 + gc2024 PLA, model_Synapse_v2025a"
+
+typedef struct {
+    char    magic[8];       /* "ANNGRAM" and NG_VERSION */
+    int64_t ncf, nsamples, chunk, nvar, data_offset;
+    double  fs;
+    int64_t nrep, species;
+    double  implnt;
+    char    model[48];      /* NG_MODEL, truncated and zero-padded */
+} NGHEADER;
+
+/* A neurogram file open for writing */
+typedef struct {
+    char      *base;        /* the whole file, mapped */
+    size_t    size;
+    long long ncf, nsamples, chunk;
+    double    *data;        /* base + data_offset */
+#ifdef _WIN32
+    void      *file, *mapping;
+#endif
+} NEUROGRAM;
+
+/* Create the file path (replacing any file of that name) for ncf CFs of nsamples samples
+ * and map it.  Returns 0 on success. */
+int neurogram_create(const char *path, const double *cfs, const double *fibertypes, int nfib,
+                     long long ncf, long long nsamples, double fs, int nrep, int species,
+                     double implnt, NEUROGRAM *ng);
+
+/* Write the nsamples samples of x as variable var of channel c */
+void neurogram_write(NEUROGRAM *ng, int var, long long c, const double *x);
+
+/* Flush and unmap the file.  Returns 0 if everything reached the file. */
+int neurogram_close(NEUROGRAM *ng);
+
+#endif
@@ -0,0 +1,177 @@
+/*
+pla_conv.c implements the online block convolution of the exact power-law adaptation
+declared in pla_conv.hpp
+*/
+
+#include <stdlib.h>
+
+#include "fft.hpp"
+#include "pla_conv.hpp"
+
+struct PLACONV {
+    int    n, k, nlevel;
+    double binwidth, beta[2];
+    double *x[2];            /* sout1 and sout2 so far */
+    double *acc[2];          /* block contributions to the sums, by sample */
+    double hdir[2][PLA_CONV_DIRECT];
+    /* spectra of the kernel pieces of the levels, lags [B,2B) zero-padded to 2B */
+    double **hre[2], **him[2];
+    double *zre, *zim, *yre, *yim;   /* FFT scratch of the largest level */
+};
+
+/* Kernel of sums 0 (I1) and 1 (I2) at lag d */
+static double kernel(const PLACONV *c, int i, int d)
+{
+    return c->binwidth/(d*c->binwidth + c->beta[i]);
+}
+
+PLACONV *pla_conv_open(int n, double binwidth, double beta1, double beta2)
+{
+    PLACONV *c = (PLACONV*)calloc(1,sizeof(PLACONV));
+    const FFTPLAN *plan;
+    int i, p, d, B, M, ok = 1;
+
+    if (!c) return NULL;
+    c->n = n; c->binwidth = binwidth; c->beta[0] = beta1; c->beta[1] = beta2;
+    for (i=0; i<2; i++)
+        for (d=0; d<PLA_CONV_DIRECT; d++)
+            c->hdir[i][d] = kernel(c, i, d);
+
+    /* Levels B = PLA_CONV_DIRECT, 2*PLA_CONV_DIRECT, ... while lag B still falls inside */
+    for (B=PLA_CONV_DIRECT; B<n; B*=2)
+        c->nlevel++;
+    M = (c->nlevel > 0) ? (PLA_CONV_DIRECT << c->nlevel) : 1;
+
+    for (i=0; i<2; i++)
+    {
+        c->x[i]   = (double*)calloc(n > 0 ? n : 1,sizeof(double));
+        c->acc[i] = (double*)calloc(n > 0 ? n : 1,sizeof(double));
+        c->hre[i] = (double**)calloc(c->nlevel+1,sizeof(double*));
+        c->him[i] = (double**)calloc(c->nlevel+1,sizeof(double*));
+        ok = ok && c->x[i] && c->acc[i] && c->hre[i] && c->him[i];
+    }
+    c->zre = (double*)calloc(4*(size_t)M,sizeof(double));
+    if (!ok || !c->zre)
+    {
+        pla_conv_close(c);
+        return NULL;
+    }
+    c->zim = c->zre + M; c->yre = c->zim + M; c->yim = c->yre + M;
+
+    for (p=0, B=PLA_CONV_DIRECT; p<c->nlevel; p++, B*=2)
+    {
+        if ((plan = fft_plan(2*B)) == NULL)
+        {
+            pla_conv_close(c);
+            return NULL;
+        }
+        for (i=0; i<2; i++)
+        {
+            c->hre[i][p] = (double*)calloc(4*(size_t)B,sizeof(double));
+            if (c->hre[i][p] == NULL)
+            {
+                pla_conv_close(c);
+                return NULL;
+            }
+            c->him[i][p] = c->hre[i][p] + 2*B;
+            for (d=0; d<B; d++)
+                c->hre[i][p][d] = kernel(c, i, B+d);
+            fft_run(plan, c->hre[i][p], c->him[i][p], 0);
+        }
+    }
+    return c;
+}
+
+/* Add the contributions of block x[s..s+B-1] at lags [B,2B) to the sums of samples
+   s+B ... s+3B-2 */
+static void add_block(PLACONV *c, int p, int s, int B)
+{
+    const FFTPLAN *plan = fft_plan(2*B);
+    int    M = 2*B, t, kk;
+    double zr, zi, cr, ci, ar, ai, br, bi, x1r, x1i, x2r, x2i;
+    double *h1r = c->hre[0][p], *h1i = c->him[0][p], *h2r = c->hre[1][p], *h2i = c->him[1][p];
+
+    /* Both inputs in one transform: z = x1 + i*x2 */
+    for (t=0; t<B; t++)
+    {
+        c->zre[t] = c->x[0][s+t];
+        c->zim[t] = c->x[1][s+t];
+    }
+    for (t=B; t<M; t++)
+        c->zre[t] = c->zim[t] = 0.0;
+    fft_run(plan, c->zre, c->zim, 0);
+
+    /* Separate the spectra by conjugate symmetry, multiply them by their kernels and
+       recombine as y = y1 + i*y2, both of which are real */
+    for (t=0; t<M; t++)
+    {
+        kk = (M-t) & (M-1);
+        zr = c->zre[t];  zi = c->zim[t];
+        cr = c->zre[kk]; ci = -c->zim[kk];
+        x1r = 0.5*(zr+cr); x1i = 0.5*(zi+ci);
+        x2r = 0.5*(zi-ci); x2i = -0.5*(zr-cr);
+        ar = x1r*h1r[t] - x1i*h1i[t]; ai = x1r*h1i[t] + x1i*h1r[t];
+        br = x2r*h2r[t] - x2i*h2i[t]; bi = x2r*h2i[t] + x2i*h2r[t];
+        c->yre[t] = ar - bi;
+        c->yim[t] = ai + br;
+    }
+    fft_run(plan, c->yre, c->yim, 1);
+
+    for (t=0; t<M-1 && s+B+t<c->n; t++)
+    {
+        c->acc[0][s+B+t] += c->yre[t]/M;
+        c->acc[1][s+B+t] += c->yim[t]/M;
+    }
+}
+
+void pla_conv_push(PLACONV *c, double sout1, double sout2, double *I1, double *I2)
+{
+    int    k = c->k++, d, dmax, p, B;
+    double s1, s2;
+
+    c->x[0][k] = sout1;
+    c->x[1][k] = sout2;
+
+    /* Short lags directly */
+    s1 = c->acc[0][k]; s2 = c->acc[1][k];
+    dmax = (k < PLA_CONV_DIRECT-1) ? k : PLA_CONV_DIRECT-1;
+    for (d=0; d<=dmax; d++)
+    {
+        s1 += c->x[0][k-d]*c->hdir[0][d];
+        s2 += c->x[1][k-d]*c->hdir[1][d];
+    }
+    *I1 = s1; *I2 = s2;
+
+    /* Blocks completed by this sample */
+    for (p=0, B=PLA_CONV_DIRECT; p<c->nlevel && (k+1) % B == 0; p++, B*=2)
+        add_block(c, p, k+1-B, B);
+}
+
+size_t pla_conv_bytes(const PLACONV *c)
+{
+    size_t B = PLA_CONV_DIRECT, M = (c->nlevel > 0) ? (PLA_CONV_DIRECT << c->nlevel) : 1;
+    size_t n = (c->n > 0) ? c->n : 1, bytes;
+    int    p;
+
+    bytes = sizeof(PLACONV) + 4*n*sizeof(double) + 4*(c->nlevel+1)*sizeof(double*) + 4*M*sizeof(double);
+    for (p=0; p<c->nlevel; p++, B*=2)
+        bytes += 2*4*B*sizeof(double);
+    return bytes;
+}
+
+void pla_conv_close(PLACONV *c)
+{
+    int i, p;
+
+    if (c == NULL) return;
+    for (i=0; i<2; i++)
+    {
+        free(c->x[i]); free(c->acc[i]);
+        if (c->hre[i])
+            for (p=0; p<c->nlevel; p++)
+                free(c->hre[i][p]);
+        free(c->hre[i]); free(c->him[i]);
+    }
+    free(c->zre);
+    free(c);
+}
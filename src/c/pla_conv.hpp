@@ -0,0 +1,43 @@
+#ifndef _PLA_CONV_HPP
+#define _PLA_CONV_HPP
+
+/* PLA_CONV.HPP header file
+ * Exact power-law adaptation (implnt = 1 of the synapse model) by online block convolution.
+ * The adaptation sums
+ *
+ *     I1(k) = sum_{j<=k} sout1(j)*binwidth/((k-j)*binwidth + beta1)     (and I2 with beta2)
+ *
+ * are convolutions of sout with a fixed kernel, but sout(k) depends on I(k-1), so they
+ * cannot be computed by one FFT convolution after the fact.  Recomputing them as a full
+ * sum for every sample, as the original code does, costs O(N^2).
+ *
+ * Here the lags below PLA_CONV_DIRECT are summed directly for every sample.  The lags in
+ * [B, 2B), for B = PLA_CONV_DIRECT*2^p, are added block-wise: as soon as the B samples
+ * of an aligned block of sout are known, their convolution with that piece of the kernel
+ * is computed with one FFT of length 2B and added to the sums of the samples it reaches,
+ * all of which lie in the future.  Every (sample, lag) pair is counted exactly once, so
+ * the result is the exact sum up to rounding (relative differences of order 1e-13 against
+ * the direct sum), at O(N log^2 N) cost.  sout1 and sout2 share their FFTs as the real
+ * and imaginary parts of one complex transform.
+ */
+
+#include <stddef.h>
+
+/* Lags summed directly for every sample; must be a power of 2 */
+#define PLA_CONV_DIRECT 64
+
+typedef struct PLACONV PLACONV;
+
+/* State for n samples at the synapse rate 1/binwidth, or NULL if memory ran out */
+PLACONV *pla_conv_open(int n, double binwidth, double beta1, double beta2);
+
+/* Append sample k (the number of earlier calls, < n) of sout1 and sout2 and return the
+ * sums I1(k) and I2(k), which include it */
+void pla_conv_push(PLACONV *c, double sout1, double sout2, double *I1, double *I2);
+
+/* Memory allocated for c, in bytes (without the cached FFT plans) */
+size_t pla_conv_bytes(const PLACONV *c);
+
+void pla_conv_close(PLACONV *c);
+
+#endif
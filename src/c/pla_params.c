@@ -0,0 +1,236 @@
+/*
+pla_params.c implements the registry of PLA parameter sets declared in pla_params.hpp
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "pla_params.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+static SRWLOCK cache_lock = SRWLOCK_INIT;
+#define CACHE_LOCK()   AcquireSRWLockExclusive(&cache_lock)
+#define CACHE_UNLOCK() ReleaseSRWLockExclusive(&cache_lock)
+#else
+#include <pthread.h>
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#define CACHE_LOCK()   pthread_mutex_lock(&cache_lock)
+#define CACHE_UNLOCK() pthread_mutex_unlock(&cache_lock)
+#endif
+
+#define BETA_SLOW 5e-4
+#define BETA_FAST 1e-1
+
+/* Table 1 of Guest and Carney (2024) */
+static const double w_slow_table[14] = {
+    1054.1349144510866, 235.42021095822022, 351.3091743124357, 99.00123234954474,
+    55.18423650003196, 28.99454378212968, 6.556134147763605, 6.558380224204848,
+    1.1576087874250394, 0.995488845827021, 0.3588672871386332, 0.1573449044190812,
+    0.010428823220777147, 0.08773889583510958
+};
+static const double w_fast_table[14] = {
+    6.106637716398411, 1.1558964083697898, 1.3095958543425545, 0.785695677692722,
+    0.21835528692662018, 0.10344785429373701, 0.08413927488982781, 0.001596356536824024,
+    0.018886711336962816, 0.0008089617759213521, 0.002806098243601203, 0.0006529927704604911,
+    3.13953727422695e-5, 0.0004490670084957763
+};
+
+/* The built-in sets, made on first use */
+#define NBUILTIN 5
+static const char *builtin_name[NBUILTIN] = {"gc2024", "heuristic6", "heuristic10", "heuristic14", "heuristic20"};
+static const int  builtin_n[NBUILTIN]     = {14, 6, 10, 14, 20};
+static PLAPARAMS  builtin[NBUILTIN];
+static int        builtin_ready;
+
+/* Files loaded so far, replaced in first-in first-out order */
+static struct {
+    char      *name;
+    PLAPARAMS p;
+} cache[PLA_CACHE_SIZE];
+static int cache_next;
+
+int pla_params_set(PLAPARAMS *p, int n, double sampFreq, const double *tau_slow,
+                   const double *w_slow, const double *tau_fast, const double *w_fast,
+                   const char **errmsg)
+{
+    int i;
+
+    if (n < 1 || n > PLA_MAX_PROCESS)
+    {
+        *errmsg = "PLA parameters: the number of processes must be between 1 and 32.\n";
+        return 1;
+    }
+    if (!(sampFreq > 0))
+    {
+        *errmsg = "PLA parameters: the synapse sampling rate must be positive.\n";
+        return 1;
+    }
+    memset(p, 0, sizeof(PLAPARAMS));
+    p->n_process = n;
+    p->sampFreq  = sampFreq;
+    for (i = 0; i < n; i++) {
+        if (!(tau_slow[i] > 0) || !(tau_fast[i] > 0))
+        {
+            *errmsg = "PLA parameters: time constants must be positive.\n";
+            return 1;
+        }
+        p->tau_slow[i] = tau_slow[i]; p->w_slow[i] = w_slow[i];
+        p->tau_fast[i] = tau_fast[i]; p->w_fast[i] = w_fast[i];
+		p->D_slow[i] = 1 - exp(-1/sampFreq / tau_slow[i]);
+		p->D_fast[i] = 1 - exp(-1/sampFreq / tau_fast[i]);
+    }
+    *errmsg = NULL;
+    return 0;
+}
+
+/* The heuristic set with n processes per pathway */
+static void heuristic(PLAPARAMS *p, int n)
+{
+    double tau_slow[PLA_MAX_PROCESS], w_slow[PLA_MAX_PROCESS], c_slow = 0;
+    double tau_fast[PLA_MAX_PROCESS], w_fast[PLA_MAX_PROCESS], c_fast = 0;
+    const char *errmsg;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        tau_slow[i] = BETA_SLOW * pow(10.0, 13/exp(1.0) * i/(n-1));
+        tau_fast[i] = BETA_FAST * pow(10.0, 13/exp(1.0) * i/(n-1));
+        w_slow[i] = 1/(tau_slow[i] + BETA_SLOW);
+        w_fast[i] = 1/(tau_fast[i] + BETA_FAST);
+        c_slow += 2*BETA_SLOW * w_slow[i] * exp(-BETA_SLOW/tau_slow[i]);
+        c_fast += 2*BETA_FAST * w_fast[i] * exp(-BETA_FAST/tau_fast[i]);
+    }
+    for (i = 0; i < n; i++) {
+        w_slow[i] /= c_slow;
+        w_fast[i] /= c_fast;
+    }
+    pla_params_set(p, n, 10e3, tau_slow, w_slow, tau_fast, w_fast, &errmsg);
+}
+
+/* Make the built-in sets; called with the lock held */
+static void make_builtins(void)
+{
+    double tau_slow[14], tau_fast[14];
+    const char *errmsg;
+    int i;
+
+    if (builtin_ready) return;
+    /* Time constants from Equation 6 with 14 processes */
+    for (i = 0; i < 14; i++) {
+        tau_slow[i] = BETA_SLOW * pow(10.0, 1/exp(1.0) * i);
+        tau_fast[i] = BETA_FAST * pow(10.0, 1/exp(1.0) * i);
+    }
+    pla_params_set(&builtin[0], 14, 10e3, tau_slow, w_slow_table, tau_fast, w_fast_table, &errmsg);
+    for (i = 1; i < NBUILTIN; i++)
+        heuristic(&builtin[i], builtin_n[i]);
+    builtin_ready = 1;
+}
+
+const PLAPARAMS *pla_params_default(void)
+{
+    CACHE_LOCK();
+    make_builtins();
+    CACHE_UNLOCK();
+    return &builtin[0];
+}
+
+/* Parse a parameter file */
+static int load(const char *file, PLAPARAMS *p, const char **errmsg)
+{
+    double tau[2][PLA_MAX_PROCESS], w[2][PLA_MAX_PROCESS], sampFreq = 10e3, a, b;
+    int    n[2] = {0, 0}, path, err = 0;
+    char   line[256], key[32], *s;
+    FILE   *f;
+
+    if ((f = fopen(file, "r")) == NULL)
+    {
+        *errmsg = "PLA parameters: no such parameter set or file.\n";
+        return 1;
+    }
+    while (!err && fgets(line, sizeof(line), f))
+    {
+        for (s = line; *s == ' ' || *s == '\t'; s++) ;
+        if (*s == '%' || *s == '#' || *s == '\n' || *s == '\r' || *s == '\0')
+            continue;
+        if (sscanf(s, "%31s", key) != 1)
+            continue;
+        path = (strcmp(key, "slow") == 0) ? 0 : (strcmp(key, "fast") == 0) ? 1 : -1;
+        if (strcmp(key, "fs_synapse") == 0 && sscanf(s, "%*s %lf", &a) == 1)
+            sampFreq = a;
+        else if (path >= 0 && sscanf(s, "%*s %lf %lf", &a, &b) == 2 && n[path] < PLA_MAX_PROCESS)
+        {
+            tau[path][n[path]] = a;
+            w[path][n[path]++] = b;
+        }
+        else
+            err = 1;
+    }
+    fclose(f);
+    if (err)
+    {
+        *errmsg = "PLA parameters: malformed line in the parameter file (or more than 32 processes).\n";
+        return 1;
+    }
+    if (n[0] != n[1])
+    {
+        *errmsg = "PLA parameters: the file must give as many fast as slow processes.\n";
+        return 1;
+    }
+    return pla_params_set(p, n[0], sampFreq, tau[0], w[0], tau[1], w[1], errmsg);
+}
+
+int pla_params_get(const char *spec, PLAPARAMS *p, const char **errmsg)
+{
+    PLAPARAMS q;
+    char *name;
+    int  i;
+
+    *errmsg = NULL;
+    CACHE_LOCK();
+    make_builtins();
+    for (i = 0; i < NBUILTIN; i++)
+        if (strcmp(builtin_name[i], spec) == 0)
+        {
+            *p = builtin[i];
+            CACHE_UNLOCK();
+            return 0;
+        }
+    for (i = 0; i < PLA_CACHE_SIZE; i++)
+        if (cache[i].name && strcmp(cache[i].name, spec) == 0)
+        {
+            *p = cache[i].p;
+            CACHE_UNLOCK();
+            return 0;
+        }
+    CACHE_UNLOCK();
+
+    if (load(spec, &q, errmsg))
+        return 1;
+    *p = q;
+    if ((name = (char*)malloc(strlen(spec)+1)) == NULL)
+        return 0;  /* not cached, but loaded */
+    strcpy(name, spec);
+    CACHE_LOCK();
+    free(cache[cache_next].name);
+    cache[cache_next].name = name;
+    cache[cache_next].p    = q;
+    cache_next = (cache_next+1) % PLA_CACHE_SIZE;
+    CACHE_UNLOCK();
+    return 0;
+}
+
+void pla_params_clear_cache(void)
+{
+    int i;
+
+    CACHE_LOCK();
+    for (i = 0; i < PLA_CACHE_SIZE; i++)
+    {
+        free(cache[i].name);
+        cache[i].name = NULL;
+    }
+    cache_next = 0;
+    CACHE_UNLOCK();
+}
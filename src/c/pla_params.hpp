@@ -0,0 +1,60 @@
+#ifndef _PLA_PARAMS_HPP
+#define _PLA_PARAMS_HPP
+
+/* PLA_PARAMS.HPP header file
+ * Parameter sets of the parallel-exponential approximation of power-law adaptation
+ * (implnt = 2, Guest and Carney, 2024): the synapse sampling rate and the time constants
+ * and weights of the slow and fast pathways, with the decay coefficients
+ * D = 1 - exp(-1/(sampFreq*tau)) the synapse needs computed once per set.
+ *
+ * Sets are found by name in a registry:
+ *
+ *   "gc2024"        Table 1 of Guest and Carney (2024): 14 processes per pathway,
+ *                   tau = beta*10^(i/e) for beta = 0.5 ms (slow) and 100 ms (fast),
+ *                   numerically optimized weights.  The default.
+ *   "heuristicN"    N = 6, 10, 14 or 20 processes spanning the same time constants
+ *                   (tau = beta*10^(i*13/(e*(N-1)))), with the heuristic weights of the
+ *                   paper, w = 1/(tau + beta) normalized by 2*beta*sum(w*exp(-beta/tau)).
+ *                   Fewer processes are proportionally cheaper and less accurate.
+ *
+ * or loaded from a text file, whose lines are
+ *
+ *   fs_synapse <Hz>          optional, default 10000
+ *   slow <tau in s> <w>      one line per process of the slow pathway
+ *   fast <tau in s> <w>      one line per process of the fast pathway (as many as slow)
+ *
+ * with blank lines and lines starting with % or # ignored.  Loaded files are cached by
+ * file name until pla_params_clear_cache, so a set is only parsed once per session.
+ * All functions are thread safe.
+ */
+
+/* Most processes per pathway a set may have */
+#define PLA_MAX_PROCESS 32
+/* Loaded files kept in the cache */
+#define PLA_CACHE_SIZE 32
+
+typedef struct {
+    int    n_process;                 /* processes per pathway */
+    double sampFreq;                  /* synapse sampling rate (Hz) */
+    double tau_slow[PLA_MAX_PROCESS], w_slow[PLA_MAX_PROCESS];
+    double tau_fast[PLA_MAX_PROCESS], w_fast[PLA_MAX_PROCESS];
+    double D_slow[PLA_MAX_PROCESS], D_fast[PLA_MAX_PROCESS];
+} PLAPARAMS;
+
+/* The default set, "gc2024" */
+const PLAPARAMS *pla_params_default(void);
+
+/* Set p from explicit values, computing the decay coefficients.  Returns 0 on success, or
+ * non-zero with *errmsg set if n is out of range or a time constant is not positive. */
+int pla_params_set(PLAPARAMS *p, int n, double sampFreq, const double *tau_slow,
+                   const double *w_slow, const double *tau_fast, const double *w_fast,
+                   const char **errmsg);
+
+/* Copy the set called spec, a registry name or else the name of a file to load (see above),
+ * to *p.  Returns 0 on success, or non-zero with *errmsg set. */
+int pla_params_get(const char *spec, PLAPARAMS *p, const char **errmsg);
+
+/* Free all cached files (e.g. from a mexAtExit handler) */
+void pla_params_clear_cache(void);
+
+#endif
@@ -0,0 +1,63 @@
+/*
+profile.c implements the stage timers declared in profile.hpp
+*/
+
+#include <string.h>
+
+#include "profile.hpp"
+#include "timer.hpp"
+
+#ifdef _WIN32
+#define PSAPI_VERSION 2
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+const char *prof_stage_name[PROF_NSTAGE] = {
+    "middle_ear", "control_path", "c1_filter", "c2_filter", "ihc_transduction", "ihc_output",
+    "fgn", "exp_adaptation", "decimation", "pla", "interpolation", "rates", "spikes"
+};
+
+void prof_clear(ANPROF *p)
+{
+    memset(p, 0, sizeof(ANPROF));
+}
+
+double prof_start(ANPROF *p)
+{
+    return p ? timer_now() : 0.0;
+}
+
+double prof_lap(ANPROF *p, PROFSTAGE stage, double t, long long calls)
+{
+    double now;
+
+    if (p == NULL) return 0.0;
+    now = timer_now();
+    p->seconds[stage] += now - t;
+    p->calls[stage]   += calls;
+    return now;
+}
+
+double prof_peak_working_set(void)
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return (double) pmc.PeakWorkingSetSize;
+    return 0.0;
+#else
+    struct rusage ru;
+
+    if (getrusage(RUSAGE_SELF, &ru) != 0)
+        return 0.0;
+#ifdef __APPLE__
+    return (double) ru.ru_maxrss;          /* bytes */
+#else
+    return 1024.0 * (double) ru.ru_maxrss; /* kilobytes */
+#endif
+#endif
+}
@@ -0,0 +1,55 @@
+#ifndef _PROFILE_HPP
+#define _PROFILE_HPP
+
+/* PROFILE.HPP header file
+ * Per-stage wall times of the IHC and synapse models, for finding out where a slow
+ * simulation spends its time.  IHCAN, Synapse and SingleAN add to an ANPROF when given
+ * one (and skip all timing when given NULL).  Their per-sample loops run stage by stage
+ * over blocks of samples, which the stages' feed-forward structure allows without
+ * changing any result, so the clock is read once per stage and block, not per sample.
+ *
+ * calls counts the samples a per-sample stage has processed (at its own rate: the
+ * interpolation and the stages before it at 1/tdres, the power-law adaptation at the
+ * synapse rate), and the calls of the others (ffGn, spike trains, IHC outputs).  bytes
+ * counts the working buffers the model allocates itself, not the caches of filter
+ * designs, FFT plans and noise spectra or the short-lived temporaries inside ffGn.
+ */
+
+typedef enum {
+    PROF_MIDDLE_EAR,        /* IHCAN: middle-ear filter */
+    PROF_CONTROL_PATH,      /* wideband gammatone, OHC nonlinearity and lowpass, gain */
+    PROF_C1_FILTER,         /* signal-path chirp filter with its pole placement */
+    PROF_C2_FILTER,         /* parallel-path chirp filter */
+    PROF_IHC_TRANSDUCTION,  /* IHC nonlinearities and lowpass */
+    PROF_IHC_OUTPUT,        /* repetition and path delay of the IHC output */
+    PROF_FGN,               /* Synapse: fractional Gaussian noise */
+    PROF_EXP_ADAPTATION,    /* exponential adaptation at 1/tdres */
+    PROF_DECIMATION,        /* resampling to the synapse rate */
+    PROF_PLA,               /* power-law adaptation at the synapse rate */
+    PROF_INTERPOLATION,     /* linear interpolation back to 1/tdres */
+    PROF_RATES,             /* SingleAN: mean rate and variance */
+    PROF_SPIKES,            /* spike generation for all trials */
+    PROF_NSTAGE
+} PROFSTAGE;
+
+/* Field names of the stages, as in the MATLAB profile struct */
+extern const char *prof_stage_name[PROF_NSTAGE];
+
+typedef struct {
+    double    seconds[PROF_NSTAGE];
+    long long calls[PROF_NSTAGE];
+    double    bytes;       /* working memory allocated */
+} ANPROF;
+
+void prof_clear(ANPROF *p);
+
+/* Stage timer: t = prof_start(p) before a stage, then t = prof_lap(p, stage, t, calls)
+ * after it adds the time since t to the stage and restarts the clock.  Both do nothing
+ * (and return 0) when p is NULL. */
+double prof_start(ANPROF *p);
+double prof_lap(ANPROF *p, PROFSTAGE stage, double t, long long calls);
+
+/* Peak working-set (resident) size of the process so far, in bytes, or 0 if unknown */
+double prof_peak_working_set(void);
+
+#endif
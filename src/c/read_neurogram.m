@@ -0,0 +1,66 @@
+function ng = read_neurogram(file)
+% READ_NEUROGRAM(file) Opens a neurogram file written by model_AN_population
+% (opts.neurogram, or args.neurogram of sim_an_population_zbc2025) for
+% reading. Nothing but the header is read: the samples stay in the file,
+% which is memory-mapped, and only the parts asked for are loaded.
+%
+% ng = READ_NEUROGRAM(file) returns a struct with fields
+% - cfs, fibertypes: the CFs (Hz) and fiber types of the rows, (n_cf, 1)
+% - fs: sampling rate (Hz)
+% - n_sample: samples per row
+% - nrep, species, implnt: as passed to model_AN_population
+% - model: the model version that wrote the file
+% - read: a function, x = ng.read(name, rows, samples), returning the
+%		(length(rows), length(samples)) block of variable name ('meanrate',
+%		'varrate' or 'psth'); rows and samples default to all of them
+%
+% The file layout is described in neurogram.hpp.
+	f = fopen(file, 'r');
+	if f < 0
+		error('read_neurogram:open', 'Cannot open %s', file);
+	end
+	cleanup = onCleanup(@() fclose(f));
+	magic = fread(f, [1 8], '*uint8');
+	if ~isequal(magic(1:7), uint8('ANNGRAM')) || magic(8) ~= 1
+		error('read_neurogram:format', '%s is not a version 1 neurogram file', file);
+	end
+	dims = fread(f, 5, 'int64');
+	[n_cf, n_sample, chunk, nvar, data_offset] = deal(dims(1), dims(2), dims(3), dims(4), dims(5));
+	ng.fs = fread(f, 1, 'double');
+	ng.nrep = fread(f, 1, 'int64');
+	ng.species = fread(f, 1, 'int64');
+	ng.implnt = fread(f, 1, 'double');
+	ng.model = deblank(char(fread(f, [1 48], 'uint8=>char')));
+	ng.cfs = fread(f, n_cf, 'double');
+	ng.fibertypes = fread(f, n_cf, 'double');
+	ng.n_sample = n_sample;
+
+	nchunk = ceil(n_sample/chunk);
+	m = memmapfile(file, 'Offset', data_offset, ...
+		'Format', {'double', [chunk n_cf nvar nchunk], 'x'});
+	ng.read = @(name, varargin) read_block(m, name, chunk, n_cf, n_sample, varargin{:});
+end
+
+function x = read_block(m, name, chunk, n_cf, n_sample, rows, samples)
+	if nargin < 6 || isempty(rows)
+		rows = 1:n_cf;
+	end
+	if nargin < 7 || isempty(samples)
+		samples = 1:n_sample;
+	end
+	v = find(strcmp(name, {'meanrate', 'varrate', 'psth'}));
+	if isempty(v)
+		error('read_neurogram:name', 'Unknown variable %s', name);
+	end
+	if any(samples < 1 | samples > n_sample) || any(rows < 1 | rows > n_cf)
+		error('read_neurogram:index', 'Index out of range');
+	end
+
+	% One indexing of the mapping per chunk touched
+	x = zeros(length(rows), length(samples));
+	j = floor((samples - 1)/chunk) + 1;
+	for k = unique(j(:))'
+		sel = (j == k);
+		x(:, sel) = m.Data.x(samples(sel) - (k-1)*chunk, rows, v, k).';
+	end
+end
@@ -0,0 +1,274 @@
+/*
+resample.c implements the polyphase resampler declared in resample.hpp
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "simd.hpp"
+#include "resample.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+static SRWLOCK cache_lock = SRWLOCK_INIT;
+#define CACHE_LOCK()   AcquireSRWLockExclusive(&cache_lock)
+#define CACHE_UNLOCK() ReleaseSRWLockExclusive(&cache_lock)
+#else
+#include <pthread.h>
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#define CACHE_LOCK()   pthread_mutex_lock(&cache_lock)
+#define CACHE_UNLOCK() pthread_mutex_unlock(&cache_lock)
+#endif
+
+#ifndef PI
+#define PI 3.14159265358979323846
+#endif
+
+#define KAISER_BETA 5.0
+#define CACHE_SIZE  16
+
+/* Polyphase decomposition of the filter of resample(x,p,q,N) */
+typedef struct {
+    int p, q, N;   /* key, with p/q in lowest terms */
+    int K;         /* taps per phase, ceil(L/p) */
+    int Lhalf;     /* N*max(p,q), the delay of the filter */
+    double *g;     /* g[r*K+k] = h[r+(K-1-k)*p] (zero beyond L): phase r, reversed so that
+                      the taps line up with consecutive input samples */
+} RSDESIGN;
+
+static RSDESIGN cache[CACHE_SIZE];
+static int ncache = 0;
+
+/* Modified Bessel function of the first kind, order 0, by its power series */
+static double bessel_i0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    int k;
+
+    for (k=1; k<500; k++)
+    {
+        term *= (x/(2*k))*(x/(2*k));
+        sum  += term;
+        if (term < 1e-17*sum) break;
+    }
+    return sum;
+}
+
+static int gcd(int a, int b)
+{
+    while (b) { int t = a%b; a = b; b = t; }
+    return a;
+}
+
+/* Design the filter of resample(x,p,q,N) and split it into its p phases */
+static int design(RSDESIGN *d, int p, int q, int N)
+{
+    int pqmax = (p > q) ? p : q, L = 2*N*pqmax+1, n, r, k;
+    double *h, sum = 0.0, i0beta = bessel_i0(KAISER_BETA);
+
+    d->p = p; d->q = q; d->N = N;
+    d->Lhalf = N*pqmax;
+    d->K = (L+p-1)/p;
+    h = (double*)malloc(L*sizeof(double));
+    d->g = (double*)calloc((size_t)p*d->K, sizeof(double));
+    if (!h || !d->g)
+    {
+        free(h); free(d->g); d->g = NULL;
+        return 1;
+    }
+
+    /* firls(L-1,[0 1/pqmax 1/pqmax 1],[1 1 0 0]) is the ideal lowpass (1/pqmax)*sinc(m/pqmax) */
+    for (n=0; n<L; n++)
+    {
+        int    m = abs(n - d->Lhalf);
+        double x = (double) m/pqmax, ratio = (double) m/d->Lhalf;
+        double lp = (m == 0) ? 1.0/pqmax : (1.0/pqmax)*sin(PI*x)/(PI*x);
+
+        h[n] = lp*bessel_i0(KAISER_BETA*sqrt(1-ratio*ratio))/i0beta;
+        sum += h[n];
+    }
+    for (n=0; n<L; n++)
+        h[n] = p*h[n]/sum;
+
+    for (r=0; r<p; r++)
+        for (k=0; k<d->K; k++)
+        {
+            n = r+(d->K-1-k)*p;
+            if (n < L) d->g[(size_t)r*d->K+k] = h[n];
+        }
+    free(h);
+    return 0;
+}
+
+/* Find the design for (p,q,N) in the cache, adding it if needed.  A design that does not
+   fit in the cache is returned in *tmp and must be freed by the caller. */
+static const RSDESIGN *get_design(int p, int q, int N, RSDESIGN *tmp)
+{
+    const RSDESIGN *d = NULL;
+    int i;
+
+    CACHE_LOCK();
+    for (i=0; i<ncache; i++)
+        if (cache[i].p == p && cache[i].q == q && cache[i].N == N)
+        {
+            d = &cache[i];
+            break;
+        }
+    if (d == NULL)
+    {
+        if (ncache < CACHE_SIZE)
+        {
+            if (design(&cache[ncache], p, q, N) == 0) d = &cache[ncache++];
+        }
+        else if (design(tmp, p, q, N) == 0) d = tmp;
+    }
+    CACHE_UNLOCK();
+    return d;
+}
+
+/* Inner product of n taps and n input samples, AN_LANES products at a time */
+static double dot(const double *g, const double *x, int n)
+{
+    vreal acc = vzero();
+    double sum;
+    int k;
+
+    for (k=0; k+AN_LANES<=n; k+=AN_LANES)
+        acc = vadd(acc, vmul(vload(g+k), vload(x+k)));
+    sum = vhsum(acc);
+    for (; k<n; k++)
+        sum += g[k]*x[k];
+    return sum;
+}
+
+int resample_length(int nx, int p, int q)
+{
+    return (int) (((long long) nx*p + q - 1)/q);
+}
+
+/* Output j of the resampler, given input samples x0, x0+1, ... starting at x (x0 <= the
+   first sample that output j depends on) */
+static double output(const RSDESIGN *d, const double *x, long long x0, long long nx, long long j)
+{
+    long long t  = j*d->q + d->Lhalf;
+    int       r  = (int) (t % d->p);
+    long long i0 = t/d->p - d->K + 1;   /* input sample that meets tap 0 of phase r */
+    int       k0 = 0, k1 = d->K;
+
+    if (i0 < 0) k0 = (int) -i0;
+    if (i0 + k1 > nx) k1 = (int) (nx - i0);
+    return (k1 > k0) ? dot(d->g + (size_t)r*d->K + k0, x + (i0 + k0 - x0), k1-k0) : 0.0;
+}
+
+int resample_poly(const double *x, int nx, int p, int q, int N, double *y)
+{
+    RSDESIGN tmp;
+    const RSDESIGN *d;
+    int c, j, ny;
+
+    if (p <= 0 || q <= 0 || N <= 0) return 1;
+    ny = resample_length(nx, p, q);
+    c = gcd(p, q); p /= c; q /= c;
+
+    tmp.g = NULL;
+    if ((d = get_design(p, q, N, &tmp)) == NULL) return 1;
+
+    for (j=0; j<ny; j++)
+        y[j] = output(d, x, 0, nx, j);
+
+    free(tmp.g);
+    return 0;
+}
+
+/* State of a streaming resampler: the design and a window of the latest input samples */
+struct RSSTREAM {
+    RSDESIGN       tmp;    /* the design, if it did not fit in the cache */
+    const RSDESIGN *d;
+    long long      nx, ny; /* total numbers of input and output samples */
+    long long      nin, j; /* input samples pushed and outputs produced so far */
+    long long      base;   /* input sample held in buf[0] */
+    double         *buf;
+    int            len, cap;
+};
+
+RSSTREAM *resample_stream_open(int p, int q, int N, long long nx)
+{
+    RSSTREAM *s;
+    int c;
+
+    if (p <= 0 || q <= 0 || N <= 0 || nx < 0) return NULL;
+    if ((s = (RSSTREAM*)calloc(1, sizeof(RSSTREAM))) == NULL) return NULL;
+    s->nx = nx;
+    s->ny = (nx*p + q - 1)/q;
+    c = gcd(p, q); p /= c; q /= c;
+    if ((s->d = get_design(p, q, N, &s->tmp)) == NULL)
+    {
+        free(s);
+        return NULL;
+    }
+    s->cap = s->d->K + 4096;
+    if ((s->buf = (double*)malloc(s->cap*sizeof(double))) == NULL)
+    {
+        resample_stream_close(s);
+        return NULL;
+    }
+    return s;
+}
+
+int resample_stream_maxout(const RSSTREAM *s)
+{
+    return (int) ((s->d->Lhalf + 2*s->d->p)/s->d->q) + 2;
+}
+
+int resample_stream_push(RSSTREAM *s, double x, double *y)
+{
+    const RSDESIGN *d = s->d;
+    int nout = 0;
+
+    if (s->nin >= s->nx) return 0;
+
+    /* Outputs still to come need at most the last K-1 samples before this one */
+    if (s->len == s->cap)
+    {
+        int keep = d->K - 1;
+        memmove(s->buf, s->buf + s->len - keep, keep*sizeof(double));
+        s->base += s->len - keep;
+        s->len   = keep;
+    }
+    s->buf[s->len++] = x;
+    s->nin++;
+
+    /* Produce every output whose last input sample has now arrived */
+    while (s->j < s->ny && ((s->j*d->q + d->Lhalf)/d->p < s->nin || s->nin == s->nx))
+        y[nout++] = output(d, s->buf, s->base, s->nx, s->j++);
+    return nout;
+}
+
+size_t resample_stream_bytes(const RSSTREAM *s)
+{
+    size_t bytes = sizeof(RSSTREAM) + s->cap*sizeof(double);
+
+    if (s->tmp.g)
+        bytes += (size_t)s->tmp.p*s->tmp.K*sizeof(double);
+    return bytes;
+}
+
+void resample_stream_close(RSSTREAM *s)
+{
+    if (s == NULL) return;
+    free(s->tmp.g);
+    free(s->buf);
+    free(s);
+}
+
+void resample_clear_cache(void)
+{
+    int i;
+
+    CACHE_LOCK();
+    for (i=0; i<ncache; i++)
+        free(cache[i].g);
+    ncache = 0;
+    CACHE_UNLOCK();
+}
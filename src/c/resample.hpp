@@ -0,0 +1,66 @@
+#ifndef _RESAMPLE_HPP
+#define _RESAMPLE_HPP
+
+/* RESAMPLE.HPP header file
+ * Native polyphase version of MATLAB's resample(x,p,q,N) (Signal Processing Toolbox), used
+ * by the synapse model for its 100 kHz <-> sampFreq conversions instead of calling back
+ * into MATLAB.  The filter is the one resample designs,
+ *
+ *     h = firls(L-1, [0 1/pqmax 1/pqmax 1], [1 1 0 0]) .* kaiser(L, 5)',   L = 2*N*pqmax+1,
+ *     h = p*h/sum(h),                                                         pqmax = max(p,q),
+ *
+ * and the output is y(j) = sum_i x(i)*h(j*q + N*pqmax - i*p) with x zero outside the input,
+ * ceil(nx*p/q) samples long, exactly as resample's upfirdn call and delay trimming.  Only
+ * the order of the floating-point additions differs from MATLAB, so outputs agree with
+ * resample to within 1e-12*max(abs(x)) (about L*eps in the worst case, typically ~1e-15).
+ *
+ * N is the quality/speed setting: the cost per output sample is proportional to N.
+ * RESAMPLE_N_MATLAB (10) is MATLAB's default and reproduces resample.  Smaller values
+ * widen the transition band around the lower of the two Nyquist frequencies (fNy):
+ *
+ *      N     passband (-0.1 dB) up to     attenuation reaches 50 dB at
+ *     10            0.86 fNy                       1.16 fNy
+ *      6            0.77 fNy                       1.26 fNy
+ *      4            0.65 fNy                       1.39 fNy
+ *      2            0.25 fNy                       1.79 fNy (stopband only ~23 dB)
+ *
+ * Filter designs are cached, keyed on (p,q,N) after reducing p/q, so repeated calls with
+ * the same ratio do not redesign the filter.  All functions are thread safe.
+ */
+
+#include <stddef.h>
+
+#define RESAMPLE_N_MATLAB 10
+
+/* Number of output samples of resample_poly, ceil(nx*p/q) */
+int resample_length(int nx, int p, int q);
+
+/* Resample nx samples of x by p/q into y, which must hold resample_length(nx,p,q) values.
+ * Returns 0 on success, non-zero if p, q or N is not positive or memory ran out. */
+int resample_poly(const double *x, int nx, int p, int q, int N, double *y);
+
+/* Streaming form of resample_poly, for an input of nx samples that arrives one sample at a
+ * time (e.g. from a recursive filter).  The outputs are identical to resample_poly's and
+ * each is produced as soon as the last input sample it depends on has been pushed, about
+ * N*max(p,q)/p samples later; only the most recent taps-per-phase input samples are kept. */
+typedef struct RSSTREAM RSSTREAM;
+
+/* Open a stream; returns NULL if p, q, N or nx is invalid or memory ran out */
+RSSTREAM *resample_stream_open(int p, int q, int N, long long nx);
+
+/* Largest number of outputs one resample_stream_push can produce */
+int  resample_stream_maxout(const RSSTREAM *s);
+
+/* Push the next input sample; writes the outputs it completes to y and returns how many.
+ * The push of sample nx-1 produces all the remaining outputs. */
+int  resample_stream_push(RSSTREAM *s, double x, double *y);
+
+/* Memory allocated for s, in bytes (without a cached filter design) */
+size_t resample_stream_bytes(const RSSTREAM *s);
+
+void resample_stream_close(RSSTREAM *s);
+
+/* Free all cached filter designs (e.g. from a mexAtExit handler) */
+void resample_clear_cache(void);
+
+#endif
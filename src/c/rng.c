@@ -0,0 +1,123 @@
+/*
+rng.c implements the Philox4x32-10 streams declared in rng.hpp
+*/
+
+#include <math.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#define rng_pid()  ((uint32_t) GetCurrentProcessId())
+#else
+#include <unistd.h>
+#define rng_pid()  ((uint32_t) getpid())
+#endif
+
+#include "rng.hpp"
+#include "timer.hpp"
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u   /* golden ratio */
+#define PHILOX_W1 0xBB67AE85u   /* sqrt(3)-1 */
+
+/* out = Philox4x32-10(ctr, key) */
+static void philox4x32_10(const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4])
+{
+    uint32_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3], k0 = key[0], k1 = key[1];
+    uint64_t p0, p1;
+    int r;
+
+    for (r=0; r<10; r++)
+    {
+        if (r > 0) { k0 += PHILOX_W0; k1 += PHILOX_W1; }
+        p0 = (uint64_t) PHILOX_M0 * c0;
+        p1 = (uint64_t) PHILOX_M1 * c2;
+        c0 = (uint32_t) (p1 >> 32) ^ c1 ^ k0;
+        c1 = (uint32_t) p1;
+        c2 = (uint32_t) (p0 >> 32) ^ c3 ^ k1;
+        c3 = (uint32_t) p0;
+    }
+    out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+}
+
+static uint32_t next_word(RNG *rng)
+{
+    if (rng->used == 4)
+    {
+        philox4x32_10(rng->ctr, rng->key, rng->out);
+        rng->ctr[0]++;
+        rng->used = 0;
+    }
+    return rng->out[rng->used++];
+}
+
+void rng_init(RNG *rng, uint64_t seed, uint32_t stream, uint32_t fiber, uint32_t rep)
+{
+    rng->key[0] = (uint32_t) seed;
+    rng->key[1] = (uint32_t) (seed >> 32);
+    rng->ctr[0] = 0;
+    rng->ctr[1] = stream;
+    rng->ctr[2] = fiber;
+    rng->ctr[3] = rep;
+    rng->used = 4;
+    rng->has_spare = 0;
+}
+
+/* calls++, atomically, so that concurrent callers never share a count */
+static uint32_t next_call(void)
+{
+    static volatile long calls = 0;
+#ifdef _WIN32
+    return (uint32_t) InterlockedIncrement(&calls);
+#else
+    return (uint32_t) __sync_add_and_fetch(&calls, 1);
+#endif
+}
+
+uint64_t rng_shuffle_seed(void)
+{
+    RNG rng;
+    uint64_t ns = (uint64_t) (timer_now()*1e9);
+    uint32_t hi, lo;
+
+    /* The wall clock and the monotonic clock in ns tell apart runs started at different
+       times, the process id tells apart MATLAB workers started at the same time, and the
+       call count tells apart seeds taken within one clock tick of the same process */
+    rng_init(&rng, ((uint64_t) time(NULL) << 32) ^ ns, 0xFFFFFFFFu, next_call(), rng_pid());
+    hi = next_word(&rng);
+    lo = next_word(&rng);
+    return ((uint64_t) hi << 32) | lo;
+}
+
+double rng_uniform(RNG *rng)
+{
+    uint64_t hi = next_word(rng) >> 5, lo = next_word(rng) >> 6;  /* 27 + 26 bits */
+
+    /* offset by half a step so that neither 0 nor 1 can occur */
+    return ((double) ((hi << 26) | lo) + 0.5) * (1.0/9007199254740992.0);
+}
+
+void rng_normal(RNG *rng, double *z, int n)
+{
+    double u, v, s;
+    int i;
+
+    for (i=0; i<n; i++)
+    {
+        if (rng->has_spare)
+        {
+            z[i] = rng->spare;
+            rng->has_spare = 0;
+            continue;
+        }
+        do {
+            u = 2.0*rng_uniform(rng) - 1.0;
+            v = 2.0*rng_uniform(rng) - 1.0;
+            s = u*u + v*v;
+        } while (s >= 1.0 || s == 0.0);
+        s = sqrt(-2.0*log(s)/s);
+        z[i] = u*s;
+        rng->spare = v*s;
+        rng->has_spare = 1;
+    }
+}
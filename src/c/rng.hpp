@@ -0,0 +1,44 @@
+#ifndef _RNG_HPP
+#define _RNG_HPP
+
+/* RNG.HPP header file
+ * Counter-based random numbers (Philox4x32-10; Salmon et al., 2011, "Parallel random
+ * numbers: as easy as 1, 2, 3") for the native parts of the model, so that they do not
+ * depend on MATLAB's global rand/randn state.
+ *
+ * A stream is identified by (seed, stream, fiber, rep): the seed is the Philox key and the
+ * other three, together with a block index, form the counter.  Every draw is therefore a
+ * pure function of its identity and position, so two runs with the same seed give the
+ * same numbers for every fiber and repetition no matter how the work is split between
+ * threads, and numbers can be drawn one at a time without a pre-drawn buffer.
+ */
+
+#include <stdint.h>
+
+/* Stream ids: which part of the model draws from the stream */
+#define RNG_STREAM_NOISE  0   /* fractional Gaussian noise of the synapse (ffgn.c) */
+#define RNG_STREAM_SPIKES 1   /* spike generator */
+
+typedef struct {
+    uint32_t key[2];     /* the seed */
+    uint32_t ctr[4];     /* block index, stream, fiber, rep */
+    uint32_t out[4];     /* random words of the current block */
+    int      used;       /* words of out[] already consumed */
+    int      has_spare;  /* the polar method makes normal deviates in pairs */
+    double   spare;
+} RNG;
+
+/* Position *rng at the start of stream (seed, stream, fiber, rep) */
+void rng_init(RNG *rng, uint64_t seed, uint32_t stream, uint32_t fiber, uint32_t rep);
+
+/* A seed from the clocks and the process id, for runs that ask for fresh randomness (as
+   RandStream 'shuffle'); distinct for concurrent calls and for workers started together */
+uint64_t rng_shuffle_seed(void);
+
+/* Uniform deviate on the open interval (0,1), with 53 random bits */
+double rng_uniform(RNG *rng);
+
+/* Fill z[0..n-1] with standard normal deviates (Marsaglia's polar method) */
+void rng_normal(RNG *rng, double *z, int n);
+
+#endif
@@ -0,0 +1,72 @@
+function [rate, var, spikes] = sim_an_bundle_zbc2025(x, cf, args)
+% SIM_AN_BUNDLE_ZBC2025(...) Simulates a bundle of ANFs at one CF, e.g.
+% several fibers of each spontaneous-rate type, from one inner hair cell
+% output, using the auditory-periphery model of Zilany, Bruce, and Carney
+% (2014) with the Guest and Carney (2024) power-law adaptation
+% approximation. Stages that do not differ between fibers run once per
+% fiber type rather than once per fiber (see model_AN_bundle.c).
+%
+% [rate, var, spikes] = sim_an_bundle_zbc2025(...) returns matrices of
+% size (n_fiber, n_sample) holding, for each fiber, the waveform of
+% instantaneous spike rates, the waveform of instantaneous spike
+% variances, and a simulated peristimulus time histogram (PSTH). Row k
+% equals the output of sim_an_zbc2025 with that fiber's type and
+% fiber_id = args.fiber_id + k - 1.
+%
+% Arguments:
+% - x: inner hair cell potential (a.u.), size (1, totalstim)
+% - cf: characteristic frequency (Hz)
+% - args.nrep: how many times to run the simulation
+% - args.fs: sampling rate (Hz)
+% - args.fibertype: spontaneous-rate types, 1 (LSR), 2 (MSR), or 3 (HSR)
+% - args.count: number of fibers of each type, a scalar or one value per
+%		type; the bundle holds args.count(1) fibers of args.fibertype(1),
+%		then args.count(2) of args.fibertype(2), and so on
+% - args.noisetype: frozen (0) or fresh (1) fractional Gaussian noise.
+%		With frozen noise, fibers of one type share their whole synapse
+%		output and differ only in their spikes.
+% - args.implnt: how to implement power-law adaptation, either original
+%		approximate (0), true power-law adaptation (1), or new
+%		approximate (2)
+% - args.resample_n, args.seed, args.fiber_id, args.ntrials, args.pla: as
+%		for sim_an_zbc2025
+% - args.nthreads: number of threads the fibers are spread over (default:
+%		number of processors). Does not change the output.
+    arguments
+        x (:, 1) double
+        cf (1,1) double
+        args.nrep (1,1) double = 1
+        args.fs (1,1) double = 100e3
+        args.fibertype (:,1) double = [1; 2; 3]
+        args.count (:,1) double = 10
+        args.noisetype (1,1) double = 0
+        args.implnt (1,1) double = 2
+        args.resample_n (1,1) double = 10
+        args.seed double {mustBeScalarOrEmpty} = []
+        args.fiber_id (1,1) double = 0
+        args.ntrials (1,1) double = 1
+        args.nthreads (1,1) double = 0
+        args.pla = 'gc2024'
+	end
+
+	% Simulation options; the seed is only passed if given
+	opts = struct('resample_n', args.resample_n, 'fiber_id', args.fiber_id, ...
+		'ntrials', args.ntrials, 'nthreads', args.nthreads);
+	if ~isempty(args.seed)
+		opts.seed = args.seed;
+	end
+	opts.pla = args.pla;
+
+	% Pass inputs to the Mex wrapper, model_AN_bundle
+    [rate, var, spikes] = model_AN_bundle(...
+		x', ...
+		cf, ...
+		args.nrep, ...
+		1/args.fs, ...
+		args.fibertype, ...
+		args.count, ...
+		args.noisetype, ...
+		args.implnt, ...
+		opts ...
+	);
+end
@@ -0,0 +1,102 @@
+function [rate, var, spikes] = sim_an_population_zbc2025(x, cfs, args)
+% SIM_AN_POPULATION_ZBC2025(...) Simulates a population of ANFs at several
+% CFs in response to one sound-pressure waveform, using the auditory-
+% periphery model of Zilany, Bruce, and Carney (2014) with the Guest and
+% Carney (2024) power-law adaptation approximation. Channels are run in
+% parallel on a pool of worker threads.
+%
+% [rate, var, spikes] = sim_an_population_zbc2025(...) returns matrices of
+% size (n_cf, n_sample) holding, for each CF, the waveform of
+% instantaneous spike rates, the waveform of instantaneous spike
+% variances, and a simulated peristimulus time histogram (PSTH).
+%
+% Arguments:
+% - x: sound-pressure waveform (Pa), size (totalstim, 1)
+% - cfs: characteristic frequencies (Hz)
+% - args.nrep: how many times to run the simulation
+% - args.fs: sampling rate (Hz)
+% - args.dur: duration of one repetition (s), at least the stimulus duration
+% - args.cohc, args.cihc: OHC and IHC impairment (1 = normal, 0 = complete loss)
+% - args.species: 1 (cat), 2 (human, Shera et al. tuning), or 3 (human,
+%		Glasberg and Moore tuning)
+% - args.fibertype: spontaneous-rate type, either 1 (LSR), 2 (MSR), or 
+%		3 (HSR), either a scalar or one value per CF
+% - args.noisetype: frozen (0) or fresh (1) fractional Gaussian noise
+% - args.implnt: how to implement power-law adaptation, either original
+%		approximate (0), true power-law adaptation (1), or new 
+%		approximate (2)
+% - args.nthreads: number of worker threads (default: number of processors)
+% - args.resample_n: filter length of the synapse stage's decimator (see
+%		sim_an_zbc2025)
+% - args.seed, args.fiber_id: random seed and fiber id of the first CF
+%		(see sim_an_zbc2025); CF k uses fiber id args.fiber_id + k - 1.
+%		With a seed, outputs do not depend on args.nthreads.
+% - args.ntrials: number of spike trains generated from each CF's synapse
+%		output; spikes holds the sum of all of them
+% - args.pla: parameters of the parallel-exponential PLA approximation
+%		(implnt 2): the name of a built-in set ('gc2024', Table 1 of Guest
+%		and Carney (2024), or 'heuristic6', 'heuristic10', 'heuristic14',
+%		'heuristic20'), the name of a parameter file, or a struct with
+%		fields tau_slow, w_slow, tau_fast, w_fast (see pla_params.hpp)
+% - args.precision: arithmetic of the IHC filters, 'double' (default) or
+%		'single' (see check_single_precision.m for the difference)
+% - args.neurogram: if not empty, the name of a file that the outputs are
+%		written to instead of being returned (rate, var and spikes are
+%		then []); open it with read_neurogram.m. For neurograms too large
+%		for memory.
+    arguments
+        x (:, 1) double 
+        cfs (:, 1) double
+        args.nrep (1,1) double = 1
+        args.fs (1,1) double = 100e3
+        args.dur (1,1) double = length(x)/args.fs
+        args.cohc (1,1) double = 1.0
+        args.cihc (1,1) double = 1.0
+        args.species (1,1) double = 1
+        args.fibertype (:,1) double = 3 
+        args.noisetype (1,1) double = 0 
+        args.implnt (1,1) double = 2
+        args.nthreads (1,1) double = 0
+        args.resample_n (1,1) double = 10
+        args.seed double {mustBeScalarOrEmpty} = []
+        args.fiber_id (1,1) double = 0
+        args.ntrials (1,1) double = 1
+        args.pla = 'gc2024'
+        args.precision = 'double'
+        args.neurogram = ''
+	end
+
+	% Simulation options; the seed is only passed if given
+	opts = struct('resample_n', args.resample_n, 'fiber_id', args.fiber_id, ...
+		'ntrials', args.ntrials);
+	if ~isempty(args.seed)
+		opts.seed = args.seed;
+	end
+	opts.pla = args.pla;
+	opts.precision = args.precision;
+	if ~isempty(args.neurogram)
+		opts.neurogram = char(args.neurogram);
+	end
+
+	% Pass inputs to the Mex wrapper, model_AN_population
+	if args.nthreads > 0
+		nthreads = {args.nthreads};
+	else
+		nthreads = {};
+	end
+    [rate, var, spikes] = model_AN_population(...
+		x', ...
+		cfs, ...
+		args.nrep, ...
+		1/args.fs, ...
+		args.dur, ...
+		args.cohc, ...
+		args.cihc, ...
+		args.species, ...
+		args.fibertype, ...
+		args.noisetype, ...
+		args.implnt, ...
+		nthreads{:}, ...
+		opts ...
+	);
+end
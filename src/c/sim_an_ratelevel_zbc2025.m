@@ -0,0 +1,79 @@
+function [rates, rate, var, spikes] = sim_an_ratelevel_zbc2025(x, levels, cf, args)
+% SIM_AN_RATELEVEL_ZBC2025(...) Simulates the response of one ANF to one
+% sound-pressure waveform at several sound levels, e.g. for a rate-level
+% function, using the auditory-periphery model of Zilany, Bruce, and
+% Carney (2014) with the Guest and Carney (2024) power-law adaptation
+% approximation. The middle ear runs once; the levels run in parallel on
+% a pool of worker threads (see model_AN_ratelevel.c).
+%
+% [rates, rate, var, spikes] = sim_an_ratelevel_zbc2025(...) returns the
+% rate-level function rates (n_level, 1), the mean rate over the
+% stimulus at each level, and optionally matrices of size (n_level,
+% n_sample) holding, for each level, the waveform of instantaneous spike
+% rates, the waveform of instantaneous spike variances, and a simulated
+% peristimulus time histogram (PSTH). Row k equals, up to rounding, the
+% output of sim_an_zbc2025 for x scaled to levels(k) with the same seed.
+%
+% Arguments:
+% - x: sound-pressure waveform, size (totalstim, 1); only its shape
+%		matters, as it is scaled to each level
+% - levels: sound levels (dB SPL): rms of the scaled x re 20 uPa
+% - cf: characteristic frequency (Hz)
+% - args.nrep, args.fs, args.dur, args.cohc, args.cihc, args.species,
+%		args.noisetype, args.implnt, args.resample_n, args.seed,
+%		args.fiber_id, args.ntrials, args.pla: as for
+%		sim_an_population_zbc2025. Every level uses args.fiber_id.
+% - args.fibertype: spontaneous-rate type, either 1 (LSR), 2 (MSR), or
+%		3 (HSR)
+% - args.nthreads: number of worker threads (default: number of
+%		processors). Does not change the output.
+    arguments
+        x (:, 1) double
+        levels (:, 1) double
+        cf (1,1) double
+        args.nrep (1,1) double = 1
+        args.fs (1,1) double = 100e3
+        args.dur (1,1) double = length(x)/args.fs
+        args.cohc (1,1) double = 1.0
+        args.cihc (1,1) double = 1.0
+        args.species (1,1) double = 1
+        args.fibertype (1,1) double = 3
+        args.noisetype (1,1) double = 0
+        args.implnt (1,1) double = 2
+        args.nthreads (1,1) double = 0
+        args.resample_n (1,1) double = 10
+        args.seed double {mustBeScalarOrEmpty} = []
+        args.fiber_id (1,1) double = 0
+        args.ntrials (1,1) double = 1
+        args.pla = 'gc2024'
+	end
+
+	% Simulation options; the seed is only passed if given
+	opts = struct('resample_n', args.resample_n, 'fiber_id', args.fiber_id, ...
+		'ntrials', args.ntrials, 'nthreads', args.nthreads);
+	if ~isempty(args.seed)
+		opts.seed = args.seed;
+	end
+	opts.pla = args.pla;
+
+	% Pass inputs to the Mex wrapper, model_AN_ratelevel; the level x time
+	% outputs are only built if asked for
+	out = cell(1, max(nargout, 1));
+    [out{:}] = model_AN_ratelevel(...
+		x', ...
+		levels, ...
+		cf, ...
+		args.nrep, ...
+		1/args.fs, ...
+		args.dur, ...
+		args.cohc, ...
+		args.cihc, ...
+		args.species, ...
+		args.fibertype, ...
+		args.noisetype, ...
+		args.implnt, ...
+		opts ...
+	);
+	out(end+1:4) = {[]};
+	[rates, rate, var, spikes] = out{:};
+end
@@ -1,4 +1,4 @@
-function [rate, var, spikes] = sim_an_zbc2025(x, cf, args)
+function [rate, var, spikes, trials] = sim_an_zbc2025(x, cf, args)
 % SIM_AN_ZBC2025(...) Simulates ANF rates/spikes using auditory-periphery 
 % model of Zilany, Bruce, and Carney (2014), optionally using the 
 % Guest and Carney (2024) power-law adaptation approximation. Returns
@@ -9,6 +9,10 @@ function [rate, var, spikes] = sim_an_zbc2025(x, cf, args)
 % instantaneous spike rates, the waveform of instaneous spike variances,
 % and a simulated peristimulus time histogram (PSTH). 
 %
+% [rate, var, spikes, trials] = sim_an_zbc2025(...) also returns the spike
+% counts of each of the args.ntrials trials, size (n_sample, ntrials);
+% spikes is then their sum.
+%
 % Arguments:
 % - x: inner hair cell potential (a.u.), size (1, totalstim)
 % - cf: characteristic frequency (Hz)
@@ -23,6 +27,30 @@ function [rate, var, spikes] = sim_an_zbc2025(x, cf, args)
 %		approximate (0), true power-law adaptation (1), or new 
 %		approximate (2). New approximate is the recommended setting for 
 %		most applications.
+% - args.resample_n: filter length of the synapse stage's 100 kHz -> 10 kHz
+%		decimator, as in resample(x,p,q,n). The default (10) reproduces
+%		MATLAB's resample; smaller values are faster but less accurate
+%		around stimulus onsets (see mex_options.hpp).
+% - args.seed: seed of the fractional Gaussian noise (when noisetype is 1)
+%		and of the spike generator. Equal seeds give identical outputs;
+%		by default a new seed is drawn on every call.
+% - args.fiber_id: which fiber of a population this is. Fibers with the
+%		same seed but different ids get independent random streams.
+% - args.ntrials: number of spike trains generated from the one synapse
+%		output; the synapse and its noise are only computed once.
+% - args.nthreads: number of threads the trials are spread over (default:
+%		number of processors). Does not change the output.
+% - args.independent_reps: run each of the nrep repetitions from rest, with
+%		its own spike trains, instead of carrying the synapse's state over
+%		from the previous one (default: false). With noisetype 1 each
+%		repetition also draws its own noise; frozen noise (noisetype 0) is
+%		the same for all of them. The repetitions then run in
+%		parallel on args.nthreads threads; the output does not depend on it.
+% - args.pla: parameters of the parallel-exponential PLA approximation
+%		(implnt 2): the name of a built-in set ('gc2024', Table 1 of Guest
+%		and Carney (2024), or 'heuristic6', 'heuristic10', 'heuristic14',
+%		'heuristic20'), the name of a parameter file, or a struct with
+%		fields tau_slow, w_slow, tau_fast, w_fast (see pla_params.hpp)
     arguments
         x (:, 1) double 
         cf (1,1) double
@@ -31,22 +59,40 @@ function [rate, var, spikes] = sim_an_zbc2025(x, cf, args)
         args.fibertype (1,1) double = 3 
         args.noisetype (1,1) double = 0 
         args.implnt (1,1) double = 2
+        args.resample_n (1,1) double = 10
+        args.seed double {mustBeScalarOrEmpty} = []
+        args.fiber_id (1,1) double = 0
+        args.ntrials (1,1) double = 1
+        args.nthreads (1,1) double = 0
+        args.independent_reps (1,1) logical = false
+        args.pla = 'gc2024'
+	end
+
+	% Simulation options; the seed is only passed if given
+	opts = struct('resample_n', args.resample_n, 'fiber_id', args.fiber_id, ...
+		'ntrials', args.ntrials, 'nthreads', args.nthreads, ...
+		'independent_reps', double(args.independent_reps));
+	if ~isempty(args.seed)
+		opts.seed = args.seed;
 	end
+	opts.pla = args.pla;
 
 	% Pass inputs to the Mex wrapper, model_Syanapse_2023
-    [rate, var, spikes] = model_Synapse_v2025a(...
+    [rate, var, spikes, trials] = model_Synapse_v2025a(...
 		x', ...
 		cf, ...
 		args.nrep, ...
 		1/args.fs, ...
 		args.fibertype, ...
 		args.noisetype, ...
-		args.implnt ...
+		args.implnt, ...
+		opts ...
 	);
 
 	% Transform row-vector outputs into column-vector outputs
 	rate = rate';
 	var = var';
 	spikes = spikes';
+	trials = trials';
 end
 
@@ -0,0 +1,146 @@
+#ifndef _SIMD_HPP
+#define _SIMD_HPP
+
+/* SIMD.HPP header file
+ * A thin layer over the x86 vector intrinsics, so that the model kernels can be written
+ * once and compiled for the widest instruction set the compiler was told about:
+ *
+ *   -mavx512f (or /arch:AVX512)  ->  8 doubles per vector
+ *   -mavx     (or /arch:AVX2)    ->  4 doubles per vector
+ *   SSE2 (any x86-64 compiler)   ->  2 doubles per vector
+ *   anything else                ->  plain scalar code, 1 "lane"
+ *
+ * AN_LANES is the number of doubles in a vreal.  Loads and stores are unaligned, so arrays
+ * only need to hold a multiple of AN_LANES elements.  vfmadd(a,b,c) is a*b+c, fused when
+ * the target has FMA; everything else is exactly the corresponding IEEE scalar operation,
+ * so kernels that avoid vfmadd give the same results as their scalar counterparts.
+ *
+ * vsingle is the single-precision vector of the same width, AN_SLANES floats (twice
+ * AN_LANES, except for scalar code), with the same operations prefixed vs.
+ */
+
+#if defined(__AVX512F__)
+
+#include <immintrin.h>
+#define AN_LANES 8
+typedef __m512d vreal;
+#define vset1(x)      _mm512_set1_pd(x)
+#define vzero()       _mm512_setzero_pd()
+#define vload(p)      _mm512_loadu_pd(p)
+#define vstore(p,a)   _mm512_storeu_pd((p),(a))
+#define vadd(a,b)     _mm512_add_pd((a),(b))
+#define vsub(a,b)     _mm512_sub_pd((a),(b))
+#define vmul(a,b)     _mm512_mul_pd((a),(b))
+#define vdiv(a,b)     _mm512_div_pd((a),(b))
+#define vmax(a,b)     _mm512_max_pd((a),(b))
+#define vfmadd(a,b,c) _mm512_fmadd_pd((a),(b),(c))
+#define vhsum(a)      _mm512_reduce_add_pd(a)
+
+#define AN_SLANES 16
+typedef __m512 vsingle;
+#define vsset1(x)     _mm512_set1_ps(x)
+#define vszero()      _mm512_setzero_ps()
+#define vsload(p)     _mm512_loadu_ps(p)
+#define vsstore(p,a)  _mm512_storeu_ps((p),(a))
+#define vsadd(a,b)    _mm512_add_ps((a),(b))
+#define vssub(a,b)    _mm512_sub_ps((a),(b))
+#define vsmul(a,b)    _mm512_mul_ps((a),(b))
+#define vsdiv(a,b)    _mm512_div_ps((a),(b))
+
+#elif defined(__AVX__)
+
+#include <immintrin.h>
+#define AN_LANES 4
+typedef __m256d vreal;
+#define vset1(x)      _mm256_set1_pd(x)
+#define vzero()       _mm256_setzero_pd()
+#define vload(p)      _mm256_loadu_pd(p)
+#define vstore(p,a)   _mm256_storeu_pd((p),(a))
+#define vadd(a,b)     _mm256_add_pd((a),(b))
+#define vsub(a,b)     _mm256_sub_pd((a),(b))
+#define vmul(a,b)     _mm256_mul_pd((a),(b))
+#define vdiv(a,b)     _mm256_div_pd((a),(b))
+#define vmax(a,b)     _mm256_max_pd((a),(b))
+#ifdef __FMA__
+#define vfmadd(a,b,c) _mm256_fmadd_pd((a),(b),(c))
+#else
+#define vfmadd(a,b,c) _mm256_add_pd(_mm256_mul_pd((a),(b)),(c))
+#endif
+static __inline double vhsum(__m256d a)
+{
+    __m128d s = _mm_add_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+}
+
+#define AN_SLANES 8
+typedef __m256 vsingle;
+#define vsset1(x)     _mm256_set1_ps(x)
+#define vszero()      _mm256_setzero_ps()
+#define vsload(p)     _mm256_loadu_ps(p)
+#define vsstore(p,a)  _mm256_storeu_ps((p),(a))
+#define vsadd(a,b)    _mm256_add_ps((a),(b))
+#define vssub(a,b)    _mm256_sub_ps((a),(b))
+#define vsmul(a,b)    _mm256_mul_ps((a),(b))
+#define vsdiv(a,b)    _mm256_div_ps((a),(b))
+
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+#include <emmintrin.h>
+#define AN_LANES 2
+typedef __m128d vreal;
+#define vset1(x)      _mm_set1_pd(x)
+#define vzero()       _mm_setzero_pd()
+#define vload(p)      _mm_loadu_pd(p)
+#define vstore(p,a)   _mm_storeu_pd((p),(a))
+#define vadd(a,b)     _mm_add_pd((a),(b))
+#define vsub(a,b)     _mm_sub_pd((a),(b))
+#define vmul(a,b)     _mm_mul_pd((a),(b))
+#define vdiv(a,b)     _mm_div_pd((a),(b))
+#define vmax(a,b)     _mm_max_pd((a),(b))
+#define vfmadd(a,b,c) _mm_add_pd(_mm_mul_pd((a),(b)),(c))
+static __inline double vhsum(__m128d a)
+{
+    return _mm_cvtsd_f64(_mm_add_sd(a, _mm_unpackhi_pd(a, a)));
+}
+
+#define AN_SLANES 4
+typedef __m128 vsingle;
+#define vsset1(x)     _mm_set1_ps(x)
+#define vszero()      _mm_setzero_ps()
+#define vsload(p)     _mm_loadu_ps(p)
+#define vsstore(p,a)  _mm_storeu_ps((p),(a))
+#define vsadd(a,b)    _mm_add_ps((a),(b))
+#define vssub(a,b)    _mm_sub_ps((a),(b))
+#define vsmul(a,b)    _mm_mul_ps((a),(b))
+#define vsdiv(a,b)    _mm_div_ps((a),(b))
+
+#else
+
+#define AN_LANES 1
+typedef double vreal;
+#define vset1(x)      (x)
+#define vzero()       0.0
+#define vload(p)      (*(p))
+#define vstore(p,a)   (*(p) = (a))
+#define vadd(a,b)     ((a)+(b))
+#define vsub(a,b)     ((a)-(b))
+#define vmul(a,b)     ((a)*(b))
+#define vdiv(a,b)     ((a)/(b))
+#define vmax(a,b)     (((a) > (b))? (a): (b))
+#define vfmadd(a,b,c) ((a)*(b)+(c))
+#define vhsum(a)      (a)
+
+#define AN_SLANES 1
+typedef float vsingle;
+#define vsset1(x)     (x)
+#define vszero()      0.0f
+#define vsload(p)     (*(p))
+#define vsstore(p,a)  (*(p) = (a))
+#define vsadd(a,b)    ((a)+(b))
+#define vssub(a,b)    ((a)-(b))
+#define vsmul(a,b)    ((a)*(b))
+#define vsdiv(a,b)    ((a)/(b))
+
+#endif
+
+#endif
@@ -0,0 +1,260 @@
+/*
+thread_pool.c implements the small worker pool declared in thread_pool.hpp
+*/
+
+#include <stdlib.h>
+#include "thread_pool.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+typedef HANDLE TPOOL_THREAD;
+static SRWLOCK pool_lock = SRWLOCK_INIT;
+static CONDITION_VARIABLE pool_wake = CONDITION_VARIABLE_INIT, pool_done = CONDITION_VARIABLE_INIT;
+#define POOL_LOCK()        AcquireSRWLockExclusive(&pool_lock)
+#define POOL_UNLOCK()      ReleaseSRWLockExclusive(&pool_lock)
+#define POOL_WAIT(c)       SleepConditionVariableSRW(&(c), &pool_lock, INFINITE, 0)
+#define POOL_BROADCAST(c)  WakeAllConditionVariable(&(c))
+#else
+#include <pthread.h>
+#include <unistd.h>
+typedef pthread_t TPOOL_THREAD;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  pool_wake = PTHREAD_COND_INITIALIZER, pool_done = PTHREAD_COND_INITIALIZER;
+#define POOL_LOCK()        pthread_mutex_lock(&pool_lock)
+#define POOL_UNLOCK()      pthread_mutex_unlock(&pool_lock)
+#define POOL_WAIT(c)       pthread_cond_wait(&(c), &pool_lock)
+#define POOL_BROADCAST(c)  pthread_cond_broadcast(&(c))
+#endif
+
+/* Shared state of one tpool_run call */
+typedef struct {
+    TPOOL_TASK fn;
+    void *arg;
+    int ntasks, next;
+#ifdef _WIN32
+    CRITICAL_SECTION lock;
+#else
+    pthread_mutex_t lock;
+#endif
+} TPOOL_JOB;
+
+/* The persistent workers, all guarded by pool_lock.  A tpool_run call posts its job with
+   `slots` places for workers; a parked worker that finds a free place joins the job, and
+   the call returns once it has closed the places and `running` has dropped to zero. */
+static struct {
+    TPOOL_THREAD *threads;
+    int       nworkers, cap;
+    int       busy;         /* a tpool_run call owns the workers */
+    int       quit;         /* tpool_shutdown is stopping them */
+    TPOOL_JOB *job;
+    int       slots, running;
+} pool;
+
+/* Hand out the next task index, or -1 when all tasks have been taken */
+static int tpool_next(TPOOL_JOB *job)
+{
+    int task;
+#ifdef _WIN32
+    EnterCriticalSection(&job->lock);
+#else
+    pthread_mutex_lock(&job->lock);
+#endif
+    task = (job->next < job->ntasks) ? job->next++ : -1;
+#ifdef _WIN32
+    LeaveCriticalSection(&job->lock);
+#else
+    pthread_mutex_unlock(&job->lock);
+#endif
+    return task;
+}
+
+static void tpool_work(TPOOL_JOB *job)
+{
+    int task;
+    while ((task = tpool_next(job)) >= 0)
+        job->fn(job->arg, task);
+}
+
+/* A persistent worker: park until a job has a free place or the pool is shut down */
+static void tpool_park(void)
+{
+    TPOOL_JOB *job;
+
+    POOL_LOCK();
+    for (;;)
+    {
+        while (!pool.quit && pool.slots == 0)
+            POOL_WAIT(pool_wake);
+        if (pool.quit)
+            break;
+        pool.slots--;
+        pool.running++;
+        job = pool.job;
+        POOL_UNLOCK();
+        tpool_work(job);
+        POOL_LOCK();
+        if (--pool.running == 0)
+            POOL_BROADCAST(pool_done);
+    }
+    POOL_UNLOCK();
+}
+
+#ifdef _WIN32
+static DWORD WINAPI tpool_worker(LPVOID p) { tpool_work((TPOOL_JOB *) p); return 0; }
+static DWORD WINAPI tpool_parked(LPVOID p) { (void) p; tpool_park(); return 0; }
+#else
+static void *tpool_worker(void *p) { tpool_work((TPOOL_JOB *) p); return NULL; }
+static void *tpool_parked(void *p) { (void) p; tpool_park(); return NULL; }
+#endif
+
+int tpool_nthreads_default(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return (si.dwNumberOfProcessors > 0) ? (int) si.dwNumberOfProcessors : 1;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? (int) n : 1;
+#endif
+}
+
+/* Grow the pool to n workers (called with pool_lock held); returns 0 if it has them */
+static int tpool_grow(int n)
+{
+    TPOOL_THREAD *t;
+
+    if (n > pool.cap)
+    {
+        if ((t = (TPOOL_THREAD *) realloc(pool.threads, n*sizeof(TPOOL_THREAD))) == NULL)
+            return 1;
+        pool.threads = t; pool.cap = n;
+    }
+    while (pool.nworkers < n)
+    {
+#ifdef _WIN32
+        if ((pool.threads[pool.nworkers] = CreateThread(NULL, 0, tpool_parked, NULL, 0, NULL)) == NULL)
+            return 1;
+#else
+        if (pthread_create(&pool.threads[pool.nworkers], NULL, tpool_parked, NULL) != 0)
+            return 1;
+#endif
+        pool.nworkers++;
+    }
+    return 0;
+}
+
+/* Run a job on nthreads-1 threads started for it and the calling thread: the fallback for
+   calls made while another call owns the persistent workers (from one of its tasks, or
+   from another thread) */
+static int tpool_run_spawned(TPOOL_JOB *job, int nthreads)
+{
+    int i, nstarted = 0, status = 0;
+    TPOOL_THREAD *threads = (TPOOL_THREAD *) malloc((nthreads-1)*sizeof(TPOOL_THREAD));
+
+    if (threads)
+        for (i = 0; i < nthreads-1; i++)
+        {
+#ifdef _WIN32
+            if ((threads[i] = CreateThread(NULL, 0, tpool_worker, job, 0, NULL)) == NULL) { status = 1; break; }
+#else
+            if (pthread_create(&threads[i], NULL, tpool_worker, job) != 0) { status = 1; break; }
+#endif
+            nstarted++;
+        }
+    else status = 1;
+    tpool_work(job);
+    for (i = 0; i < nstarted; i++)
+    {
+#ifdef _WIN32
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+#else
+        pthread_join(threads[i], NULL);
+#endif
+    }
+    free(threads);
+    return status;
+}
+
+int tpool_run(int nthreads, int ntasks, TPOOL_TASK fn, void *arg)
+{
+    TPOOL_JOB job;
+    int i, status = 0;
+
+    if (ntasks <= 0) return 0;
+    if (nthreads <= 0) nthreads = tpool_nthreads_default();
+    if (nthreads > ntasks) nthreads = ntasks;
+
+    /* The calling thread is one of the workers, so only nthreads-1 others are needed */
+    if (nthreads == 1)
+    {
+        for (i = 0; i < ntasks; i++)
+            fn(arg, i);
+        return 0;
+    }
+
+    job.fn = fn; job.arg = arg; job.ntasks = ntasks; job.next = 0;
+#ifdef _WIN32
+    InitializeCriticalSection(&job.lock);
+#else
+    pthread_mutex_init(&job.lock, NULL);
+#endif
+
+    POOL_LOCK();
+    if (pool.busy)
+    {
+        POOL_UNLOCK();
+        status = tpool_run_spawned(&job, nthreads);
+    }
+    else
+    {
+        pool.busy = 1;
+        status = tpool_grow(nthreads-1);
+        pool.job   = &job;
+        pool.slots = (pool.nworkers < nthreads-1) ? pool.nworkers : nthreads-1;
+        POOL_BROADCAST(pool_wake);
+        POOL_UNLOCK();
+
+        tpool_work(&job);
+
+        /* Close the places that were not taken and wait for the workers that took one */
+        POOL_LOCK();
+        pool.slots = 0;
+        while (pool.running > 0)
+            POOL_WAIT(pool_done);
+        pool.job  = NULL;
+        pool.busy = 0;
+        POOL_UNLOCK();
+    }
+
+#ifdef _WIN32
+    DeleteCriticalSection(&job.lock);
+#else
+    pthread_mutex_destroy(&job.lock);
+#endif
+    return status;
+}
+
+void tpool_shutdown(void)
+{
+    int i;
+
+    POOL_LOCK();
+    pool.quit = 1;
+    POOL_BROADCAST(pool_wake);
+    POOL_UNLOCK();
+    for (i = 0; i < pool.nworkers; i++)
+    {
+#ifdef _WIN32
+        WaitForSingleObject(pool.threads[i], INFINITE);
+        CloseHandle(pool.threads[i]);
+#else
+        pthread_join(pool.threads[i], NULL);
+#endif
+    }
+    free(pool.threads);
+    pool.threads = NULL;
+    pool.nworkers = pool.cap = 0;
+    pool.quit = 0;
+}
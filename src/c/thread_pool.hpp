@@ -0,0 +1,33 @@
+#ifndef _THREAD_POOL_HPP
+#define _THREAD_POOL_HPP
+
+/* THREAD_POOL.HPP header file
+ * A minimal portable worker pool (POSIX threads or Win32 threads) used to run independent
+ * model channels concurrently.  Tasks are handed out one at a time from a shared counter,
+ * so channels of unequal cost still balance across the workers.
+ *
+ * The workers are started on first use and kept, parked on a condition variable, between
+ * calls, so that callers that run the pool once per block of a long stimulus do not pay
+ * for starting threads every time.  A call made while another one is running (from one of
+ * its tasks, or from another thread) starts threads of its own instead.
+ *
+ * Tasks run on threads other than MATLAB's, so they must not call any mx* / mex* function.
+ */
+
+/* A task: `arg` is the pointer handed to tpool_run, `task` runs from 0 to ntasks-1 */
+typedef void (*TPOOL_TASK)(void *arg, int task);
+
+/* Number of online processors (at least 1) */
+int tpool_nthreads_default(void);
+
+/* Run fn(arg, 0) ... fn(arg, ntasks-1) on up to nthreads workers and wait for all of them.
+ * nthreads <= 0 means tpool_nthreads_default().  All tasks are always run; the return
+ * value is non-zero if fewer workers than requested could be started. */
+int tpool_run(int nthreads, int ntasks, TPOOL_TASK fn, void *arg);
+
+/* Stop and join the parked workers; the next tpool_run starts new ones.  MEX gateways call
+ * it from their mexAtExit handler, since the workers run code of the MEX file.  It must not
+ * be called while a tpool_run call is running. */
+void tpool_shutdown(void);
+
+#endif
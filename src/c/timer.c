@@ -0,0 +1,35 @@
+/*
+timer.c implements the monotonic clock declared in timer.hpp
+*/
+
+#include "timer.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+
+double timer_now(void)
+{
+    static double period = 0;
+    LARGE_INTEGER t;
+
+    if (period == 0)
+    {
+        QueryPerformanceFrequency(&t);
+        period = 1.0/(double) t.QuadPart;
+    }
+    QueryPerformanceCounter(&t);
+    return (double) t.QuadPart * period;
+}
+
+#else
+#include <time.h>
+
+double timer_now(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double) t.tv_sec + 1e-9*(double) t.tv_nsec;
+}
+
+#endif
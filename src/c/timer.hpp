@@ -0,0 +1,12 @@
+#ifndef _TIMER_HPP
+#define _TIMER_HPP
+
+/* TIMER.HPP header file
+ * A monotonic wall clock for timing the model's stages (QueryPerformanceCounter on Windows,
+ * clock_gettime(CLOCK_MONOTONIC) elsewhere).  A call costs some tens of ns.
+ */
+
+/* Seconds since an arbitrary fixed point */
+double timer_now(void);
+
+#endif